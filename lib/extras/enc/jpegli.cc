@@ -263,6 +263,9 @@ Status EncodeJpeg(const PackedPixelFile& ppf, const JpegSettings& jpeg_settings,
         &cinfo, jpeg_settings.use_adaptive_quantization);
     jpegli_set_distance(&cinfo, jpeg_settings.distance);
     jpegli_set_progressive_level(&cinfo, jpeg_settings.progressive_level);
+    if (pool != nullptr) {
+      jpegli_set_parallel_runner(&cinfo, pool->runner(), pool->runner_opaque());
+    }
     jpegli_start_compress(&cinfo, TRUE);
     if (!output_encoding.IsSRGB()) {
       jpegli_write_icc_profile(&cinfo, output_encoding.ICC().data(),
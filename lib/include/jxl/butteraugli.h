@@ -38,6 +38,15 @@ typedef struct JxlButteraugliApiStruct JxlButteraugliApi;
  */
 typedef struct JxlButteraugliResultStruct JxlButteraugliResult;
 
+/**
+ * Opaque structure that holds an original image prepared for comparison with
+ * any number of distortions.
+ *
+ * Allocated and initialized with JxlButteraugliReferenceCreate().
+ * Cleaned up and deallocated with JxlButteraugliReferenceDestroy().
+ */
+typedef struct JxlButteraugliReferenceStruct JxlButteraugliReference;
+
 /**
  * Deinitializes and frees JxlButteraugliResult instance.
  *
@@ -119,6 +128,55 @@ JXL_EXPORT JxlButteraugliResult* JxlButteraugliCompute(
     size_t size_orig, const JxlPixelFormat* pixel_format_dist,
     const void* buffer_dist, size_t size_dist);
 
+/**
+ * Prepares an original image for comparison with any number of distortions
+ * using JxlButteraugliCompareWithReference(). This computes the psychovisual
+ * representation of the original only once, which is much faster than calling
+ * JxlButteraugliCompute() for each distortion.
+ *
+ * The options of @p api (hf_asymmetry, intensity_target) at the time of this
+ * call are used for all comparisons with the returned reference.
+ *
+ * @param api api instance for this computation.
+ * @param xsize width of the original image.
+ * @param ysize height of the original image.
+ * @param pixel_format pixel format for original image.
+ * @param buffer pixel data for original image.
+ * @param size size of buffer in bytes.
+ * @return @c NULL if the reference can not be computed or initialized.
+ * @return pointer to initialized reference otherwise.
+ */
+JXL_EXPORT JxlButteraugliReference* JxlButteraugliReferenceCreate(
+    const JxlButteraugliApi* api, uint32_t xsize, uint32_t ysize,
+    const JxlPixelFormat* pixel_format, const void* buffer, size_t size);
+
+/**
+ * Computes intermediary butteraugli result between a prepared original image
+ * and a distortion. The result is the same as the one of
+ * JxlButteraugliCompute() with the same images and options. The same reference
+ * must not be used from multiple threads concurrently.
+ *
+ * @param api api instance for this computation.
+ * @param reference the prepared original image.
+ * @param pixel_format_dist pixel format for distortion.
+ * @param buffer_dist pixel data for distortion, with the size of the original.
+ * @param size_dist size of buffer_dist in bytes.
+ * @return @c NULL if the results can not be computed or initialized.
+ * @return pointer to initialized and computed intermediary result.
+ */
+JXL_EXPORT JxlButteraugliResult* JxlButteraugliCompareWithReference(
+    const JxlButteraugliApi* api, JxlButteraugliReference* reference,
+    const JxlPixelFormat* pixel_format_dist, const void* buffer_dist,
+    size_t size_dist);
+
+/**
+ * Deinitializes and frees JxlButteraugliReference instance.
+ *
+ * @param reference instance to be cleaned up and deallocated.
+ */
+JXL_EXPORT void JxlButteraugliReferenceDestroy(
+    JxlButteraugliReference* reference);
+
 /**
  * Computes butteraugli max distance based on an intermediary butteraugli
  * result.
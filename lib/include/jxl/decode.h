@@ -180,7 +180,8 @@ typedef enum {
   /** The JPEG reconstruction buffer is too small for reconstructed JPEG
    * codestream to fit. @ref JxlDecoderSetJPEGBuffer must be called again to
    * make room for remaining bytes. This event may occur multiple times
-   * after @ref JXL_DEC_JPEG_RECONSTRUCTION.
+   * after @ref JXL_DEC_JPEG_RECONSTRUCTION. The bytes written to the buffer
+   * before this event are final and are not written again.
    */
   JXL_DEC_JPEG_NEED_MORE_OUTPUT = 6,
 
@@ -352,6 +353,15 @@ typedef enum {
  *  - @ref JxlDecoderSetRenderSpotcolors, and
  *  - @ref JxlDecoderSubscribeEvents.
  *
+ * If the decoder is rewound between frames, it also keeps the frames saved
+ * for reference by later frames at that point. If then all frames up to that
+ * point are skipped with @ref JxlDecoderSkipFrames, they are not decoded
+ * again, which makes seeking forward in an animation take bounded time. This
+ * keeps a copy of the saved frames in the decoder until @ref JxlDecoderReset
+ * or @ref JxlDecoderDestroy. The copy is not used, and is released, if the
+ * coalescing setting, the preferred color profile or the desired intensity
+ * target differ after the rewind.
+ *
  * @param dec decoder object
  */
 JXL_EXPORT void JxlDecoderRewind(JxlDecoder* dec);
@@ -1198,6 +1208,13 @@ JxlDecoderSetExtraChannelBuffer(JxlDecoder* dec, const JxlPixelFormat* format,
  * JxlDecoderReleaseJPEGBuffer, bytes that the decoder has already output
  * should not be included, only the remaining bytes output must be set.
  *
+ * The decoder writes the JPEG bytes as soon as the coefficients they encode
+ * are decoded, so part of the reconstructed JPEG may be written to the buffer
+ * before @ref JXL_DEC_FULL_IMAGE, while the rest of the input is still being
+ * processed. The amount of bytes written so far is the size of the buffer
+ * minus the value returned by @ref JxlDecoderReleaseJPEGBuffer. All of them
+ * are final, also when the decoder returns @ref JXL_DEC_JPEG_NEED_MORE_OUTPUT.
+ *
  * @param dec decoder object
  * @param data pointer to next bytes to write to
  * @param size amount of bytes available starting from data
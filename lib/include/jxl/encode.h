@@ -346,6 +346,33 @@ typedef enum {
    */
   JXL_ENC_FRAME_SETTING_JPEG_COMPRESS_BOXES = 33,
 
+  /** Makes the encoder search for the quantization at which the decoded frame
+   * reaches the given SSIMULACRA 2 score, instead of encoding at the distance
+   * set with @ref JxlEncoderSetFrameDistance. Scores are at most 100, with
+   * for example 90 for visually lossless and 70 for medium quality. The
+   * search reuses the heuristics of one encoding and costs a few decoding
+   * steps. It applies to lossy VarDCT frames only. Use 0 (default) to
+   * disable. This is a float option, set it with @ref
+   * JxlEncoderFrameSettingsSetFloatOption.
+   */
+  JXL_ENC_FRAME_SETTING_TARGET_SSIMULACRA2 = 34,
+
+  /** Same as JXL_ENC_FRAME_SETTING_TARGET_SSIMULACRA2, but targets a maximum
+   * butteraugli score of the decoded frame, where lower means better, in range
+   * [0..25]. If both targets are set, the SSIMULACRA 2 target is used. Use 0
+   * (default) to disable. This is a float option, set it with @ref
+   * JxlEncoderFrameSettingsSetFloatOption.
+   */
+  JXL_ENC_FRAME_SETTING_TARGET_BUTTERAUGLI = 35,
+
+  /** Bounds the memory used by the entropy coding of modular streams to about
+   * one group per thread, by tokenizing every group again when it is written
+   * instead of keeping all the tokens of the frame. This makes encoding slower
+   * and disables LZ77 for the modular streams, so files are usually slightly
+   * larger. -1 = default (off), 0 = off, 1 = on.
+   */
+  JXL_ENC_FRAME_SETTING_BOUNDED_TOKEN_MEMORY = 36,
+
   /** Enum value not to be used as an option. This value is added to force the
    * C compiler to have the enum to take a known size.
    */
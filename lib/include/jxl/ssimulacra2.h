@@ -0,0 +1,98 @@
+/* Copyright (c) the JPEG XL Project Authors. All rights reserved.
+ *
+ * Use of this source code is governed by a BSD-style
+ * license that can be found in the LICENSE file.
+ */
+
+/** @addtogroup libjxl_ssimulacra2
+ * @{
+ * @file ssimulacra2.h
+ * @brief SSIMULACRA 2 API for JPEG XL.
+ */
+
+#ifndef JXL_SSIMULACRA2_H_
+#define JXL_SSIMULACRA2_H_
+
+#if defined(__cplusplus) || defined(c_plusplus)
+extern "C" {
+#endif
+
+#include "jxl/jxl_export.h"
+#include "jxl/memory_manager.h"
+#include "jxl/parallel_runner.h"
+#include "jxl/types.h"
+
+/**
+ * Opaque structure that holds a SSIMULACRA 2 API.
+ *
+ * Allocated and initialized with JxlSsimulacra2ApiCreate().
+ * Cleaned up and deallocated with JxlSsimulacra2ApiDestroy().
+ */
+typedef struct JxlSsimulacra2ApiStruct JxlSsimulacra2Api;
+
+/**
+ * Creates an instance of JxlSsimulacra2Api and initializes it.
+ *
+ * @p memory_manager will be used for all the library dynamic allocations made
+ * from this instance. The parameter may be NULL, in which case the default
+ * allocator will be used. See jxl/memory_manager.h for details.
+ *
+ * @param memory_manager custom allocator function. It may be NULL. The memory
+ *        manager will be copied internally.
+ * @return @c NULL if the instance can not be allocated or initialized
+ * @return pointer to initialized JxlSsimulacra2Api otherwise
+ */
+JXL_EXPORT JxlSsimulacra2Api* JxlSsimulacra2ApiCreate(
+    const JxlMemoryManager* memory_manager);
+
+/**
+ * Set the parallel runner for multithreading.
+ *
+ * @param api api instance.
+ * @param parallel_runner function pointer to runner for multithreading. A
+ * multithreaded runner should be set to reach fast performance.
+ * @param parallel_runner_opaque opaque pointer for parallel_runner.
+ */
+JXL_EXPORT void JxlSsimulacra2ApiSetParallelRunner(
+    JxlSsimulacra2Api* api, JxlParallelRunner parallel_runner,
+    void* parallel_runner_opaque);
+
+/**
+ * Deinitializes and frees JxlSsimulacra2Api instance.
+ *
+ * @param api instance to be cleaned up and deallocated.
+ */
+JXL_EXPORT void JxlSsimulacra2ApiDestroy(JxlSsimulacra2Api* api);
+
+/**
+ * Computes the SSIMULACRA 2 score between an original image and a distortion.
+ * The score is at most 100, and higher scores mean higher quality: 90 is very
+ * high quality, 70 high quality, 50 medium quality and 30 low quality. If the
+ * original image has alpha, both images are blended against dark and bright
+ * backgrounds and the lower of both scores is returned.
+ *
+ * @param api api instance for this computation.
+ * @param xsize width of the compared images, at least 8.
+ * @param ysize height of the compared images, at least 8.
+ * @param pixel_format_orig pixel format for original image.
+ * @param buffer_orig pixel data for original image.
+ * @param size_orig size of buffer_orig in bytes.
+ * @param pixel_format_dist pixel format for distortion.
+ * @param buffer_dist pixel data for distortion.
+ * @param size_dist size of buffer_dist in bytes.
+ * @param score will be set to the score.
+ * @return JXL_FALSE if the score can not be computed, JXL_TRUE otherwise.
+ */
+JXL_EXPORT JXL_BOOL JxlSsimulacra2Compute(
+    const JxlSsimulacra2Api* api, uint32_t xsize, uint32_t ysize,
+    const JxlPixelFormat* pixel_format_orig, const void* buffer_orig,
+    size_t size_orig, const JxlPixelFormat* pixel_format_dist,
+    const void* buffer_dist, size_t size_dist, double* score);
+
+#if defined(__cplusplus) || defined(c_plusplus)
+}
+#endif
+
+#endif /* JXL_SSIMULACRA2_H_ */
+
+/** @}*/
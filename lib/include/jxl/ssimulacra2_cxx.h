@@ -0,0 +1,43 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+/// @addtogroup libjxl_ssimulacra2
+/// @{
+///
+/// @file ssimulacra2_cxx.h
+/// @brief C++ header-only helper for @ref ssimulacra2.h.
+///
+/// There's no binary library associated with the header since this is a header
+/// only library.
+
+#ifndef JXL_SSIMULACRA2_CXX_H_
+#define JXL_SSIMULACRA2_CXX_H_
+
+#include <memory>
+
+#include "jxl/ssimulacra2.h"
+
+#if !(defined(__cplusplus) || defined(c_plusplus))
+#error "This a C++ only header. Use jxl/ssimulacra2.h from C sources."
+#endif
+
+/// Struct to call JxlSsimulacra2ApiDestroy from the JxlSsimulacra2ApiPtr
+/// unique_ptr.
+struct JxlSsimulacra2ApiDestroyStruct {
+  /// Calls @ref JxlSsimulacra2ApiDestroy() on the passed api.
+  void operator()(JxlSsimulacra2Api* api) { JxlSsimulacra2ApiDestroy(api); }
+};
+
+/// std::unique_ptr<> type that calls JxlSsimulacra2ApiDestroy() when releasing
+/// the pointer.
+///
+/// Use this helper type from C++ sources to ensure the api is destroyed and
+/// their internal resources released.
+typedef std::unique_ptr<JxlSsimulacra2Api, JxlSsimulacra2ApiDestroyStruct>
+    JxlSsimulacra2ApiPtr;
+
+#endif  // JXL_SSIMULACRA2_CXX_H_
+
+/// @}
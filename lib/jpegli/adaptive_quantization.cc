@@ -20,6 +20,7 @@
 #include <hwy/highway.h>
 
 #include "lib/jpegli/encode_internal.h"
+#include "lib/jpegli/error.h"
 #include "lib/jxl/base/compiler_specific.h"
 #include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
@@ -574,14 +575,15 @@ struct AdaptiveQuantizationImpl {
   jxl::ImageF diff_buffer;
 };
 
-jxl::ImageF AdaptiveQuantizationMap(const float butteraugli_target,
-                                    const jxl::ImageF& xyb_y, float scale,
-                                    jxl::ThreadPool* pool) {
+// Returns false if the parallel runner fails.
+bool AdaptiveQuantizationMap(const float butteraugli_target,
+                             const jxl::ImageF& xyb_y, float scale,
+                             jxl::ThreadPool* pool, jxl::ImageF* aq_map) {
   AdaptiveQuantizationImpl impl;
   impl.Init(xyb_y);
   const size_t xsize_blocks = xyb_y.xsize() / jxl::kBlockDim;
   const size_t ysize_blocks = xyb_y.ysize() / jxl::kBlockDim;
-  JXL_CHECK(RunOnPool(
+  if (!RunOnPool(
       pool, 0,
       DivCeil(xsize_blocks, kEncTileDimInBlocks) *
           DivCeil(ysize_blocks, kEncTileDimInBlocks),
@@ -600,9 +602,12 @@ jxl::ImageF AdaptiveQuantizationMap(const float butteraugli_target,
         jxl::Rect r(bx0, by0, bx1 - bx0, by1 - by0);
         impl.ComputeTile(butteraugli_target, scale, xyb_y, r, thread);
       },
-      "AQ DiffPrecompute"));
+      "AQ DiffPrecompute")) {
+    return false;
+  }
 
-  return std::move(impl).aq_map;
+  *aq_map = std::move(impl).aq_map;
+  return true;
 }
 
 }  // namespace
@@ -638,15 +643,15 @@ float InitialQuantDC(float butteraugli_target) {
   return std::min(kDcQuant / butteraugli_target_dc, 50.f);
 }
 
-jxl::ImageF InitialQuantField(const float butteraugli_target,
-                              const jxl::ImageF& opsin_y, jxl::ThreadPool* pool,
-                              float rescale) {
+bool InitialQuantField(const float butteraugli_target,
+                       const jxl::ImageF& opsin_y, jxl::ThreadPool* pool,
+                       float rescale, jxl::ImageF* qf) {
   const float quant_ac = kAcQuant / butteraugli_target;
   return HWY_DYNAMIC_DISPATCH(AdaptiveQuantizationMap)(
-      butteraugli_target, opsin_y, quant_ac * rescale, pool);
+      butteraugli_target, opsin_y, quant_ac * rescale, pool, qf);
 }
 
-void ComputeAdaptiveQuantField(j_compress_ptr cinfo) {
+void ComputeAdaptiveQuantField(j_compress_ptr cinfo, jxl::ThreadPool* pool) {
   jpeg_comp_master* m = cinfo->master;
   int y_channel = cinfo->jpeg_color_space == JCS_RGB ? 1 : 0;
   jpeg_component_info* y_comp = &cinfo->comp_info[y_channel];
@@ -660,8 +665,11 @@ void ComputeAdaptiveQuantField(j_compress_ptr cinfo) {
       memcpy(input.Row(y), m->input_buffer[y_channel].Row(y),
              input.xsize() * sizeof(float));
     }
-    jxl::ImageF qf =
-        jpegli::InitialQuantField(m->distance, input, nullptr, m->distance);
+    jxl::ImageF qf;
+    if (!jpegli::InitialQuantField(m->distance, input, pool, m->distance,
+                                   &qf)) {
+      JPEGLI_ERROR("Parallel runner failed.");
+    }
     float qfmin;
     ImageMinMax(qf, &qfmin, &m->quant_field_max);
     for (size_t y = 0; y < y_comp->height_in_blocks; ++y) {
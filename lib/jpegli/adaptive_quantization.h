@@ -12,9 +12,11 @@
 #include <stddef.h>
 /* clang-format on */
 
+#include "lib/jxl/base/data_parallel.h"
+
 namespace jpegli {
 
-void ComputeAdaptiveQuantField(j_compress_ptr cinfo);
+void ComputeAdaptiveQuantField(j_compress_ptr cinfo, jxl::ThreadPool* pool);
 
 float InitialQuantDC(float butteraugli_target);
 
@@ -5,6 +5,9 @@
 
 #include "lib/jpegli/bitstream.h"
 
+#include <atomic>
+
+#include "lib/jpegli/entropy_coding.h"
 #include "lib/jpegli/error.h"
 #include "lib/jxl/base/bits.h"
 
@@ -14,7 +17,9 @@ namespace {
 // JpegBitWriter: buffer size
 const size_t kJpegBitWriterChunkSize = 16384;
 
-// Handles the packing of bits into output bytes.
+// Handles the packing of bits into output bytes. If cinfo is nullptr, the
+// output bytes are accumulated in buffer instead of being written to the
+// destination manager.
 struct JpegBitWriter {
   j_compress_ptr cinfo;
   std::vector<uint8_t> buffer;
@@ -53,10 +58,14 @@ void JpegBitWriterInit(JpegBitWriter* bw, j_compress_ptr cinfo) {
 }
 
 static JXL_INLINE void Reserve(JpegBitWriter* bw, size_t n_bytes) {
-  if (JXL_UNLIKELY((bw->pos + n_bytes) > kJpegBitWriterChunkSize)) {
-    WriteOutput(bw->cinfo, bw->data, bw->pos);
+  if (JXL_UNLIKELY((bw->pos + n_bytes) > bw->buffer.size())) {
+    if (bw->cinfo == nullptr) {
+      bw->buffer.resize(2 * bw->buffer.size() + n_bytes);
+    } else {
+      WriteOutput(bw->cinfo, bw->data, bw->pos);
+      bw->pos = 0;
+    }
     bw->data = bw->buffer.data();
-    bw->pos = 0;
   }
 }
 
@@ -162,6 +171,20 @@ static JXL_INLINE void WriteSymbol(int symbol, HuffmanCodeTable* table,
   WriteBits(bw, table->depth[symbol], table->code[symbol]);
 }
 
+// Writes the Huffman code of the symbol followed by the nbits extra bits. If
+// they fit together in the bit buffer, they are written with a single call.
+static JXL_INLINE void WriteSymbolAndBits(int symbol, HuffmanCodeTable* table,
+                                          int nbits, uint64_t bits,
+                                          JpegBitWriter* bw) {
+  const int depth = table->depth[symbol];
+  if (depth > 0 && depth + nbits <= 16) {
+    WriteBits(bw, depth + nbits, (table->code[symbol] << nbits) | bits);
+  } else {
+    WriteBits(bw, depth, table->code[symbol]);
+    WriteBits(bw, nbits, bits);
+  }
+}
+
 // Emit all buffered data to the bit stream using the given Huffman code and
 // bit writer.
 static JXL_INLINE void Flush(DCTCodingState* s, JpegBitWriter* bw) {
@@ -261,12 +284,15 @@ bool EncodeDCTBlockSequential(const coeff_t* coeffs, HuffmanCodeTable* dc_huff,
   if (dc_nbits > 0) {
     WriteBits(bw, dc_nbits, temp2 & ((1u << dc_nbits) - 1));
   }
-  int r = 0;
-  for (int k = 1; k < 64; ++k) {
-    if ((temp = coeffs[kJPEGNaturalOrder[k]]) == 0) {
-      r++;
-      continue;
-    }
+  coeff_t zz[kDCTBlockSize];
+  uint64_t nonzero = ZigZagNonzeroMask(coeffs, zz) & ~uint64_t{1};
+  int last_k = 0;
+  while (nonzero != 0) {
+    const int k = jxl::Num0BitsBelowLS1Bit_Nonzero(nonzero);
+    nonzero &= nonzero - 1;
+    int r = k - last_k - 1;
+    last_k = k;
+    temp = zz[k];
     if (temp < 0) {
       temp = -temp;
       if (temp < 0) return false;
@@ -281,10 +307,10 @@ bool EncodeDCTBlockSequential(const coeff_t* coeffs, HuffmanCodeTable* dc_huff,
     int ac_nbits = jxl::FloorLog2Nonzero<uint32_t>(temp) + 1;
     if (ac_nbits >= 16) return false;
     int symbol = (r << 4u) + ac_nbits;
-    WriteSymbol(symbol, ac_huff, bw);
-    WriteBits(bw, ac_nbits, temp2 & ((1 << ac_nbits) - 1));
-    r = 0;
+    WriteSymbolAndBits(symbol, ac_huff, ac_nbits,
+                       temp2 & ((1 << ac_nbits) - 1), bw);
   }
+  int r = 63 - last_k;
   for (int i = 0; i < num_zero_runs; ++i) {
     WriteSymbol(0xf0, ac_huff, bw);
     r -= 16;
@@ -626,20 +652,10 @@ bool EncodeDRI(j_compress_ptr cinfo) {
   return true;
 }
 
-bool EncodeScan(j_compress_ptr cinfo,
-                const std::vector<std::vector<coeff_t>>& coeffs,
-                int scan_index) {
+bool EncodeScan(j_compress_ptr cinfo, CoeffBuffer* coeffs, int scan_index,
+                jxl::ThreadPool* pool) {
   jpeg_comp_master* m = cinfo->master;
-  const int restart_interval = cinfo->restart_interval;
-  int restarts_to_go = restart_interval;
-  int next_restart_marker = 0;
-
-  JpegBitWriter bw;
-  JpegBitWriterInit(&bw, cinfo);
-
-  coeff_t last_dc_coeff[MAX_COMPS_IN_SCAN] = {0};
-  DCTCodingState coding_state;
-  DCTCodingStateInit(&coding_state);
+  const size_t restart_interval = cinfo->restart_interval;
 
   const jpeg_scan_info* scan_info = &cinfo->scan_info[scan_index];
   const ScanCodingInfo& sci = m->scan_coding_info[scan_index];
@@ -655,10 +671,11 @@ bool EncodeScan(j_compress_ptr cinfo,
   // block.
   const int h_group = is_interleaved ? 1 : base_comp->h_samp_factor;
   const int v_group = is_interleaved ? 1 : base_comp->v_samp_factor;
-  int MCUs_per_row =
+  size_t MCUs_per_row =
       DivCeil(cinfo->image_width * h_group, 8 * cinfo->max_h_samp_factor);
-  int MCU_rows =
+  size_t MCU_rows =
       DivCeil(cinfo->image_height * v_group, 8 * cinfo->max_v_samp_factor);
+  const size_t num_MCUs = MCUs_per_row * MCU_rows;
   const bool is_progressive = cinfo->progressive_mode;
   const int Al = scan_info->Al;
   const int Ah = scan_info->Ah;
@@ -666,62 +683,115 @@ bool EncodeScan(j_compress_ptr cinfo,
   const int Se = scan_info->Se;
   constexpr coeff_t kDummyBlock[DCTSIZE2] = {0};
 
-  for (int mcu_y = 0; mcu_y < MCU_rows; ++mcu_y) {
-    for (int mcu_x = 0; mcu_x < MCUs_per_row; ++mcu_x) {
-      // Possibly emit a restart marker.
-      if (restart_interval > 0 && restarts_to_go == 0) {
-        Flush(&coding_state, &bw);
-        JumpToByteBoundary(&bw);
-        EmitMarker(&bw, 0xD0 + next_restart_marker);
-        next_restart_marker += 1;
-        next_restart_marker &= 0x7;
-        restarts_to_go = restart_interval;
-        memset(last_dc_coeff, 0, sizeof(last_dc_coeff));
+  // Each restart interval is an independently coded segment of the scan. If
+  // there are no restart intervals, the whole scan is a single segment.
+  const size_t segment_size =
+      restart_interval > 0 ? restart_interval : num_MCUs;
+  const size_t num_segments = DivCeil(num_MCUs, segment_size);
+
+  // Encodes the segments [seg_begin, seg_end), each preceded by a restart
+  // marker, except for the first segment of the scan.
+  const auto encode_segments = [&](size_t seg_begin, size_t seg_end,
+                                   DCTCodingState* coding_state,
+                                   JpegBitWriter* bw) {
+    for (size_t seg = seg_begin; seg < seg_end; ++seg) {
+      if (seg > 0) {
+        EmitMarker(bw, 0xD0 + ((seg - 1) & 0x7));
       }
-      // Encode one MCU
-      for (int i = 0; i < scan_info->comps_in_scan; ++i) {
-        int comp_idx = scan_info->component_index[i];
-        jpeg_component_info* comp = &cinfo->comp_info[comp_idx];
-        HuffmanCodeTable* dc_huff = &m->dc_huff_table[sci.dc_tbl_idx[i]];
-        HuffmanCodeTable* ac_huff = &m->ac_huff_table[sci.ac_tbl_idx[i]];
-        int n_blocks_y = is_interleaved ? comp->v_samp_factor : 1;
-        int n_blocks_x = is_interleaved ? comp->h_samp_factor : 1;
-        for (int iy = 0; iy < n_blocks_y; ++iy) {
-          for (int ix = 0; ix < n_blocks_x; ++ix) {
-            size_t block_y = mcu_y * n_blocks_y + iy;
-            size_t block_x = mcu_x * n_blocks_x + ix;
-            size_t block_idx = block_y * comp->width_in_blocks + block_x;
-            size_t num_zero_runs = 0;
-            const coeff_t* block = &coeffs[comp_idx][block_idx << 6];
-            if (block_x >= comp->width_in_blocks ||
-                block_y >= comp->height_in_blocks) {
-              block = kDummyBlock;
-            }
-            bool ok;
-            if (!is_progressive) {
-              ok = EncodeDCTBlockSequential(block, dc_huff, ac_huff,
-                                            num_zero_runs, last_dc_coeff + i,
-                                            &bw);
-            } else if (Ah == 0) {
-              ok = EncodeDCTBlockProgressive(block, dc_huff, ac_huff, Ss, Se,
-                                             Al, num_zero_runs, &coding_state,
-                                             last_dc_coeff + i, &bw);
-            } else {
-              ok = EncodeRefinementBits(block, ac_huff, Ss, Se, Al,
-                                        &coding_state, &bw);
+      coeff_t last_dc_coeff[MAX_COMPS_IN_SCAN] = {0};
+      const size_t mcu_end = std::min(num_MCUs, (seg + 1) * segment_size);
+      for (size_t mcu = seg * segment_size; mcu < mcu_end; ++mcu) {
+        const size_t mcu_y = mcu / MCUs_per_row;
+        const size_t mcu_x = mcu % MCUs_per_row;
+        // Encode one MCU
+        for (int i = 0; i < scan_info->comps_in_scan; ++i) {
+          int comp_idx = scan_info->component_index[i];
+          jpeg_component_info* comp = &cinfo->comp_info[comp_idx];
+          HuffmanCodeTable* dc_huff = &m->dc_huff_table[sci.dc_tbl_idx[i]];
+          HuffmanCodeTable* ac_huff = &m->ac_huff_table[sci.ac_tbl_idx[i]];
+          int n_blocks_y = is_interleaved ? comp->v_samp_factor : 1;
+          int n_blocks_x = is_interleaved ? comp->h_samp_factor : 1;
+          for (int iy = 0; iy < n_blocks_y; ++iy) {
+            for (int ix = 0; ix < n_blocks_x; ++ix) {
+              size_t block_y = mcu_y * n_blocks_y + iy;
+              size_t block_x = mcu_x * n_blocks_x + ix;
+              size_t num_zero_runs = 0;
+              const coeff_t* block = kDummyBlock;
+              if (block_x < comp->width_in_blocks &&
+                  block_y < comp->height_in_blocks) {
+                block = coeffs->Block(comp_idx, block_y, block_x);
+              }
+              bool ok;
+              if (!is_progressive) {
+                ok = EncodeDCTBlockSequential(block, dc_huff, ac_huff,
+                                              num_zero_runs, last_dc_coeff + i,
+                                              bw);
+              } else if (Ah == 0) {
+                ok = EncodeDCTBlockProgressive(block, dc_huff, ac_huff, Ss, Se,
+                                               Al, num_zero_runs, coding_state,
+                                               last_dc_coeff + i, bw);
+              } else {
+                ok = EncodeRefinementBits(block, ac_huff, Ss, Se, Al,
+                                          coding_state, bw);
+              }
+              if (!ok) return false;
             }
-            if (!ok) return false;
           }
         }
       }
-      --restarts_to_go;
+      Flush(coding_state, bw);
+      JumpToByteBoundary(bw);
     }
+    return true;
+  };
+
+  // Encoding tasks cover a whole number of segments, and at least
+  // kMinMCUsPerTask MCUs, so that the restart intervals of a scan can be
+  // encoded independently from each other and stitched together afterwards.
+  constexpr size_t kMinMCUsPerTask = 2048;
+  const size_t segments_per_task = DivCeil(kMinMCUsPerTask, segment_size);
+  const size_t num_tasks = DivCeil(num_segments, segments_per_task);
+
+  if (pool == nullptr || num_tasks <= 1 || coeffs->streaming()) {
+    JpegBitWriter bw;
+    JpegBitWriterInit(&bw, cinfo);
+    DCTCodingState coding_state;
+    DCTCodingStateInit(&coding_state);
+    if (!encode_segments(0, num_segments, &coding_state, &bw)) return false;
+    JpegBitWriterFinish(&bw);
+    return bw.healthy;
+  }
+
+  std::vector<JpegBitWriter> task_output(num_tasks);
+  std::vector<DCTCodingState> coding_states;
+  std::atomic<bool> ok{true};
+  if (!jxl::RunOnPool(
+      pool, 0, num_tasks,
+      [&](const size_t num_threads) {
+        coding_states.resize(num_threads);
+        for (DCTCodingState& s : coding_states) {
+          DCTCodingStateInit(&s);
+        }
+        return true;
+      },
+      [&](const uint32_t task, const size_t thread) {
+        JpegBitWriter* bw = &task_output[task];
+        JpegBitWriterInit(bw, nullptr);
+        const size_t seg_begin = task * segments_per_task;
+        const size_t seg_end =
+            std::min(num_segments, seg_begin + segments_per_task);
+        if (!encode_segments(seg_begin, seg_end, &coding_states[thread], bw) ||
+            !bw->healthy) {
+          ok = false;
+        }
+      },
+      "EncodeScan")) {
+    JPEGLI_ERROR("Parallel runner failed.");
+  }
+  if (!ok) return false;
+  for (const JpegBitWriter& bw : task_output) {
+    WriteOutput(cinfo, bw.data, bw.pos);
   }
-  Flush(&coding_state, &bw);
-  JumpToByteBoundary(&bw);
-  JpegBitWriterFinish(&bw);
-  if (!bw.healthy) return false;
-
   return true;
 }
 
@@ -9,7 +9,9 @@
 #include <initializer_list>
 #include <vector>
 
+#include "lib/jpegli/dct.h"
 #include "lib/jpegli/encode_internal.h"
+#include "lib/jxl/base/data_parallel.h"
 
 namespace jpegli {
 
@@ -26,9 +28,11 @@ void EncodeDHT(j_compress_ptr cinfo, const JPEGHuffmanCode* huffman_codes,
 void EncodeDQT(j_compress_ptr cinfo);
 bool EncodeDRI(j_compress_ptr cinfo);
 
-bool EncodeScan(j_compress_ptr cinfo,
-                const std::vector<std::vector<jpegli::coeff_t>>& coeffs,
-                int scan_index);
+// Encodes the given scan. If there is a parallel runner, the scan has restart
+// intervals and the whole coefficient image is available, the restart interval
+// segments are encoded in parallel.
+bool EncodeScan(j_compress_ptr cinfo, CoeffBuffer* coeffs, int scan_index,
+                jxl::ThreadPool* pool);
 
 }  // namespace jpegli
 
@@ -0,0 +1,101 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+/* clang-format off */
+#include <stdio.h>
+#include <jpeglib.h>
+/* clang-format on */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lib/jpegli/encode.h"
+
+namespace jpegli {
+namespace {
+
+constexpr size_t kXSizeBlocks = 256;
+constexpr size_t kYSizeBlocks = 256;
+constexpr int kNumComponents = 3;
+
+// Returns coefficients with a distribution similar to that of a typical
+// photograph: the magnitude of the coefficients decreases with frequency and
+// most of the high frequency coefficients are zero.
+std::vector<JCOEF> GenerateCoefficients() {
+  std::mt19937 rng(1234);
+  std::vector<JCOEF> coeffs(kXSizeBlocks * kYSizeBlocks * DCTSIZE2);
+  for (size_t i = 0; i < coeffs.size(); i += DCTSIZE2) {
+    coeffs[i] = static_cast<int>(rng() % 512) - 256;
+    for (size_t k = 1; k < DCTSIZE2; ++k) {
+      const size_t freq = k / DCTSIZE + k % DCTSIZE;
+      std::geometric_distribution<int> magnitude(0.3 + 0.05 * freq);
+      const int value = magnitude(rng);
+      coeffs[i + k] = (rng() & 1) ? value : -value;
+    }
+  }
+  return coeffs;
+}
+
+// Measures the speed of the entropy coding of the encoder (gathering the
+// Huffman statistics, if optimize_coding is set, and writing the scans), by
+// encoding a fixed set of quantized coefficients.
+void BM_JpegliEntropyCoding(benchmark::State& state) {
+  const bool optimize_coding = state.range(0);
+  const bool progressive = state.range(1);
+  const std::vector<JCOEF> coeffs = GenerateCoefficients();
+  for (auto _ : state) {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpegli_std_error(&jerr);
+    jpegli_create_compress(&cinfo);
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;  // NOLINT
+    jpegli_mem_dest(&cinfo, &buffer, &size);
+    cinfo.image_width = kXSizeBlocks * DCTSIZE;
+    cinfo.image_height = kYSizeBlocks * DCTSIZE;
+    cinfo.input_components = kNumComponents;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpegli_set_defaults(&cinfo);
+    for (int c = 0; c < kNumComponents; ++c) {
+      cinfo.comp_info[c].h_samp_factor = 1;
+      cinfo.comp_info[c].v_samp_factor = 1;
+    }
+    cinfo.optimize_coding = optimize_coding;
+    jpegli_set_progressive_level(&cinfo, progressive ? 2 : 0);
+    j_common_ptr comptr = reinterpret_cast<j_common_ptr>(&cinfo);
+    jvirt_barray_ptr coef_arrays[kNumComponents];
+    for (int c = 0; c < kNumComponents; ++c) {
+      coef_arrays[c] = (*cinfo.mem->request_virt_barray)(
+          comptr, JPOOL_IMAGE, FALSE, kXSizeBlocks, kYSizeBlocks, 1);
+    }
+    jpegli_write_coefficients(&cinfo, coef_arrays);
+    for (int c = 0; c < kNumComponents; ++c) {
+      for (size_t by = 0; by < kYSizeBlocks; ++by) {
+        JBLOCKARRAY ba = (*cinfo.mem->access_virt_barray)(
+            comptr, coef_arrays[c], by, 1, true);
+        memcpy(ba[0], &coeffs[by * kXSizeBlocks * DCTSIZE2],
+               kXSizeBlocks * sizeof(JBLOCK));
+      }
+    }
+    jpegli_finish_compress(&cinfo);
+    jpegli_destroy_compress(&cinfo);
+    free(buffer);
+  }
+  state.SetBytesProcessed(state.iterations() * kNumComponents * coeffs.size() *
+                          sizeof(JCOEF));
+}
+
+BENCHMARK(BM_JpegliEntropyCoding)
+    ->ArgNames({"optimize", "progressive"})
+    ->Args({0, 0})
+    ->Args({1, 0})
+    ->Args({1, 1});
+
+}  // namespace
+}  // namespace jpegli
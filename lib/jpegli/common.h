@@ -21,6 +21,8 @@
 #define LIB_JPEGLI_COMMON_H_
 
 /* clang-format off */
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <jpeglib.h>
 /* clang-format on */
@@ -60,6 +62,20 @@ typedef enum {
 
 int jpegli_bytes_per_sample(JpegliDataType data_type);
 
+// Parallel runner interface of jpegli. The types match JxlParallelRunInit,
+// JxlParallelRunFunction and JxlParallelRunner of the libjxl API, so the
+// libjxl runners, e.g. JxlThreadParallelRunner, can be used directly.
+// A nonzero return value of the runner or of the init function is an error.
+typedef int (*JpegliParallelRunInit)(void* jpegli_opaque, size_t num_threads);
+
+typedef void (*JpegliParallelRunFunction)(void* jpegli_opaque, uint32_t value,
+                                          size_t thread_id);
+
+typedef int (*JpegliParallelRunner)(void* runner_opaque, void* jpegli_opaque,
+                                    JpegliParallelRunInit init,
+                                    JpegliParallelRunFunction func,
+                                    uint32_t start_range, uint32_t end_range);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  // extern "C"
 #endif
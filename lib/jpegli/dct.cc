@@ -5,13 +5,16 @@
 
 #include "lib/jpegli/dct.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #undef HWY_TARGET_INCLUDE
 #define HWY_TARGET_INCLUDE "lib/jpegli/dct.cc"
 #include <hwy/foreach_target.h>
 #include <hwy/highway.h>
 
+#include "lib/jpegli/error.h"
 #include "lib/jxl/enc_transforms.h"
 HWY_BEFORE_NAMESPACE();
 namespace jpegli {
@@ -20,62 +23,104 @@ namespace HWY_NAMESPACE {
 constexpr float kZeroBiasMulXYB[] = {0.5f, 0.5f, 0.5f};
 constexpr float kZeroBiasMulYCbCr[] = {0.7f, 1.0f, 0.8f};
 
-void ComputeDCTCoefficients(
-    j_compress_ptr cinfo,
-    std::vector<std::vector<jpegli::coeff_t> >* all_coeffs) {
+void ComputeZeroBiasMul(j_compress_ptr cinfo, float* zero_bias_mul) {
   jpeg_comp_master* m = cinfo->master;
-  float qfmax = m->quant_field_max;
-  std::vector<float> zero_bias_mul(cinfo->num_components, 0.5f);
   const bool xyb = m->xyb_mode && cinfo->jpeg_color_space == JCS_RGB;
-  if (m->distance <= 1.0f) {
-    for (int c = 0; c < 3 && c < cinfo->num_components; ++c) {
+  for (int c = 0; c < cinfo->num_components; ++c) {
+    zero_bias_mul[c] = 0.5f;
+    if (m->distance <= 1.0f && c < 3) {
       zero_bias_mul[c] = xyb ? kZeroBiasMulXYB[c] : kZeroBiasMulYCbCr[c];
     }
   }
-  HWY_ALIGN float scratch_space[2 * kDCTBlockSize];
-  jxl::ImageF tmp;
+}
+
+// Computes the quantized DCT coefficients of block row by of component c and
+// stores them starting at out.
+void ComputeDCTBlockRow(j_compress_ptr cinfo, int c, size_t by,
+                        float zero_bias_mul, const float* qmc, coeff_t* out,
+                        float* scratch_space) {
+  jpeg_comp_master* m = cinfo->master;
+  const float qfmax = m->quant_field_max;
+  jpeg_component_info* comp = &cinfo->comp_info[c];
+  const size_t xsize_blocks = comp->width_in_blocks;
+  JXL_DASSERT(cinfo->max_h_samp_factor % comp->h_samp_factor == 0);
+  JXL_DASSERT(cinfo->max_v_samp_factor % comp->v_samp_factor == 0);
+  const int h_factor = cinfo->max_h_samp_factor / comp->h_samp_factor;
+  const int v_factor = cinfo->max_v_samp_factor / comp->v_samp_factor;
+  RowBuffer<float>* plane = &m->input_buffer[c];
+  const float* qf_row = m->quant_field.Row(by * v_factor);
+  for (size_t bx = 0; bx < xsize_blocks; bx++) {
+    coeff_t* block = &out[bx * kDCTBlockSize];
+    HWY_ALIGN float dct[kDCTBlockSize];
+    TransformFromPixels(jxl::AcStrategy::Type::DCT,
+                        plane->Row(8 * by) + 8 * bx, plane->stride(), dct,
+                        scratch_space);
+    // Create more zeros in areas where jpeg xl would have used a lower
+    // quantization multiplier.
+    float relq = qfmax / qf_row[bx * h_factor];
+    float zero_bias = 0.5f + zero_bias_mul * (relq - 1.0f);
+    zero_bias = std::min(1.5f, zero_bias);
+    for (size_t iy = 0, i = 0; iy < 8; iy++) {
+      for (size_t ix = 0; ix < 8; ix++, i++) {
+        float coeff = 2040 * dct[ix * 8 + iy] * qmc[i];
+        int cc = std::abs(coeff) < zero_bias ? 0 : std::round(coeff);
+        block[i] = cc;
+      }
+    }
+    // Center DC values around zero.
+    block[0] = std::round((2040 * dct[0] - 1024) * qmc[0]);
+  }
+}
+
+void ComputeInvQuantMatrix(j_compress_ptr cinfo, int c, float* qmc) {
+  jpeg_component_info* comp = &cinfo->comp_info[c];
+  JQUANT_TBL* quant_table = cinfo->quant_tbl_ptrs[comp->quant_tbl_no];
+  for (size_t k = 0; k < kDCTBlockSize; k++) {
+    qmc[k] = 1.0f / quant_table->quantval[k];
+  }
+}
+
+void ComputeDCTCoefficients(
+    j_compress_ptr cinfo, jxl::ThreadPool* pool,
+    std::vector<std::vector<jpegli::coeff_t> >* all_coeffs) {
+  float zero_bias_mul[kMaxComponents];
+  ComputeZeroBiasMul(cinfo, zero_bias_mul);
   for (int c = 0; c < cinfo->num_components; c++) {
     jpeg_component_info* comp = &cinfo->comp_info[c];
     const size_t xsize_blocks = comp->width_in_blocks;
     const size_t ysize_blocks = comp->height_in_blocks;
-    JXL_DASSERT(cinfo->max_h_samp_factor % comp->h_samp_factor == 0);
-    JXL_DASSERT(cinfo->max_v_samp_factor % comp->v_samp_factor == 0);
-    const int h_factor = cinfo->max_h_samp_factor / comp->h_samp_factor;
-    const int v_factor = cinfo->max_v_samp_factor / comp->v_samp_factor;
     std::vector<coeff_t> coeffs(xsize_blocks * ysize_blocks * kDCTBlockSize);
-    JQUANT_TBL* quant_table = cinfo->quant_tbl_ptrs[comp->quant_tbl_no];
-    std::vector<float> qmc(kDCTBlockSize);
-    for (size_t k = 0; k < kDCTBlockSize; k++) {
-      qmc[k] = 1.0f / quant_table->quantval[k];
-    }
-    RowBuffer<float>* plane = &m->input_buffer[c];
-    for (size_t by = 0, bix = 0; by < ysize_blocks; by++) {
-      for (size_t bx = 0; bx < xsize_blocks; bx++, bix++) {
-        coeff_t* block = &coeffs[bix * kDCTBlockSize];
-        HWY_ALIGN float dct[kDCTBlockSize];
-        TransformFromPixels(jxl::AcStrategy::Type::DCT,
-                            plane->Row(8 * by) + 8 * bx, plane->stride(), dct,
-                            scratch_space);
-        // Create more zeros in areas where jpeg xl would have used a lower
-        // quantization multiplier.
-        float relq = qfmax / m->quant_field.Row(by * v_factor)[bx * h_factor];
-        float zero_bias = 0.5f + zero_bias_mul[c] * (relq - 1.0f);
-        zero_bias = std::min(1.5f, zero_bias);
-        for (size_t iy = 0, i = 0; iy < 8; iy++) {
-          for (size_t ix = 0; ix < 8; ix++, i++) {
-            float coeff = 2040 * dct[ix * 8 + iy] * qmc[i];
-            int cc = std::abs(coeff) < zero_bias ? 0 : std::round(coeff);
-            block[i] = cc;
-          }
-        }
-        // Center DC values around zero.
-        block[0] = std::round((2040 * dct[0] - 1024) * qmc[0]);
-      }
+    float qmc[kDCTBlockSize];
+    ComputeInvQuantMatrix(cinfo, c, qmc);
+    const auto compute_block_row = [&](const uint32_t by, size_t /*thread*/) {
+      HWY_ALIGN float scratch_space[2 * kDCTBlockSize];
+      ComputeDCTBlockRow(cinfo, c, by, zero_bias_mul[c], qmc,
+                         &coeffs[by * xsize_blocks * kDCTBlockSize],
+                         scratch_space);
+    };
+    if (!jxl::RunOnPool(pool, 0, ysize_blocks, jxl::ThreadPool::NoInit,
+                        compute_block_row, "DCT")) {
+      JPEGLI_ERROR("Parallel runner failed.");
     }
     all_coeffs->emplace_back(std::move(coeffs));
   }
 }
 
+void ComputeDCTCoefficientRows(j_compress_ptr cinfo, int c, size_t by0,
+                               size_t by1, coeff_t* out) {
+  float zero_bias_mul[kMaxComponents];
+  ComputeZeroBiasMul(cinfo, zero_bias_mul);
+  float qmc[kDCTBlockSize];
+  ComputeInvQuantMatrix(cinfo, c, qmc);
+  const size_t xsize_blocks = cinfo->comp_info[c].width_in_blocks;
+  HWY_ALIGN float scratch_space[2 * kDCTBlockSize];
+  for (size_t by = by0; by < by1; ++by) {
+    ComputeDCTBlockRow(cinfo, c, by, zero_bias_mul[c], qmc,
+                       &out[(by - by0) * xsize_blocks * kDCTBlockSize],
+                       scratch_space);
+  }
+}
+
 // NOLINTNEXTLINE(google-readability-namespace-comments)
 }  // namespace HWY_NAMESPACE
 }  // namespace jpegli
@@ -85,10 +130,63 @@ HWY_AFTER_NAMESPACE();
 namespace jpegli {
 
 HWY_EXPORT(ComputeDCTCoefficients);
+HWY_EXPORT(ComputeDCTCoefficientRows);
 
 void ComputeDCTCoefficients(
-    j_compress_ptr cinfo, std::vector<std::vector<jpegli::coeff_t> >* coeffs) {
-  HWY_DYNAMIC_DISPATCH(ComputeDCTCoefficients)(cinfo, coeffs);
+    j_compress_ptr cinfo, jxl::ThreadPool* pool,
+    std::vector<std::vector<jpegli::coeff_t> >* coeffs) {
+  HWY_DYNAMIC_DISPATCH(ComputeDCTCoefficients)(cinfo, pool, coeffs);
+}
+
+void CoeffBuffer::InitFullImage(j_compress_ptr cinfo,
+                                std::vector<std::vector<coeff_t> >&& coeffs) {
+  cinfo_ = cinfo;
+  streaming_ = false;
+  coeffs_ = std::move(coeffs);
+  for (int c = 0; c < cinfo->num_components; ++c) {
+    jpeg_component_info* comp = &cinfo->comp_info[c];
+    xsize_blocks_[c] = comp->width_in_blocks;
+    first_row_[c] = 0;
+    num_rows_[c] = comp->height_in_blocks;
+  }
+}
+
+void CoeffBuffer::InitStreaming(j_compress_ptr cinfo) {
+  cinfo_ = cinfo;
+  streaming_ = true;
+  coeffs_.resize(cinfo->num_components);
+  for (int c = 0; c < cinfo->num_components; ++c) {
+    jpeg_component_info* comp = &cinfo->comp_info[c];
+    xsize_blocks_[c] = comp->width_in_blocks;
+    first_row_[c] = 0;
+    num_rows_[c] = 0;
+    coeffs_[c].resize(comp->v_samp_factor * comp->width_in_blocks *
+                      kDCTBlockSize);
+  }
+}
+
+void CoeffBuffer::LoadRows(int c, size_t by) {
+  JXL_DASSERT(streaming_);
+  jpeg_component_info* comp = &cinfo_->comp_info[c];
+  const size_t rows_per_iMCU = comp->v_samp_factor;
+  const size_t by0 = by - by % rows_per_iMCU;
+  const size_t by1 = std::min<size_t>(by0 + rows_per_iMCU,
+                                      comp->height_in_blocks);
+  coeff_t* out = coeffs_[c].data();
+  if (cinfo_->global_state == kEncWriteCoeffs) {
+    static_assert(sizeof(coeff_t) == sizeof(JCOEF), "Unexpected JCOEF size");
+    jvirt_barray_ptr coeff_buffer = cinfo_->master->coeff_buffers[c];
+    for (size_t iy = by0; iy < by1; ++iy) {
+      JBLOCKARRAY ba = (*cinfo_->mem->access_virt_barray)(
+          reinterpret_cast<j_common_ptr>(cinfo_), coeff_buffer, iy, 1, false);
+      memcpy(&out[(iy - by0) * xsize_blocks_[c] * kDCTBlockSize], ba[0],
+             xsize_blocks_[c] * sizeof(ba[0][0]));
+    }
+  } else {
+    HWY_DYNAMIC_DISPATCH(ComputeDCTCoefficientRows)(cinfo_, c, by0, by1, out);
+  }
+  first_row_[c] = by0;
+  num_rows_[c] = by1 - by0;
 }
 
 }  // namespace jpegli
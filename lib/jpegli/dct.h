@@ -14,12 +14,46 @@
 #include <vector>
 
 #include "lib/jpegli/encode_internal.h"
+#include "lib/jxl/base/data_parallel.h"
 
 namespace jpegli {
 
-void ComputeDCTCoefficients(j_compress_ptr cinfo,
+void ComputeDCTCoefficients(j_compress_ptr cinfo, jxl::ThreadPool* pool,
                             std::vector<std::vector<jpegli::coeff_t> >* coeffs);
 
+// Gives access to the quantized DCT coefficients of the image, either from a
+// complete coefficient image, or from a window of one iMCU row per component.
+// In the latter case, the coefficients are computed from the input buffer (or
+// copied from the coefficient arrays given to jpegli_write_coefficients()) when
+// a block outside of the current window is accessed, so the block rows of each
+// component must be accessed in increasing order within a pass.
+class CoeffBuffer {
+ public:
+  void InitFullImage(j_compress_ptr cinfo,
+                     std::vector<std::vector<coeff_t> >&& coeffs);
+  void InitStreaming(j_compress_ptr cinfo);
+
+  bool streaming() const { return streaming_; }
+
+  const coeff_t* Block(int c, size_t by, size_t bx) {
+    if (by - first_row_[c] >= num_rows_[c]) {
+      LoadRows(c, by);
+    }
+    return &coeffs_[c][((by - first_row_[c]) * xsize_blocks_[c] + bx) *
+                       DCTSIZE2];
+  }
+
+ private:
+  void LoadRows(int c, size_t by);
+
+  j_compress_ptr cinfo_ = nullptr;
+  bool streaming_ = false;
+  std::vector<std::vector<coeff_t> > coeffs_;
+  size_t xsize_blocks_[kMaxComponents] = {};
+  size_t first_row_[kMaxComponents] = {};
+  size_t num_rows_[kMaxComponents] = {};
+};
+
 }  // namespace jpegli
 
 #endif  // LIB_JPEGLI_DCT_H_
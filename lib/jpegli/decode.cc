@@ -224,9 +224,47 @@ void jpegli_calc_output_dimensions(j_decompress_ptr cinfo) {
   if (!m->found_sof_) {
     JPEGLI_ERROR("No SOF marker found.");
   }
-  // Resampling is not yet implemented.
-  cinfo->output_width = cinfo->image_width;
-  cinfo->output_height = cinfo->image_height;
+  if (cinfo->scale_num == 0 || cinfo->scale_denom == 0) {
+    JPEGLI_ERROR("Invalid scaling factor %u/%u", cinfo->scale_num,
+                 cinfo->scale_denom);
+  }
+  // Same as in libjpeg 6b, scaling factors of 1/8, 1/4 and 1/2 are supported,
+  // by computing reduced size inverse DCTs, other factors are rounded down to
+  // one of these, or to 1 if they are larger than 1/2.
+  size_t dct_size = DCTSIZE;
+  if (cinfo->scale_num * 8 <= cinfo->scale_denom) {
+    dct_size = 1;
+  } else if (cinfo->scale_num * 4 <= cinfo->scale_denom) {
+    dct_size = 2;
+  } else if (cinfo->scale_num * 2 <= cinfo->scale_denom) {
+    dct_size = 4;
+  }
+  m->scaled_dct_size_ = dct_size;
+#if JPEG_LIB_VERSION >= 70
+  cinfo->min_DCT_h_scaled_size = dct_size;
+  cinfo->min_DCT_v_scaled_size = dct_size;
+#else
+  cinfo->min_DCT_scaled_size = dct_size;
+#endif
+  for (int c = 0; c < cinfo->num_components; ++c) {
+    jpeg_component_info* comp = &cinfo->comp_info[c];
+#if JPEG_LIB_VERSION >= 70
+    comp->DCT_h_scaled_size = dct_size;
+    comp->DCT_v_scaled_size = dct_size;
+#else
+    comp->DCT_scaled_size = dct_size;
+#endif
+    comp->downsampled_width = jpegli::DivCeil(
+        cinfo->image_width * comp->h_samp_factor * dct_size,
+        cinfo->max_h_samp_factor * DCTSIZE);
+    comp->downsampled_height = jpegli::DivCeil(
+        cinfo->image_height * comp->v_samp_factor * dct_size,
+        cinfo->max_v_samp_factor * DCTSIZE);
+  }
+  cinfo->output_width =
+      jpegli::DivCeil(cinfo->image_width * dct_size, DCTSIZE);
+  cinfo->output_height =
+      jpegli::DivCeil(cinfo->image_height * dct_size, DCTSIZE);
   cinfo->output_components = cinfo->out_color_components;
   cinfo->rec_outbuf_height = 1;
 }
@@ -361,6 +399,9 @@ void jpegli_crop_scanline(j_decompress_ptr cinfo, JDIMENSION* xoffset,
   }
   // TODO(szabadka) Skip the IDCT for skipped over blocks.
   size_t xend = *xoffset + *width;
+  // The output rows are loaded from xoffset with aligned vector loads of up to
+  // 8 floats, so the offset stays a multiple of 8 output samples also when the
+  // output is scaled.
   *xoffset = (*xoffset / DCTSIZE) * DCTSIZE;
   *width = xend - *xoffset;
   cinfo->master->xoffset_ = *xoffset;
@@ -375,7 +416,8 @@ JDIMENSION jpegli_read_raw_data(j_decompress_ptr cinfo, JSAMPIMAGE data,
     JPEGLI_ERROR("jpegli_read_raw_data: unexpected state %d",
                  cinfo->global_state);
   }
-  size_t iMCU_height = cinfo->max_v_samp_factor * DCTSIZE;
+  size_t iMCU_height =
+      cinfo->max_v_samp_factor * cinfo->master->scaled_dct_size_;
   if (max_lines < iMCU_height) {
     JPEGLI_ERROR("jpegli_read_raw_data: output buffer too small");
   }
@@ -413,6 +455,13 @@ boolean jpegli_resync_to_restart(j_decompress_ptr cinfo, int desired) {
   return TRUE;
 }
 
+void jpegli_set_decoder_parallel_runner(j_decompress_ptr cinfo,
+                                        JpegliParallelRunner runner,
+                                        void* runner_opaque) {
+  cinfo->master->runner_ = runner;
+  cinfo->master->runner_opaque_ = runner_opaque;
+}
+
 void jpegli_set_output_format(j_decompress_ptr cinfo, JpegliDataType data_type,
                               JpegliEndianness endianness) {
   cinfo->master->output_data_type_ = data_type;
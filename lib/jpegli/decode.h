@@ -97,6 +97,13 @@ void jpegli_destroy_decompress(j_decompress_ptr cinfo);
 void jpegli_set_output_format(j_decompress_ptr cinfo, JpegliDataType data_type,
                               JpegliEndianness endianness);
 
+// Sets the parallel runner used by the decoder. If the input has restart
+// intervals, the intervals that are available in the input buffer are entropy
+// decoded concurrently, except for the refinement scans of progressive images.
+void jpegli_set_decoder_parallel_runner(j_decompress_ptr cinfo,
+                                        JpegliParallelRunner runner,
+                                        void* runner_opaque);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  // extern "C"
 #endif
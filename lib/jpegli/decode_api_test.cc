@@ -21,7 +21,8 @@ namespace jpegli {
 namespace {
 
 void DecodeWithLibJpeg(const std::vector<uint8_t>& compressed,
-                       volatile size_t* xsize, volatile size_t* ysize,
+                       unsigned int scale_denom, volatile size_t* xsize,
+                       volatile size_t* ysize,
                        volatile size_t* num_channels,
                        std::vector<uint8_t>* pixels) {
   jpeg_decompress_struct cinfo = {};
@@ -40,13 +41,15 @@ void DecodeWithLibJpeg(const std::vector<uint8_t>& compressed,
   jpeg_create_decompress(&cinfo);
   jpeg_mem_src(&cinfo, compressed.data(), compressed.size());
   jpeg_read_header(&cinfo, TRUE);
-  *xsize = cinfo.image_width;
-  *ysize = cinfo.image_height;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = scale_denom;
   jpeg_start_decompress(&cinfo);
+  *xsize = cinfo.output_width;
+  *ysize = cinfo.output_height;
   *num_channels = cinfo.output_components;
-  const size_t stride = cinfo.output_components * cinfo.image_width;
-  pixels->resize(cinfo.image_height * stride);
-  for (size_t y = 0; y < cinfo.image_height; ++y) {
+  const size_t stride = cinfo.output_components * cinfo.output_width;
+  pixels->resize(cinfo.output_height * stride);
+  for (size_t y = 0; y < cinfo.output_height; ++y) {
     JSAMPROW rows[] = {&(*pixels)[stride * y]};
     jpeg_read_scanlines(&cinfo, rows, 1);
     jxl::msan::UnpoisonMemory(rows[0], stride);
@@ -168,6 +171,8 @@ struct TestConfig {
   bool raw_output = false;
   JpegliDataType data_type = JPEGLI_TYPE_UINT8;
   JpegliEndianness endianness = JPEGLI_NATIVE_ENDIAN;
+  bool use_parallel_runner = false;
+  unsigned int scale_denom = 1;
 };
 
 bool LoadNextChunk(const TestConfig& config, j_decompress_ptr cinfo) {
@@ -209,7 +214,8 @@ TEST_P(DecodeAPITestParam, TestAPI) {
   // These has to be volatile to make setjmp/longjmp work.
   volatile size_t xsize, ysize, num_channels;
   std::vector<uint8_t> orig;
-  DecodeWithLibJpeg(compressed, &xsize, &ysize, &num_channels, &orig);
+  DecodeWithLibJpeg(compressed, config.scale_denom, &xsize, &ysize,
+                    &num_channels, &orig);
 
   jpeg_decompress_struct cinfo;
   jpeg_error_mgr jerr;
@@ -267,11 +273,18 @@ TEST_P(DecodeAPITestParam, TestAPI) {
 
   ASSERT_EQ(JPEG_REACHED_SOS, jpegli_consume_input(&cinfo));
 
-  EXPECT_EQ(xsize, cinfo.image_width);
-  EXPECT_EQ(ysize, cinfo.image_height);
+  if (config.scale_denom == 1) {
+    EXPECT_EQ(xsize, cinfo.image_width);
+    EXPECT_EQ(ysize, cinfo.image_height);
+  }
   EXPECT_EQ(num_channels, cinfo.num_components);
 
   jpegli_set_output_format(&cinfo, config.data_type, config.endianness);
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = config.scale_denom;
+  if (config.use_parallel_runner) {
+    jpegli_set_decoder_parallel_runner(&cinfo, &TestParallelRunner, nullptr);
+  }
 
   if (jpegli_has_multiple_scans(&cinfo) && config.buffered_image_mode) {
     cinfo.buffered_image = TRUE;
@@ -592,6 +605,23 @@ std::vector<TestConfig> GenerateTests() {
       }
     }
   }
+  {
+    for (size_t chunk_size : {0, 64, 65536}) {
+      for (bool pre_consume : {false, true}) {
+        TestConfig config;
+        config.fn = "jxl/flower/flower.png.im_q85_420_R13B.jpg";
+        config.fn_desc = "Q85YUV420R13B";
+        config.chunk_size = chunk_size;
+        config.pre_consume_input = pre_consume;
+        config.use_parallel_runner = true;
+        all_tests.push_back(config);
+        if (config.chunk_size != 0) {
+          config.source_mgr = SOURCE_MGR_SUSPENDING;
+          all_tests.push_back(config);
+        }
+      }
+    }
+  }
   {
     for (JpegliDataType type : {JPEGLI_TYPE_UINT16, JPEGLI_TYPE_FLOAT}) {
       for (JpegliEndianness endianness :
@@ -605,6 +635,29 @@ std::vector<TestConfig> GenerateTests() {
       }
     }
   }
+  {
+    std::vector<std::pair<std::string, std::string>> testfiles({
+        {"jxl/flower/flower.png.im_q85_444.jpg", "Q85YUV444"},
+        {"jxl/flower/flower.png.im_q85_420.jpg", "Q85YUV420"},
+        {"jxl/flower/flower.png.im_q85_420_progr.jpg", "Q85YUV420PROGR"},
+    });
+    for (const auto& it : testfiles) {
+      for (unsigned int scale_denom : {2, 4, 8}) {
+        for (bool crop : {false, true}) {
+          TestConfig config;
+          config.fn = it.first;
+          config.fn_desc = it.second;
+          config.scale_denom = scale_denom;
+          config.crop = crop;
+          // The reduced size inverse DCTs and the chroma upsampling at the
+          // scaled resolution are not the same as those of libjpeg, but a
+          // crop that is off by a few samples would be much further away.
+          config.max_distance = 1.5;
+          all_tests.push_back(config);
+        }
+      }
+    }
+  }
   {
     TestConfig config;
     config.fn = "jxl/flower/flower_small.cmyk.jpg";
@@ -642,6 +695,12 @@ std::ostream& operator<<(std::ostream& os, const TestConfig& c) {
   } else if (c.raw_output) {
     os << "Raw";
   }
+  if (c.use_parallel_runner) {
+    os << "Parallel";
+  }
+  if (c.scale_denom != 1) {
+    os << "Scale1of" << c.scale_denom;
+  }
   os << DataTypeString(c.data_type);
   if (c.data_type != JPEGLI_TYPE_UINT8) {
     os << EndiannessString(c.endianness);
@@ -0,0 +1,125 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+/* clang-format off */
+#include <stdio.h>
+#include <jpeglib.h>
+/* clang-format on */
+
+#include <stdlib.h>
+
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lib/jpegli/decode.h"
+#include "lib/jpegli/encode.h"
+
+namespace jpegli {
+namespace {
+
+constexpr size_t kXSize = 1024;
+constexpr size_t kYSize = 1024;
+constexpr int kNumChannels = 3;
+
+// Returns a JPEG encoding of a noisy gradient image with jpegli.
+std::vector<uint8_t> CreateTestJpeg(bool progressive) {
+  std::mt19937 rng(1234);
+  std::vector<uint8_t> pixels(kXSize * kYSize * kNumChannels);
+  for (size_t y = 0, i = 0; y < kYSize; ++y) {
+    for (size_t x = 0; x < kXSize; ++x) {
+      for (int c = 0; c < kNumChannels; ++c, ++i) {
+        const int noise = rng() % 32;
+        pixels[i] = (((x + y) >> 3) + 64 * c + noise) & 0xff;
+      }
+    }
+  }
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpegli_std_error(&jerr);
+  jpegli_create_compress(&cinfo);
+  unsigned char* buffer = nullptr;
+  unsigned long size = 0;  // NOLINT
+  jpegli_mem_dest(&cinfo, &buffer, &size);
+  cinfo.image_width = kXSize;
+  cinfo.image_height = kYSize;
+  cinfo.input_components = kNumChannels;
+  cinfo.in_color_space = JCS_RGB;
+  jpegli_set_defaults(&cinfo);
+  jpegli_set_quality(&cinfo, 90, TRUE);
+  jpegli_set_progressive_level(&cinfo, progressive ? 2 : 0);
+  jpegli_start_compress(&cinfo, TRUE);
+  for (size_t y = 0; y < kYSize; ++y) {
+    JSAMPROW row[] = {&pixels[y * kXSize * kNumChannels]};
+    jpegli_write_scanlines(&cinfo, row, 1);
+  }
+  jpegli_finish_compress(&cinfo);
+  jpegli_destroy_compress(&cinfo);
+  std::vector<uint8_t> compressed(buffer, buffer + size);
+  free(buffer);
+  return compressed;
+}
+
+void DecodeWithJpegli(const std::vector<uint8_t>& compressed,
+                      std::vector<uint8_t>* pixels) {
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpegli_std_error(&jerr);
+  jpegli_create_decompress(&cinfo);
+  jpegli_mem_src(&cinfo, compressed.data(), compressed.size());
+  jpegli_read_header(&cinfo, TRUE);
+  jpegli_start_decompress(&cinfo);
+  const size_t stride = cinfo.output_width * cinfo.output_components;
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row[] = {&(*pixels)[cinfo.output_scanline * stride]};
+    jpegli_read_scanlines(&cinfo, row, 1);
+  }
+  jpegli_finish_decompress(&cinfo);
+  jpegli_destroy_decompress(&cinfo);
+}
+
+void DecodeWithLibJpeg(const std::vector<uint8_t>& compressed,
+                       std::vector<uint8_t>* pixels) {
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, compressed.data(), compressed.size());
+  jpeg_read_header(&cinfo, TRUE);
+  jpeg_start_decompress(&cinfo);
+  const size_t stride = cinfo.output_width * cinfo.output_components;
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row[] = {&(*pixels)[cinfo.output_scanline * stride]};
+    jpeg_read_scanlines(&cinfo, row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+}
+
+// Measures the decoding speed of jpegli and of the libjpeg implementation the
+// benchmark is linked with (e.g. libjpeg-turbo) on the same input.
+template <void (*Decode)(const std::vector<uint8_t>&, std::vector<uint8_t>*)>
+void BM_Decode(benchmark::State& state) {
+  const bool progressive = state.range(0);
+  const std::vector<uint8_t> compressed = CreateTestJpeg(progressive);
+  std::vector<uint8_t> pixels(kXSize * kYSize * kNumChannels);
+  for (auto _ : state) {
+    Decode(compressed, &pixels);
+  }
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+  state.counters["compressed_size"] = compressed.size();
+}
+
+BENCHMARK_TEMPLATE(BM_Decode, DecodeWithJpegli)
+    ->ArgName("progressive")
+    ->Arg(0)
+    ->Arg(1);
+BENCHMARK_TEMPLATE(BM_Decode, DecodeWithLibJpeg)
+    ->ArgName("progressive")
+    ->Arg(0)
+    ->Arg(1);
+
+}  // namespace
+}  // namespace jpegli
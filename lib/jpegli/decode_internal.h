@@ -61,6 +61,7 @@ struct jpeg_decomp_master {
   std::vector<jpegli::DecJPEGComponent> components_;
   std::vector<jpegli::HuffmanTableEntry> dc_huff_lut_;
   std::vector<jpegli::HuffmanTableEntry> ac_huff_lut_;
+  std::vector<int32_t> ac_huff_fast_lut_;
   uint8_t huff_slot_defined_[256] = {};
   std::set<int> markers_to_save_;
   jpeg_marker_parser_method app_marker_parsers[16];
@@ -85,15 +86,25 @@ struct jpeg_decomp_master {
   int eobrun_;
   int restarts_to_go_;
   int next_restart_marker_;
+  // Set when decoding restart intervals in parallel failed. The rest of the
+  // scan is then decoded sequentially, which reports the error.
+  bool sequential_scan_;
 
   jpegli::MCUCodingState mcu_;
 
+  // Parallel runner used for decoding restart intervals concurrently.
+  JpegliParallelRunner runner_ = nullptr;
+  void* runner_opaque_ = nullptr;
+
   //
   // Rendering state.
   //
   JpegliDataType output_data_type_ = JPEGLI_TYPE_UINT8;
   bool swap_endianness_ = false;
   size_t xoffset_ = 0;
+  // Size of the pixel block produced by the inverse DCT of one block of
+  // coefficients, less than DCTSIZE when decoding to a scaled output.
+  size_t scaled_dct_size_ = DCTSIZE;
 
   JSAMPARRAY scanlines_;
   JDIMENSION max_lines_;
@@ -141,6 +141,8 @@ void ProcessSOF(j_decompress_ptr cinfo, const uint8_t* data, size_t len) {
     cinfo->out_color_space = JCS_CMYK;
   }
   cinfo->out_color_components = cinfo->num_components;
+  cinfo->scale_num = 1;
+  cinfo->scale_denom = 1;
 
   // We have checked above that none of the sampling factors are 0, so the max
   // sampling factors can not be 0.
@@ -290,6 +292,7 @@ void ProcessSOS(j_decompress_ptr cinfo, const uint8_t* data, size_t len) {
   memset(m->last_dc_coeff_, 0, sizeof(m->last_dc_coeff_));
   m->restarts_to_go_ = cinfo->restart_interval;
   m->next_restart_marker_ = 0;
+  m->sequential_scan_ = false;
   m->eobrun_ = -1;
   m->scan_mcu_row_ = 0;
   m->scan_mcu_col_ = 0;
@@ -307,6 +310,7 @@ void ProcessDHT(j_decompress_ptr cinfo, const uint8_t* data, size_t len) {
   constexpr int kLutSize = NUM_HUFF_TBLS * kJpegHuffmanLutSize;
   m->dc_huff_lut_.resize(kLutSize);
   m->ac_huff_lut_.resize(kLutSize);
+  m->ac_huff_fast_lut_.resize(NUM_HUFF_TBLS * kJpegHuffmanFastLutSize);
   size_t pos = 4;
   if (pos == len) {
     return JPEGLI_ERROR("DHT marker: no Huffman table found");
@@ -389,6 +393,11 @@ void ProcessDHT(j_decompress_ptr cinfo, const uint8_t* data, size_t len) {
       }
     }
     BuildJpegHuffmanTable(&counts[0], &values[0], huff_lut);
+    if (is_ac_table) {
+      BuildJpegHuffmanFastACTable(
+          huff_lut,
+          &m->ac_huff_fast_lut_[huffman_index * kJpegHuffmanFastLutSize]);
+    }
   }
   JPEG_VERIFY_MARKER_END();
 }
@@ -7,9 +7,16 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
 #include "lib/jpegli/decode_internal.h"
 #include "lib/jpegli/error.h"
 #include "lib/jpegli/source_manager.h"
+#include "lib/jxl/base/byte_order.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
 
 namespace jpegli {
@@ -21,6 +28,12 @@ namespace {
 // Max 2 bytes per 8 bits (worst case is all bytes are escaped 0xff)
 constexpr int kMaxMCUByteSize = 6048;
 
+// Returns non-zero if and only if x has a zero byte, i.e. one of
+// x & 0xff, x & 0xff00, ..., x & 0xff00000000000000 is zero.
+static JXL_INLINE uint64_t HasZeroByte(uint64_t x) {
+  return (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+}
+
 // Helper structure to read bits from the entropy coded data segment.
 struct BitReaderState {
   BitReaderState(const uint8_t* data, const size_t len, size_t pos)
@@ -58,6 +71,23 @@ struct BitReaderState {
 
   void FillBitWindow() {
     if (bits_left_ <= 16) {
+      // Fast path: if the next 8 bytes are before the next marker and none of
+      // them is 0xff, there are no escape sequences to skip, and we can append
+      // them to the bit window at once.
+      if (pos_ + 8 <= next_marker_pos_) {
+        const uint64_t bytes = LoadBE64(&data_[pos_]);
+        if (!HasZeroByte(~bytes)) {
+          const int nbytes = (64 - bits_left_) >> 3;
+          if (nbytes == 8) {
+            val_ = bytes;
+          } else {
+            val_ = (val_ << (8 * nbytes)) | (bytes >> (64 - 8 * nbytes));
+          }
+          pos_ += nbytes;
+          bits_left_ += 8 * nbytes;
+          return;
+        }
+      }
       while (bits_left_ <= 56) {
         val_ <<= 8;
         val_ |= (uint64_t)GetNextByte();
@@ -168,9 +198,9 @@ int HuffExtend(int x, int s) {
 
 // Decodes one 8x8 block of DCT coefficients from the bit stream.
 bool DecodeDCTBlock(const HuffmanTableEntry* dc_huff,
-                    const HuffmanTableEntry* ac_huff, int Ss, int Se, int Al,
-                    int* eobrun, BitReaderState* br, coeff_t* last_dc_coeff,
-                    coeff_t* coeffs) {
+                    const HuffmanTableEntry* ac_huff, const int32_t* ac_fast,
+                    int Ss, int Se, int Al, int* eobrun, BitReaderState* br,
+                    coeff_t* last_dc_coeff, coeff_t* coeffs) {
   // Nowadays multiplication is even faster than variable shift.
   int Am = 1 << Al;
   bool eobrun_allowed = Ss > 0;
@@ -202,6 +232,23 @@ bool DecodeDCTBlock(const HuffmanTableEntry* dc_huff,
     return true;
   }
   for (int k = Ss; k <= Se; k++) {
+    // Try to decode the symbol and its extra bits with a single lookup.
+    br->FillBitWindow();
+    const int32_t fast = ac_fast[(br->val_ >> (br->bits_left_ -
+                                               kJpegHuffmanFastBits)) &
+                                 (kJpegHuffmanFastLutSize - 1)];
+    if (fast != 0) {
+      k += (fast >> 4) & 15;
+      if (k > Se) {
+        return false;
+      }
+      if (((fast >> 8) & 15) + Al >= kJpegDCAlphabetSize) {
+        return false;
+      }
+      br->bits_left_ -= fast & 15;
+      coeffs[kJPEGNaturalOrder[k]] = (fast >> 12) * Am;
+      continue;
+    }
     int sr = ReadSymbol(ac_huff, br);
     if (sr >= kJpegHuffmanAlphabetSize) {
       return false;
@@ -376,6 +423,126 @@ void RestoreMCUCodingState(j_decompress_ptr cinfo) {
   }
 }
 
+// Decodes the MCU at the given MCU row and column of the current scan.
+bool DecodeMCU(j_decompress_ptr cinfo, size_t mcu_y, size_t mcu_x,
+               BitReaderState* br, coeff_t* last_dc_coeff, int* eobrun) {
+  jpeg_decomp_master* m = cinfo->master;
+  bool scan_ok = true;
+  for (int i = 0; i < cinfo->comps_in_scan; ++i) {
+    const jpeg_component_info* comp = cinfo->cur_comp_info[i];
+    DecJPEGComponent* c = &m->components_[comp->component_index];
+    const HuffmanTableEntry* dc_lut =
+        &m->dc_huff_lut_[comp->dc_tbl_no * kJpegHuffmanLutSize];
+    const HuffmanTableEntry* ac_lut =
+        &m->ac_huff_lut_[comp->ac_tbl_no * kJpegHuffmanLutSize];
+    const int32_t* ac_fast_lut =
+        &m->ac_huff_fast_lut_[comp->ac_tbl_no * kJpegHuffmanFastLutSize];
+    for (int iy = 0; iy < comp->MCU_height; ++iy) {
+      int block_y = mcu_y * comp->MCU_height + iy;
+      for (int ix = 0; ix < comp->MCU_width; ++ix) {
+        int block_x = mcu_x * comp->MCU_width + ix;
+        int block_idx = block_y * comp->width_in_blocks + block_x;
+        coeff_t* coeffs = &c->coeffs[block_idx * DCTSIZE2];
+        if (cinfo->Ah == 0) {
+          if (!DecodeDCTBlock(dc_lut, ac_lut, ac_fast_lut, cinfo->Ss,
+                              cinfo->Se, cinfo->Al, eobrun, br,
+                              &last_dc_coeff[comp->component_index], coeffs)) {
+            scan_ok = false;
+          }
+        } else {
+          if (!RefineDCTBlock(ac_lut, cinfo->Ss, cinfo->Se, cinfo->Al, eobrun,
+                              br, coeffs)) {
+            scan_ok = false;
+          }
+        }
+      }
+    }
+  }
+  return scan_ok;
+}
+
+// Returns the position of the next marker in data[pos, len), or len if there
+// is no marker there.
+size_t FindNextMarker(const uint8_t* data, size_t len, size_t pos) {
+  while (pos + 1 < len) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(
+        memchr(&data[pos], 0xff, len - 1 - pos));
+    if (p == nullptr) break;
+    pos = p - data;
+    if (data[pos + 1] != 0) return pos;
+    pos += 2;
+  }
+  return len;
+}
+
+// Decodes the restart intervals of the current scan that are completely
+// available in the input in parallel, starting from data[*pos], which must be
+// the start of a restart interval. Returns the number of decoded MCUs and
+// updates *pos to the position of the marker after the last decoded interval.
+// Returns zero if there were not enough complete intervals in the input, or if
+// decoding one of them failed. In the latter case, the rest of the scan is
+// marked to be decoded sequentially, which reports the error.
+size_t DecodeRestartIntervals(j_decompress_ptr cinfo, const uint8_t* data,
+                              size_t len, size_t* pos) {
+  jpeg_decomp_master* m = cinfo->master;
+  const size_t restart_interval = cinfo->restart_interval;
+  const size_t MCUs_per_row = cinfo->MCUs_per_row;
+  const size_t num_MCUs = cinfo->MCU_rows_in_scan * MCUs_per_row;
+  const size_t first_mcu = m->scan_mcu_row_ * MCUs_per_row + m->scan_mcu_col_;
+  // Byte ranges of the entropy coded segments of the complete intervals.
+  std::vector<std::pair<size_t, size_t>> intervals;
+  size_t begin = *pos;
+  int next_restart_marker = m->next_restart_marker_;
+  for (size_t mcu = first_mcu; mcu < num_MCUs; mcu += restart_interval) {
+    size_t end = FindNextMarker(data, len, begin);
+    if (end + 2 > len) break;
+    const bool is_last = mcu + restart_interval >= num_MCUs;
+    if (!is_last && data[end + 1] != 0xd0 + next_restart_marker) break;
+    intervals.emplace_back(begin, end);
+    next_restart_marker = (next_restart_marker + 1) & 0x7;
+    begin = end + 2;
+  }
+  if (intervals.size() < 2) {
+    return 0;
+  }
+  std::atomic<bool> all_ok{true};
+  const auto decode_interval = [&](const uint32_t i, size_t /*thread*/) {
+    BitReaderState br(data, len, intervals[i].first);
+    coeff_t last_dc_coeff[kMaxComponents] = {0};
+    int eobrun = -1;
+    const size_t mcu_begin = first_mcu + i * restart_interval;
+    const size_t mcu_end = std::min(num_MCUs, mcu_begin + restart_interval);
+    bool ok = true;
+    for (size_t mcu = mcu_begin; mcu < mcu_end; ++mcu) {
+      ok &= DecodeMCU(cinfo, mcu / MCUs_per_row, mcu % MCUs_per_row, &br,
+                      last_dc_coeff, &eobrun);
+    }
+    size_t stream_pos;
+    size_t bit_pos;
+    ok &= br.FinishStream(&stream_pos, &bit_pos);
+    if (bit_pos > 0) ++stream_pos;
+    if (!ok || eobrun > 0 || stream_pos != intervals[i].second) {
+      all_ok = false;
+    }
+  };
+  jxl::ThreadPool pool(m->runner_, m->runner_opaque_);
+  if (!pool.Run(0, intervals.size(), jxl::ThreadPool::NoInit, decode_interval,
+                "DecodeRestartIntervals")) {
+    JPEGLI_ERROR("Parallel runner failed.");
+  }
+  if (!all_ok) {
+    m->sequential_scan_ = true;
+    return 0;
+  }
+  *pos = intervals.back().second;
+  m->next_restart_marker_ =
+      (m->next_restart_marker_ + intervals.size() - 1) & 0x7;
+  m->restarts_to_go_ = 0;
+  m->eobrun_ = 0;
+  memset(m->last_dc_coeff_, 0, sizeof(m->last_dc_coeff_));
+  return std::min(num_MCUs - first_mcu, intervals.size() * restart_interval);
+}
+
 }  // namespace
 
 int ProcessScan(j_decompress_ptr cinfo) {
@@ -417,6 +584,32 @@ int ProcessScan(j_decompress_ptr cinfo) {
     }
 
     size_t start_pos = pos;
+    // Decode all available complete restart intervals in parallel if we are
+    // at the start of one. Refinement scans update the coefficients in place,
+    // so they are always decoded sequentially.
+    if (m->runner_ != nullptr && !m->sequential_scan_ &&
+        cinfo->restart_interval > 0 &&
+        m->restarts_to_go_ == static_cast<int>(cinfo->restart_interval) &&
+        m->codestream_bits_ahead_ == 0 && cinfo->Ah == 0) {
+      size_t num_decoded = DecodeRestartIntervals(cinfo, data, len, &pos);
+      if (num_decoded > 0) {
+        AdvanceInput(cinfo, pos - start_pos);
+        const size_t prev_iMCU_row =
+            m->scan_mcu_row_ / m->mcu_rows_per_iMCU_row_;
+        size_t mcu =
+            m->scan_mcu_row_ * cinfo->MCUs_per_row + m->scan_mcu_col_;
+        mcu += num_decoded;
+        m->scan_mcu_row_ = mcu / cinfo->MCUs_per_row;
+        m->scan_mcu_col_ = mcu % cinfo->MCUs_per_row;
+        if (m->scan_mcu_row_ == cinfo->MCU_rows_in_scan ||
+            m->scan_mcu_row_ / m->mcu_rows_per_iMCU_row_ > prev_iMCU_row) {
+          // We completed the scan or at least one iMCU row.
+          break;
+        }
+        continue;
+      }
+    }
+
     BitReaderState br(data, len, start_pos);
     if (m->codestream_bits_ahead_ > 0) {
       br.ReadBits(m->codestream_bits_ahead_);
@@ -426,36 +619,8 @@ int ProcessScan(j_decompress_ptr cinfo) {
     }
 
     // Decode one MCU.
-    bool scan_ok = true;
-    for (int i = 0; i < cinfo->comps_in_scan; ++i) {
-      const jpeg_component_info* comp = cinfo->cur_comp_info[i];
-      DecJPEGComponent* c = &m->components_[comp->component_index];
-      const HuffmanTableEntry* dc_lut =
-          &m->dc_huff_lut_[comp->dc_tbl_no * kJpegHuffmanLutSize];
-      const HuffmanTableEntry* ac_lut =
-          &m->ac_huff_lut_[comp->ac_tbl_no * kJpegHuffmanLutSize];
-      for (int iy = 0; iy < comp->MCU_height; ++iy) {
-        int block_y = m->scan_mcu_row_ * comp->MCU_height + iy;
-        for (int ix = 0; ix < comp->MCU_width; ++ix) {
-          int block_x = m->scan_mcu_col_ * comp->MCU_width + ix;
-          int block_idx = block_y * comp->width_in_blocks + block_x;
-          coeff_t* coeffs = &c->coeffs[block_idx * DCTSIZE2];
-          if (cinfo->Ah == 0) {
-            if (!DecodeDCTBlock(dc_lut, ac_lut, cinfo->Ss, cinfo->Se, cinfo->Al,
-                                &m->eobrun_, &br,
-                                &m->last_dc_coeff_[comp->component_index],
-                                coeffs)) {
-              scan_ok = false;
-            }
-          } else {
-            if (!RefineDCTBlock(ac_lut, cinfo->Ss, cinfo->Se, cinfo->Al,
-                                &m->eobrun_, &br, coeffs)) {
-              scan_ok = false;
-            }
-          }
-        }
-      }
-    }
+    bool scan_ok = DecodeMCU(cinfo, m->scan_mcu_row_, m->scan_mcu_col_, &br,
+                             m->last_dc_coeff_, &m->eobrun_);
     size_t bit_pos;
     size_t stream_pos;
     bool stream_ok = br.FinishStream(&stream_pos, &bit_pos);
@@ -504,9 +669,13 @@ int ProcessScan(j_decompress_ptr cinfo) {
       }
     }
   }
-  ++cinfo->input_iMCU_row;
-  return (m->scan_mcu_row_ == cinfo->MCU_rows_in_scan ? JPEG_SCAN_COMPLETED
-                                                      : JPEG_ROW_COMPLETED);
+  // Several iMCU rows might have been completed if restart intervals were
+  // decoded in parallel.
+  const bool scan_completed = (m->scan_mcu_row_ == cinfo->MCU_rows_in_scan);
+  cinfo->input_iMCU_row =
+      scan_completed ? DivCeil(m->scan_mcu_row_, m->mcu_rows_per_iMCU_row_)
+                     : m->scan_mcu_row_ / m->mcu_rows_per_iMCU_row_;
+  return scan_completed ? JPEG_SCAN_COMPLETED : JPEG_ROW_COMPLETED;
 }
 
 }  // namespace jpegli
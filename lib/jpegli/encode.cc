@@ -19,6 +19,7 @@
 #include "lib/jpegli/memory_manager.h"
 #include "lib/jpegli/quant.h"
 #include "lib/jxl/base/byte_order.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/span.h"
 
 namespace jpegli {
@@ -95,7 +96,28 @@ bool CheckColorSpaceComponents(int num_components, J_COLOR_SPACE colorspace) {
   }
 }
 
-void ColorTransform(j_compress_ptr cinfo) {
+// Runs func(y) for every row y of the input image, in bands of rows on the
+// thread pool.
+template <typename Func>
+void RunOnImageRows(j_compress_ptr cinfo, jxl::ThreadPool* pool,
+                    const Func& func) {
+  constexpr size_t kRowsPerTask = 64;
+  const size_t num_rows = cinfo->image_height;
+  if (!jxl::RunOnPool(
+      pool, 0, DivCeil(num_rows, kRowsPerTask), jxl::ThreadPool::NoInit,
+      [&](const uint32_t task, size_t /*thread*/) {
+        const size_t y0 = task * kRowsPerTask;
+        const size_t y1 = std::min(num_rows, y0 + kRowsPerTask);
+        for (size_t y = y0; y < y1; ++y) {
+          func(y);
+        }
+      },
+      "ColorTransform")) {
+    JPEGLI_ERROR("Parallel runner failed.");
+  }
+}
+
+void ColorTransform(j_compress_ptr cinfo, jxl::ThreadPool* pool) {
   jpeg_comp_master* m = cinfo->master;
 
   if (!CheckColorSpaceComponents(cinfo->input_components,
@@ -124,10 +146,10 @@ void ColorTransform(j_compress_ptr cinfo) {
 
   if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
     if (cinfo->in_color_space == JCS_RGB) {
-      for (size_t y = 0; y < cinfo->image_height; ++y) {
+      RunOnImageRows(cinfo, pool, [&](size_t y) {
         RGBToYCbCr(m->input_buffer[0].Row(y), m->input_buffer[1].Row(y),
                    m->input_buffer[2].Row(y), cinfo->image_width);
-      }
+      });
     } else if (cinfo->in_color_space == JCS_YCbCr ||
                cinfo->in_color_space == JCS_YCCK) {
       // Since the first luminance channel is the grayscale version of the
@@ -135,18 +157,18 @@ void ColorTransform(j_compress_ptr cinfo) {
     }
   } else if (cinfo->jpeg_color_space == JCS_YCbCr) {
     if (cinfo->in_color_space == JCS_RGB) {
-      for (size_t y = 0; y < cinfo->image_height; ++y) {
+      RunOnImageRows(cinfo, pool, [&](size_t y) {
         RGBToYCbCr(m->input_buffer[0].Row(y), m->input_buffer[1].Row(y),
                    m->input_buffer[2].Row(y), cinfo->image_width);
-      }
+      });
     }
   } else if (cinfo->jpeg_color_space == JCS_YCCK) {
     if (cinfo->in_color_space == JCS_CMYK) {
-      for (size_t y = 0; y < cinfo->image_height; ++y) {
+      RunOnImageRows(cinfo, pool, [&](size_t y) {
         CMYKToYCCK(m->input_buffer[0].Row(y), m->input_buffer[1].Row(y),
                    m->input_buffer[2].Row(y), m->input_buffer[3].Row(y),
                    cinfo->image_width);
-      }
+      });
     }
   } else {
     // TODO(szabadka) Support more color transforms.
@@ -213,6 +235,17 @@ void DownsampleComponents(j_compress_ptr cinfo) {
   }
 }
 
+// Lookup table for the conversion of 8-bit samples to the [0.0, 1.0] range. It
+// gives the same values as the computation in double precision, but it is much
+// cheaper per sample.
+struct U8ToFloatTable {
+  U8ToFloatTable() {
+    static constexpr double kMul8 = 1.0 / 255.0;
+    for (int i = 0; i < 256; ++i) values[i] = i * kMul8;
+  }
+  float values[256];
+};
+
 void ReadLine(const uint8_t* row_in, size_t xsize, size_t c,
               size_t num_components, JpegliDataType data_type,
               JpegliEndianness endianness, float* row_out) {
@@ -220,16 +253,24 @@ void ReadLine(const uint8_t* row_in, size_t xsize, size_t c,
     memset(row_out, 0, xsize * sizeof(row_out[0]));
     return;
   }
-  static constexpr double kMul8 = 1.0 / 255.0;
   static constexpr double kMul16 = 1.0 / 65535.0;
   const int pwidth = num_components * jpegli_bytes_per_sample(data_type);
   bool is_little_endian =
       (endianness == JPEGLI_LITTLE_ENDIAN ||
        (endianness == JPEGLI_NATIVE_ENDIAN && IsLittleEndian()));
   if (data_type == JPEGLI_TYPE_UINT8) {
-    const uint8_t* p = &row_in[c];
-    for (size_t x = 0; x < xsize; ++x, p += pwidth) {
-      row_out[x] = p[0] * kMul8;
+    static const U8ToFloatTable kU8ToFloat;
+    const float* lut = kU8ToFloat.values;
+    if (pwidth == 1) {
+      // Planar input, e.g. raw data or grayscale images.
+      for (size_t x = 0; x < xsize; ++x) {
+        row_out[x] = lut[row_in[x]];
+      }
+    } else {
+      const uint8_t* p = &row_in[c];
+      for (size_t x = 0; x < xsize; ++x, p += pwidth) {
+        row_out[x] = lut[p[0]];
+      }
     }
   } else if (data_type == JPEGLI_TYPE_UINT16 && is_little_endian) {
     const uint8_t* p = &row_in[c * 2];
@@ -814,6 +855,14 @@ void jpegli_write_icc_profile(j_compress_ptr cinfo, const JOCTET* icc_data_ptr,
   cinfo->master->next_marker_byte = nullptr;
 }
 
+void jpegli_set_parallel_runner(j_compress_ptr cinfo,
+                                JpegliParallelRunner runner,
+                                void* runner_opaque) {
+  CheckState(cinfo, jpegli::kEncStart, jpegli::kEncHeader);
+  cinfo->master->runner = runner;
+  cinfo->master->runner_opaque = runner_opaque;
+}
+
 void jpegli_set_input_format(j_compress_ptr cinfo, JpegliDataType data_type,
                              JpegliEndianness endianness) {
   CheckState(cinfo, jpegli::kEncHeader);
@@ -881,13 +930,17 @@ void jpegli_finish_compress(j_compress_ptr cinfo) {
                  cinfo->image_height, cinfo->next_scanline);
   }
 
+  jpeg_comp_master* m = cinfo->master;
+  jxl::ThreadPool thread_pool(m->runner, m->runner_opaque);
+  jxl::ThreadPool* pool = m->runner != nullptr ? &thread_pool : nullptr;
+
   if (!cinfo->raw_data_in && cinfo->global_state != jpegli::kEncWriteCoeffs) {
-    jpegli::ColorTransform(cinfo);
+    jpegli::ColorTransform(cinfo, pool);
     jpegli::PadInputToBlockMultiple(cinfo);
     jpegli::DownsampleComponents(cinfo);
   }
   if (cinfo->global_state != jpegli::kEncWriteCoeffs) {
-    jpegli::ComputeAdaptiveQuantField(cinfo);
+    jpegli::ComputeAdaptiveQuantField(cinfo, pool);
   }
 
   //
@@ -909,7 +962,7 @@ void jpegli_finish_compress(j_compress_ptr cinfo) {
   }
 
   // APPn, COM
-  for (const auto& v : cinfo->master->special_markers) {
+  for (const auto& v : m->special_markers) {
     jpegli::WriteOutput(cinfo, v);
   }
 
@@ -920,11 +973,23 @@ void jpegli_finish_compress(j_compress_ptr cinfo) {
   // SOF
   jpegli::EncodeSOF(cinfo);
 
-  std::vector<std::vector<jpegli::coeff_t>> coeffs;
-  if (cinfo->global_state == jpegli::kEncWriteCoeffs) {
-    jpegli::CopyCoefficients(cinfo, &coeffs);
+  // Without a parallel runner, the quantized coefficients are produced one
+  // iMCU row at a time while gathering the Huffman statistics and again while
+  // writing the scans, instead of keeping the whole coefficient image in
+  // memory. This is done for sequential output and for coefficients given to
+  // jpegli_write_coefficients(), where producing them again is cheap.
+  jpegli::CoeffBuffer coeffs;
+  const bool write_coeffs = cinfo->global_state == jpegli::kEncWriteCoeffs;
+  if (pool == nullptr && (write_coeffs || !cinfo->progressive_mode)) {
+    coeffs.InitStreaming(cinfo);
   } else {
-    jpegli::ComputeDCTCoefficients(cinfo, &coeffs);
+    std::vector<std::vector<jpegli::coeff_t>> all_coeffs;
+    if (write_coeffs) {
+      jpegli::CopyCoefficients(cinfo, &all_coeffs);
+    } else {
+      jpegli::ComputeDCTCoefficients(cinfo, pool, &all_coeffs);
+    }
+    coeffs.InitFullImage(cinfo, std::move(all_coeffs));
   }
 
   if (cinfo->scan_info == nullptr) {
@@ -937,7 +1002,7 @@ void jpegli_finish_compress(j_compress_ptr cinfo) {
 
   std::vector<jpegli::JPEGHuffmanCode> huffman_codes;
   if (cinfo->optimize_coding || cinfo->progressive_mode) {
-    jpegli::OptimizeHuffmanCodes(cinfo, coeffs, &huffman_codes);
+    jpegli::OptimizeHuffmanCodes(cinfo, &coeffs, &huffman_codes);
   } else {
     jpegli::CopyHuffmanCodes(cinfo, &huffman_codes);
   }
@@ -951,11 +1016,11 @@ void jpegli_finish_compress(j_compress_ptr cinfo) {
       jpegli::EncodeDRI(cinfo);
       last_restart_interval = cinfo->restart_interval;
     }
-    size_t num_dht = cinfo->master->scan_coding_info[i].num_huffman_codes;
+    size_t num_dht = m->scan_coding_info[i].num_huffman_codes;
     jpegli::EncodeDHT(cinfo, &huffman_codes[dht_index], num_dht);
     dht_index += num_dht;
     jpegli::EncodeSOS(cinfo, i);
-    if (!jpegli::EncodeScan(cinfo, coeffs, i)) {
+    if (!jpegli::EncodeScan(cinfo, &coeffs, i, pool)) {
       JPEGLI_ERROR("Failed to encode scan.");
     }
   }
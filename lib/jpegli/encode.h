@@ -131,6 +131,16 @@ void jpegli_set_progressive_level(j_compress_ptr cinfo, int level);
 // AC coefficients.
 void jpegli_use_standard_quant_tables(j_compress_ptr cinfo);
 
+// Sets the parallel runner used by the encoder for the color transform,
+// adaptive quantization and DCT passes. If the scans have restart intervals
+// (see restart_interval and restart_in_rows), the restart interval segments
+// are entropy coded in parallel as well. The output does not depend on whether
+// a parallel runner is set or not. Passing a nullptr runner restores the
+// default single-threaded encoding.
+void jpegli_set_parallel_runner(j_compress_ptr cinfo,
+                                JpegliParallelRunner runner,
+                                void* runner_opaque);
+
 #if defined(__cplusplus) || defined(c_plusplus)
 }  // extern "C"
 #endif
@@ -138,6 +138,7 @@ struct TestConfig {
   bool use_flat_dc_luma_code = false;
   bool xyb_mode = false;
   bool libjpeg_mode = false;
+  bool use_parallel_runner = false;
   double max_bpp;
   double max_dist;
 
@@ -502,6 +503,9 @@ bool EncodeWithJpegli(const TestConfig& config,
     jpegli_use_standard_quant_tables(&cinfo);
     jpegli_set_progressive_level(&cinfo, 0);
   }
+  if (config.use_parallel_runner) {
+    jpegli_set_parallel_runner(&cinfo, &TestParallelRunner, nullptr);
+  }
   if (!config.write_coeffs) {
     jpegli_start_compress(&cinfo, TRUE);
     if (config.add_marker) {
@@ -1027,6 +1031,25 @@ JPEGLI_INSTANTIATE_TEST_SUITE_P(EncodeAPITest, EncodeAPITestParam,
                                 testing::ValuesIn(GenerateTests()),
                                 TestDescription);
 
+TEST(EncodeAPITest, ParallelRunner) {
+  std::vector<TestConfig> configs(4);
+  configs[1].restart_interval = 3;
+  configs[2].restart_in_rows = 1;
+  configs[3].restart_in_rows = 2;
+  configs[3].progressive_level = 0;
+  configs[3].h_sampling[0] = configs[3].v_sampling[0] = 2;
+  configs[3].custom_sampling = true;
+  for (TestConfig& config : configs) {
+    GeneratePixels(&config);
+    std::vector<uint8_t> compressed;
+    ASSERT_TRUE(EncodeWithJpegli(config, &compressed));
+    config.use_parallel_runner = true;
+    std::vector<uint8_t> compressed_parallel;
+    ASSERT_TRUE(EncodeWithJpegli(config, &compressed_parallel));
+    EXPECT_EQ(compressed, compressed_parallel);
+  }
+}
+
 TEST(EncodeAPITest, AbbreviatedStreams) {
   MyClientData data;
   jpeg_compress_struct cinfo;
@@ -77,6 +77,8 @@ struct jpeg_comp_master {
   jpegli::RowBuffer<float> quant_field;
   float quant_field_max = jpegli::kDefaultQuantFieldMax;
   jvirt_barray_ptr* coeff_buffers = nullptr;
+  JpegliParallelRunner runner = nullptr;
+  void* runner_opaque = nullptr;
 };
 
 #endif  // LIB_JPEGLI_ENCODE_INTERNAL_H_
@@ -202,18 +202,18 @@ bool ProcessDCTBlockSequential(const coeff_t* coeffs, Histogram* dc_histo,
   int dc_nbits = (temp == 0) ? 0 : (jxl::FloorLog2Nonzero<uint32_t>(temp) + 1);
   ++dc_histo->count[dc_nbits];
   if (dc_nbits >= 12) return false;
-  int r = 0;
-  for (int k = 1; k < 64; ++k) {
-    if ((temp = coeffs[kJPEGNaturalOrder[k]]) == 0) {
-      r++;
-      continue;
-    }
+  coeff_t zz[kDCTBlockSize];
+  uint64_t nonzero = ZigZagNonzeroMask(coeffs, zz) & ~uint64_t{1};
+  int last_k = 0;
+  while (nonzero != 0) {
+    const int k = jxl::Num0BitsBelowLS1Bit_Nonzero(nonzero);
+    nonzero &= nonzero - 1;
+    int r = k - last_k - 1;
+    last_k = k;
+    temp = zz[k];
     if (temp < 0) {
       temp = -temp;
       if (temp < 0) return false;
-      temp2 = ~temp;
-    } else {
-      temp2 = temp;
     }
     while (r > 15) {
       ++ac_histo->count[0xf0];
@@ -223,8 +223,8 @@ bool ProcessDCTBlockSequential(const coeff_t* coeffs, Histogram* dc_histo,
     if (ac_nbits >= 16) return false;
     int symbol = (r << 4u) + ac_nbits;
     ++ac_histo->count[symbol];
-    r = 0;
   }
+  int r = 63 - last_k;
   for (int i = 0; i < num_zero_runs; ++i) {
     ++ac_histo->count[0xf0];
     r -= 16;
@@ -354,9 +354,8 @@ bool ProcessRefinementBits(const coeff_t* coeffs, Histogram* ac_histo, int Ss,
   return true;
 }
 
-bool ProcessScan(j_compress_ptr cinfo,
-                 const std::vector<std::vector<jpegli::coeff_t> >& coeffs,
-                 size_t scan_index, int* histo_index, Histogram* dc_histograms,
+bool ProcessScan(j_compress_ptr cinfo, CoeffBuffer* coeffs, size_t scan_index,
+                 int* histo_index, Histogram* dc_histograms,
                  Histogram* ac_histograms) {
   size_t restart_interval = RestartIntervalForScan(cinfo, scan_index);
   int restarts_to_go = restart_interval;
@@ -408,12 +407,11 @@ bool ProcessScan(j_compress_ptr cinfo,
           for (int ix = 0; ix < n_blocks_x; ++ix) {
             size_t block_y = mcu_y * n_blocks_y + iy;
             size_t block_x = mcu_x * n_blocks_x + ix;
-            size_t block_idx = block_y * comp->width_in_blocks + block_x;
             size_t num_zero_runs = 0;
-            const coeff_t* block = &coeffs[comp_idx][block_idx << 6];
-            if (block_x >= comp->width_in_blocks ||
-                block_y >= comp->height_in_blocks) {
-              block = kDummyBlock;
+            const coeff_t* block = kDummyBlock;
+            if (block_x < comp->width_in_blocks &&
+                block_y < comp->height_in_blocks) {
+              block = coeffs->Block(comp_idx, block_y, block_x);
             }
             bool ok;
             if (!is_progressive) {
@@ -438,8 +436,7 @@ bool ProcessScan(j_compress_ptr cinfo,
   return true;
 }
 
-void ProcessJpeg(j_compress_ptr cinfo,
-                 const std::vector<std::vector<jpegli::coeff_t> >& coeffs,
+void ProcessJpeg(j_compress_ptr cinfo, CoeffBuffer* coeffs,
                  std::vector<Histogram>* dc_histograms,
                  std::vector<Histogram>* ac_histograms) {
   int histo_index = 0;
@@ -615,10 +612,8 @@ size_t RestartIntervalForScan(j_compress_ptr cinfo, size_t scan_index) {
   }
 }
 
-void OptimizeHuffmanCodes(
-    j_compress_ptr cinfo,
-    const std::vector<std::vector<jpegli::coeff_t> >& coeffs,
-    std::vector<JPEGHuffmanCode>* huffman_codes) {
+void OptimizeHuffmanCodes(j_compress_ptr cinfo, CoeffBuffer* coeffs,
+                          std::vector<JPEGHuffmanCode>* huffman_codes) {
   // Gather histograms.
   size_t num_histo = 0;
   for (int i = 0; i < cinfo->num_scans; ++i) {
@@ -13,10 +13,38 @@
 
 #include <vector>
 
+#include "lib/jpegli/dct.h"
 #include "lib/jpegli/encode_internal.h"
+#include "lib/jxl/base/byte_order.h"
+#include "lib/jxl/base/compiler_specific.h"
 
 namespace jpegli {
 
+// Copies the coefficients of the block in zig-zag order to zz and returns a
+// mask that has bit k set if and only if zz[k] is not zero. The mask is
+// computed four coefficients at a time using 64-bit words, which lets the
+// block encoders skip runs of zeros by counting the trailing zeros of the mask.
+static JXL_INLINE uint64_t ZigZagNonzeroMask(const coeff_t* block,
+                                             coeff_t* JXL_RESTRICT zz) {
+  for (size_t k = 0; k < kDCTBlockSize; ++k) {
+    zz[k] = block[kJPEGNaturalOrder[k]];
+  }
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(zz);
+  constexpr uint64_t kLow15 = 0x7FFF7FFF7FFF7FFFull;
+  constexpr uint64_t kHigh = 0x8000800080008000ull;
+  // Gathers the bits at positions 0, 16, 32 and 48 into bits 48..51.
+  constexpr uint64_t kGather = 0x0001000200040008ull;
+  uint64_t mask = 0;
+  for (size_t i = 0; i < kDCTBlockSize / 4; ++i) {
+    const uint64_t w = LoadLE64(bytes + 8 * i);
+    // The top bit of each 16-bit lane is set if and only if the lane is not
+    // zero.
+    const uint64_t nonzero = (((w & kLow15) + kLow15) | w) & kHigh;
+    mask |= (((nonzero >> 15) * kGather) >> 48) << (4 * i);
+  }
+  return mask;
+}
+
 void AddStandardHuffmanTables(j_compress_ptr cinfo, bool is_dc);
 
 void CopyHuffmanCodes(j_compress_ptr cinfo,
@@ -24,10 +52,8 @@ void CopyHuffmanCodes(j_compress_ptr cinfo,
 
 size_t RestartIntervalForScan(j_compress_ptr cinfo, size_t scan_index);
 
-void OptimizeHuffmanCodes(
-    j_compress_ptr cinfo,
-    const std::vector<std::vector<jpegli::coeff_t> >& coeffs,
-    std::vector<JPEGHuffmanCode>* huffman_codes);
+void OptimizeHuffmanCodes(j_compress_ptr cinfo, CoeffBuffer* coeffs,
+                          std::vector<JPEGHuffmanCode>* huffman_codes);
 
 }  // namespace jpegli
 
@@ -96,4 +96,30 @@ void BuildJpegHuffmanTable(const uint32_t* count, const uint32_t* symbols,
   }
 }
 
+void BuildJpegHuffmanFastACTable(const HuffmanTableEntry* lut,
+                                 int32_t* fast_lut) {
+  constexpr int kShift = kJpegHuffmanFastBits - kJpegHuffmanRootTableBits;
+  for (int key = 0; key < kJpegHuffmanFastLutSize; ++key) {
+    fast_lut[key] = 0;
+    const HuffmanTableEntry& code = lut[key >> kShift];
+    if (code.bits > kJpegHuffmanRootTableBits ||
+        code.value >= kJpegHuffmanAlphabetSize) {
+      continue;
+    }
+    const int run = code.value >> 4;
+    const int size = code.value & 15;
+    const int total_bits = code.bits + size;
+    if (size == 0 || total_bits > kJpegHuffmanFastBits) {
+      continue;
+    }
+    const int extra =
+        (key >> (kJpegHuffmanFastBits - total_bits)) & ((1 << size) - 1);
+    // The lower half of the extra bits range represents negative values, see
+    // HuffExtend() in decode_scan.cc.
+    const int coeff =
+        extra >= (1 << (size - 1)) ? extra : extra - (1 << size) + 1;
+    fast_lut[key] = (coeff * (1 << 12)) | (size << 8) | (run << 4) | total_bits;
+  }
+}
+
 }  // namespace jpegli
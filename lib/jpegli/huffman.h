@@ -20,6 +20,10 @@ constexpr int kJpegHuffmanRootTableBits = 8;
 // max bit length 16 if the root table has 8 bits.
 constexpr int kJpegHuffmanLutSize = 758;
 
+// Number of bits used to index the fast AC lookup tables.
+constexpr int kJpegHuffmanFastBits = 10;
+constexpr int kJpegHuffmanFastLutSize = 1 << kJpegHuffmanFastBits;
+
 struct HuffmanTableEntry {
   // Initialize the value to an invalid symbol so that we can recognize it
   // when reading the bit stream using a Huffman code with space > 0.
@@ -32,6 +36,16 @@ struct HuffmanTableEntry {
 void BuildJpegHuffmanTable(const uint32_t* count, const uint32_t* symbols,
                            HuffmanTableEntry* lut);
 
+// Builds a lookup table for an AC Huffman code that is indexed by the next
+// kJpegHuffmanFastBits bits of the bit stream and decodes a run/size symbol
+// together with its extra bits, if both fit in the index bits. Each non-zero
+// entry is packed as (coeff << 12) | (size << 8) | (run << 4) | total_bits,
+// where coeff is the decoded coefficient value and total_bits is the number of
+// bits used by the symbol and the extra bits. Zero entries mean that the
+// symbol has to be decoded with the regular lookup table.
+void BuildJpegHuffmanFastACTable(const HuffmanTableEntry* lut,
+                                 int32_t* fast_lut);
+
 }  // namespace jpegli
 
 #endif  // LIB_JPEGLI_HUFFMAN_H_
@@ -266,15 +266,42 @@ void ComputeScaledIDCT(float* JXL_RESTRICT block0, float* JXL_RESTRICT block1,
   IDCT1D<8>(block1, output, output_stride);
 }
 
+// Computes the N x N inverse DCT of the top-left N x N coefficients of the
+// block, which is the same as sampling the low-pass filtered 8 x 8 inverse DCT
+// at the centers of the 8/N x 8/N pixel regions.
+template <size_t N>
+void ComputeReducedIDCT(float* JXL_RESTRICT block0, float* JXL_RESTRICT block1,
+                        float* JXL_RESTRICT output, size_t output_stride) {
+  Transpose8x8Block(block0, block1);
+  IDCT1D<N>(block1, block0, 8);
+  Transpose8x8Block(block0, block1);
+  IDCT1D<N>(block1, block0, 8);
+  for (size_t y = 0; y < N; ++y) {
+    for (size_t x = 0; x < N; ++x) {
+      output[y * output_stride + x] = block0[y * 8 + x];
+    }
+  }
+}
+
 void InverseTransformBlock(const int16_t* JXL_RESTRICT qblock,
                            const float* JXL_RESTRICT dequant,
                            const float* JXL_RESTRICT biases,
                            float* JXL_RESTRICT scratch_space,
-                           float* JXL_RESTRICT output, size_t output_stride) {
+                           float* JXL_RESTRICT output, size_t output_stride,
+                           size_t dct_size) {
   float* JXL_RESTRICT block0 = scratch_space;
   float* JXL_RESTRICT block1 = scratch_space + 64;
   DequantBlock(qblock, dequant, biases, block0);
-  ComputeScaledIDCT(block0, block1, output, output_stride);
+  if (dct_size == 8) {
+    ComputeScaledIDCT(block0, block1, output, output_stride);
+  } else if (dct_size == 4) {
+    ComputeReducedIDCT<4>(block0, block1, output, output_stride);
+  } else if (dct_size == 2) {
+    ComputeReducedIDCT<2>(block0, block1, output, output_stride);
+  } else {
+    JXL_DASSERT(dct_size == 1);
+    output[0] = block0[0];
+  }
 }
 
 // NOLINTNEXTLINE(google-readability-namespace-comments)
@@ -291,9 +318,11 @@ void InverseTransformBlock(const int16_t* JXL_RESTRICT qblock,
                            const float* JXL_RESTRICT dequant_matrices,
                            const float* JXL_RESTRICT biases,
                            float* JXL_RESTRICT scratch_space,
-                           float* JXL_RESTRICT output, size_t output_stride) {
+                           float* JXL_RESTRICT output, size_t output_stride,
+                           size_t dct_size) {
   return HWY_DYNAMIC_DISPATCH(InverseTransformBlock)(
-      qblock, dequant_matrices, biases, scratch_space, output, output_stride);
+      qblock, dequant_matrices, biases, scratch_space, output, output_stride,
+      dct_size);
 }
 
 }  // namespace jpegli
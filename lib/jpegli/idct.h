@@ -13,12 +13,15 @@
 
 namespace jpegli {
 
-// Performs dequantization and inverse DCT.
+// Performs dequantization and inverse DCT. The output is a dct_size x dct_size
+// block of pixels, where dct_size is one of 1, 2, 4 or 8, and is computed from
+// the top-left dct_size x dct_size coefficients if dct_size is less than 8.
 void InverseTransformBlock(const int16_t* JXL_RESTRICT qblock,
                            const float* JXL_RESTRICT dequant_matrices,
                            const float* JXL_RESTRICT biases,
                            float* JXL_RESTRICT scratch_space,
-                           float* JXL_RESTRICT output, size_t output_stride);
+                           float* JXL_RESTRICT output, size_t output_stride,
+                           size_t dct_size);
 
 }  // namespace jpegli
 
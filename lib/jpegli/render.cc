@@ -183,6 +183,22 @@ void WriteToOutput(float* JXL_RESTRICT rows[3], size_t xoffset, size_t x0,
   }
 }
 
+// Stores a row of one component directly to the 8-bit output, without going
+// through the scratch space. The length of the row must be a multiple of 8,
+// the row need not be aligned.
+void WriteRowToOutputU8(float* JXL_RESTRICT row, size_t len,
+                        uint8_t* JXL_RESTRICT output) {
+  const HWY_CAPPED(float, 8) d;
+  const Rebind<uint8_t, decltype(d)> du;
+  auto zero = Zero(d);
+  auto one = Set(d, 1.0f);
+  auto mul = Set(d, 255.0f);
+  for (size_t x = 0; x < len; x += Lanes(d)) {
+    auto v = Mul(Clamp(zero, LoadU(d, row + x), one), mul);
+    StoreU(DemoteTo(du, NearestInt(v)), du, output + x);
+  }
+}
+
 // NOLINTNEXTLINE(google-readability-namespace-comments)
 }  // namespace HWY_NAMESPACE
 }  // namespace jpegli
@@ -194,6 +210,7 @@ namespace jpegli {
 
 HWY_EXPORT(GatherBlockStats);
 HWY_EXPORT(WriteToOutput);
+HWY_EXPORT(WriteRowToOutputU8);
 HWY_EXPORT(DecenterRow);
 
 void GatherBlockStats(const int16_t* JXL_RESTRICT coeffs,
@@ -212,6 +229,11 @@ void WriteToOutput(float* JXL_RESTRICT rows[3], size_t xoffset, size_t x0,
       scratch_space, output);
 }
 
+void WriteRowToOutputU8(float* JXL_RESTRICT row, size_t len,
+                        uint8_t* JXL_RESTRICT output) {
+  return HWY_DYNAMIC_DISPATCH(WriteRowToOutputU8)(row, len, output);
+}
+
 void DecenterRow(float* row, size_t xsize) {
   return HWY_DYNAMIC_DISPATCH(DecenterRow)(row, xsize);
 }
@@ -259,15 +281,19 @@ void ComputeOptimalLaplacianBiases(const int num_blocks, const int* nonzeros,
 
 void PrepareForOutput(j_decompress_ptr cinfo) {
   jpeg_decomp_master* m = cinfo->master;
+  const size_t block_size = m->scaled_dct_size_;
   for (int c = 0; c < cinfo->num_components; ++c) {
     const auto& comp = cinfo->comp_info[c];
-    const size_t stride = m->iMCU_cols_ * cinfo->max_h_samp_factor * DCTSIZE;
-    m->raw_height_[c] = cinfo->total_iMCU_rows * comp.v_samp_factor * DCTSIZE;
-    m->raw_output_[c].Allocate(3 * comp.v_samp_factor * DCTSIZE, stride);
+    const size_t stride =
+        m->iMCU_cols_ * cinfo->max_h_samp_factor * block_size;
+    m->raw_height_[c] =
+        cinfo->total_iMCU_rows * comp.v_samp_factor * block_size;
+    m->raw_output_[c].Allocate(3 * comp.v_samp_factor * block_size, stride);
     m->render_output_[c].Allocate(cinfo->max_v_samp_factor, stride);
   }
   m->idct_scratch_ = hwy::AllocateAligned<float>(DCTSIZE2 * 2);
-  size_t MCU_row_stride = m->iMCU_cols_ * cinfo->max_h_samp_factor * DCTSIZE;
+  size_t MCU_row_stride =
+      m->iMCU_cols_ * cinfo->max_h_samp_factor * block_size;
   m->upsample_scratch_ = hwy::AllocateAligned<float>(
       MCU_row_stride + kPaddingLeft + kPaddingRight);
   size_t bytes_per_sample = jpegli_bytes_per_sample(m->output_data_type_);
@@ -301,6 +327,7 @@ void PrepareForOutput(j_decompress_ptr cinfo) {
 void DecodeCurrentiMCURow(j_decompress_ptr cinfo) {
   jpeg_decomp_master* m = cinfo->master;
   const size_t imcu_row = cinfo->output_iMCU_row;
+  const size_t block_size = m->scaled_dct_size_;
   for (int c = 0; c < cinfo->num_components; ++c) {
     size_t k0 = c * DCTSIZE2;
     auto& comp = m->components_[c];
@@ -328,11 +355,12 @@ void DecodeCurrentiMCURow(j_decompress_ptr cinfo) {
       size_t by = block_row + iy;
       size_t bix = by * compinfo.width_in_blocks;
       int16_t* JXL_RESTRICT row_in = &comp.coeffs[bix * DCTSIZE2];
-      float* JXL_RESTRICT row_out = raw_out->Row(by * DCTSIZE);
+      float* JXL_RESTRICT row_out = raw_out->Row(by * block_size);
       for (size_t bx = 0; bx < compinfo.width_in_blocks; ++bx) {
         InverseTransformBlock(&row_in[bx * DCTSIZE2], &m->dequant_[k0],
                               &m->biases_[k0], m->idct_scratch_.get(),
-                              &row_out[bx * DCTSIZE], raw_out->stride());
+                              &row_out[bx * block_size], raw_out->stride(),
+                              block_size);
       }
     }
   }
@@ -341,13 +369,23 @@ void DecodeCurrentiMCURow(j_decompress_ptr cinfo) {
 void ProcessRawOutput(j_decompress_ptr cinfo, JSAMPIMAGE data) {
   jpegli::DecodeCurrentiMCURow(cinfo);
   jpeg_decomp_master* m = cinfo->master;
+  const size_t block_size = m->scaled_dct_size_;
   for (int c = 0; c < cinfo->num_components; ++c) {
     const auto& compinfo = cinfo->comp_info[c];
-    size_t comp_width = compinfo.width_in_blocks * DCTSIZE;
-    size_t comp_height = compinfo.height_in_blocks * DCTSIZE;
-    size_t comp_nrows = compinfo.v_samp_factor * DCTSIZE;
-    size_t y0 = cinfo->output_iMCU_row * compinfo.v_samp_factor * DCTSIZE;
+    size_t comp_width = compinfo.width_in_blocks * block_size;
+    size_t comp_height = compinfo.height_in_blocks * block_size;
+    size_t comp_nrows = compinfo.v_samp_factor * block_size;
+    size_t y0 = cinfo->output_iMCU_row * compinfo.v_samp_factor * block_size;
     size_t y1 = std::min(y0 + comp_nrows, comp_height);
+    // 8-bit output of components whose width is a multiple of 8 samples is
+    // written with whole vectors directly to the output rows.
+    if (m->output_data_type_ == JPEGLI_TYPE_UINT8 && comp_width % 8 == 0) {
+      for (size_t y = y0; y < y1; ++y) {
+        WriteRowToOutputU8(m->raw_output_[c].Row(y), comp_width,
+                           data[c][y - y0]);
+      }
+      continue;
+    }
     for (size_t y = y0; y < y1; ++y) {
       for (size_t x0 = 0; x0 < comp_width; x0 += kTempOutputLen) {
         float* rows[3] = {m->raw_output_[c].Row(y)};
@@ -359,16 +397,17 @@ void ProcessRawOutput(j_decompress_ptr cinfo, JSAMPIMAGE data) {
     }
   }
   ++cinfo->output_iMCU_row;
-  cinfo->output_scanline += cinfo->max_v_samp_factor * DCTSIZE;
+  cinfo->output_scanline += cinfo->max_v_samp_factor * block_size;
 }
 
 void ProcessOutput(j_decompress_ptr cinfo, size_t* num_output_rows,
                    JSAMPARRAY scanlines, size_t max_output_rows) {
   jpeg_decomp_master* m = cinfo->master;
-  size_t xsize_blocks = DivCeil(cinfo->image_width, DCTSIZE);
+  const size_t block_size = m->scaled_dct_size_;
+  const size_t xsize = DivCeil(cinfo->image_width, DCTSIZE) * block_size;
   const int vfactor = cinfo->max_v_samp_factor;
   const size_t imcu_row = cinfo->output_iMCU_row;
-  const size_t imcu_height = vfactor * DCTSIZE;
+  const size_t imcu_height = vfactor * block_size;
   if (imcu_row == cinfo->total_iMCU_rows ||
       (imcu_row > 1 && cinfo->output_scanline < (imcu_row - 1) * imcu_height)) {
     // We are ready to output some scanlines.
@@ -392,7 +431,7 @@ void ProcessOutput(j_decompress_ptr cinfo, size_t* num_output_rows,
           const float* JXL_RESTRICT row_bot =
               yc + 1 == m->raw_height_[c] ? row_mid : raw_out->Row(yc + 1);
           Upsample2Vertical(row_top, row_mid, row_bot, render_out->Row(0),
-                            render_out->Row(1), xsize_blocks * DCTSIZE);
+                            render_out->Row(1), xsize);
         } else {
           JXL_ASSERT(y == static_cast<size_t>(yc));
           for (int yix = 0; yix < vfactor; ++yix) {
@@ -408,10 +447,9 @@ void ProcessOutput(j_decompress_ptr cinfo, size_t* num_output_rows,
           rows[c] = m->render_output_[c].Row(yix);
         }
         if (cinfo->jpeg_color_space == JCS_YCCK) {
-          YCCKToCMYK(rows[0], rows[1], rows[2], rows[3],
-                     xsize_blocks * DCTSIZE);
+          YCCKToCMYK(rows[0], rows[1], rows[2], rows[3], xsize);
         } else if (cinfo->jpeg_color_space == JCS_YCbCr) {
-          YCbCrToRGB(rows[0], rows[1], rows[2], xsize_blocks * DCTSIZE);
+          YCbCrToRGB(rows[0], rows[1], rows[2], xsize);
         } else {
           for (int c = 0; c < cinfo->out_color_components; ++c) {
             // Libjpeg encoder converts all unsigned input values to signed
@@ -419,7 +457,7 @@ void ProcessOutput(j_decompress_ptr cinfo, size_t* num_output_rows,
             // YCbCr jpegs this is undone in the YCbCr -> RGB conversion above
             // by adding 128 to Y channel, but for grayscale and RGB jpegs we
             // need to undo it here channel by channel.
-            DecenterRow(rows[c], xsize_blocks * DCTSIZE);
+            DecenterRow(rows[c], xsize);
           }
         }
         for (size_t x0 = 0; x0 < cinfo->output_width; x0 += kTempOutputLen) {
@@ -443,11 +481,10 @@ void ProcessOutput(j_decompress_ptr cinfo, size_t* num_output_rows,
       const auto& compinfo = cinfo->comp_info[c];
       if (compinfo.h_samp_factor < cinfo->max_h_samp_factor) {
         RowBuffer<float>* raw_out = &m->raw_output_[c];
-        size_t y0 = imcu_row * compinfo.v_samp_factor * DCTSIZE;
-        for (int iy = 0; iy < compinfo.v_samp_factor * DCTSIZE; ++iy) {
+        size_t y0 = imcu_row * compinfo.v_samp_factor * block_size;
+        for (size_t iy = 0; iy < compinfo.v_samp_factor * block_size; ++iy) {
           float* JXL_RESTRICT row = raw_out->Row(y0 + iy);
-          Upsample2Horizontal(row, m->upsample_scratch_.get(),
-                              xsize_blocks * DCTSIZE);
+          Upsample2Horizontal(row, m->upsample_scratch_.get(), xsize);
         }
       }
     }
@@ -3,9 +3,12 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "jxl/parallel_runner.h"
 #include "lib/jxl/base/file_io.h"
 
 // googletest before 1.10 didn't define INSTANTIATE_TEST_SUITE_P() but instead
@@ -27,6 +30,26 @@ static inline std::vector<uint8_t> ReadTestData(const std::string& filename) {
   return data;
 }
 
+// Minimal parallel runner that runs the tasks on a few short-lived threads.
+static inline JxlParallelRetCode TestParallelRunner(
+    void* runner_opaque, void* jpegxl_opaque, JxlParallelRunInit init,
+    JxlParallelRunFunction func, uint32_t start_range, uint32_t end_range) {
+  constexpr size_t kNumThreads = 4;
+  JxlParallelRetCode ret = init(jpegxl_opaque, kNumThreads);
+  if (ret != 0) return ret;
+  std::atomic<uint32_t> next{start_range};
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < kNumThreads; ++thread) {
+    threads.emplace_back([&, thread]() {
+      for (uint32_t i = next++; i < end_range; i = next++) {
+        func(jpegxl_opaque, i, thread);
+      }
+    });
+  }
+  for (std::thread& t : threads) t.join();
+  return 0;
+}
+
 class PNMParser {
  public:
   explicit PNMParser(const uint8_t* data, const size_t len)
@@ -5,6 +5,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <vector>
 
@@ -12,6 +13,7 @@
 #include "lib/jxl/ans_params.h"
 #include "lib/jxl/base/random.h"
 #include "lib/jxl/base/span.h"
+#include "lib/jxl/base/thread_pool_internal.h"
 #include "lib/jxl/dec_ans.h"
 #include "lib/jxl/dec_bit_reader.h"
 #include "lib/jxl/enc_ans.h"
@@ -274,5 +276,89 @@ TEST(ANSTest, TestCheckpointingPrefixLZ77) {
   TestCheckpointing(/*ans=*/false, /*lz77=*/true);
 }
 
+TEST(ANSTest, LZ77ShortChainRoundtrip) {
+  // A random pattern repeated many times, with a few changes in the copies.
+  Rng rng(0);
+  std::vector<Token> pattern;
+  for (size_t i = 0; i < 1000; i++) {
+    pattern.emplace_back(i % 2, rng.UniformU(0, 64));
+  }
+  std::vector<std::vector<Token>> input_values(1);
+  for (size_t rep = 0; rep < 30; rep++) {
+    for (const Token& token : pattern) input_values[0].push_back(token);
+    input_values[0].emplace_back(rep % 2, 64 + rep);
+  }
+
+  std::vector<uint8_t> context_map;
+  EntropyEncodingData codes;
+  HistogramParams params;
+  params.lz77_method = HistogramParams::LZ77Method::kLZ77;
+  params.lz77_max_chain_length = 8;
+  BitWriter writer;
+  auto input_values_copy = input_values;
+  BuildAndEncodeHistograms(params, 2, input_values_copy, &codes, &context_map,
+                           &writer, 0, nullptr);
+  EXPECT_TRUE(codes.lz77.enabled);
+  WriteTokens(input_values_copy[0], codes, context_map, &writer, 0, nullptr);
+  BitWriter::Allotment allotment(&writer, 8);
+  writer.ZeroPadToByte();
+  allotment.ReclaimAndCharge(&writer, 0, nullptr);
+  // Much smaller than the 6 bits per symbol of the pattern.
+  EXPECT_LT(writer.BitsWritten(), 2 * 6 * pattern.size());
+
+  BitReader br(writer.GetSpan());
+  Status status = true;
+  {
+    BitReaderScopedCloser bc(&br, &status);
+    std::vector<uint8_t> dec_context_map;
+    ANSCode decoded_codes;
+    ASSERT_TRUE(DecodeHistograms(&br, 2, &decoded_codes, &dec_context_map));
+    ANSSymbolReader reader(&decoded_codes, &br);
+    for (const Token& symbol : input_values[0]) {
+      uint32_t read_symbol =
+          reader.ReadHybridUint(symbol.context, &br, dec_context_map);
+      ASSERT_EQ(read_symbol, symbol.value);
+    }
+    ASSERT_TRUE(reader.CheckANSFinalState());
+  }
+  EXPECT_TRUE(status);
+}
+
+// Encodes many contexts with different distributions and returns the bytes.
+PaddedBytes EncodeManyContexts(HistogramParams::ClusteringType clustering,
+                               ThreadPool* pool) {
+  constexpr size_t kNumContexts = 300;
+  Rng rng(0);
+  std::vector<std::vector<Token>> input_values(1);
+  for (size_t i = 0; i < 100000; i++) {
+    const uint32_t ctx = rng.UniformU(0, kNumContexts);
+    const uint32_t range = 2 + (ctx * 7) % 40;
+    input_values[0].emplace_back(ctx, (ctx % 5) + rng.UniformU(0, range));
+  }
+  std::vector<uint8_t> context_map;
+  EntropyEncodingData codes;
+  HistogramParams params;
+  params.clustering = clustering;
+  BitWriter writer;
+  BuildAndEncodeHistograms(params, kNumContexts, input_values, &codes,
+                           &context_map, &writer, 0, nullptr, pool);
+  WriteTokens(input_values[0], codes, context_map, &writer, 0, nullptr);
+  BitWriter::Allotment allotment(&writer, 8);
+  writer.ZeroPadToByte();
+  allotment.ReclaimAndCharge(&writer, 0, nullptr);
+  return std::move(writer).TakeBytes();
+}
+
+TEST(ANSTest, HistogramsDoNotDependOnThreadPool) {
+  ThreadPoolInternal pool(8);
+  for (auto clustering : {HistogramParams::ClusteringType::kFast,
+                          HistogramParams::ClusteringType::kBest}) {
+    const PaddedBytes serial = EncodeManyContexts(clustering, nullptr);
+    const PaddedBytes parallel = EncodeManyContexts(clustering, &pool);
+    ASSERT_EQ(serial.size(), parallel.size());
+    EXPECT_EQ(0, memcmp(serial.data(), parallel.data(), serial.size()));
+  }
+}
+
 }  // namespace
 }  // namespace jxl
@@ -30,6 +30,77 @@ bool NeedsBlending(PassesDecoderState* dec_state) {
   return true;
 }
 
+namespace {
+
+bool IsOpaque(const float* alpha, size_t xsize) {
+  for (size_t x = 0; x < xsize; x++) {
+    if (alpha[x] != 1.0f) return false;
+  }
+  return true;
+}
+
+// Returns a blend mode that gives the same result as `blending` on the given
+// row segment and that only combines each sample with the co-located sample
+// of the same channel, or kNumBlendModes if there is no such mode.
+PatchBlendMode PerChannelBlendMode(const PatchBlending& blending,
+                                   bool has_alpha, const float* const* bg,
+                                   const float* const* fg, size_t x0,
+                                   size_t xsize) {
+  switch (blending.mode) {
+    case PatchBlendMode::kNone:
+    case PatchBlendMode::kReplace:
+    case PatchBlendMode::kAdd:
+    case PatchBlendMode::kMul:
+      return blending.mode;
+    case PatchBlendMode::kBlendAbove:
+      // An opaque foreground covers the background.
+      if (!has_alpha || IsOpaque(fg[3 + blending.alpha_channel] + x0, xsize)) {
+        return PatchBlendMode::kReplace;
+      }
+      break;
+    case PatchBlendMode::kBlendBelow:
+      if (!has_alpha) return PatchBlendMode::kReplace;
+      // An opaque background covers the foreground.
+      if (IsOpaque(bg[3 + blending.alpha_channel] + x0, xsize)) {
+        return PatchBlendMode::kNone;
+      }
+      break;
+    case PatchBlendMode::kAlphaWeightedAddAbove:
+    case PatchBlendMode::kAlphaWeightedAddBelow:
+      if (!has_alpha) return PatchBlendMode::kAdd;
+      break;
+    default:
+      break;
+  }
+  return PatchBlendMode::kNumBlendModes;
+}
+
+// Blending where no channel depends on another one can be done in place,
+// without staging the result in a temporary image.
+void PerformPerChannelBlending(const float* bg, const float* fg, float* out,
+                               size_t xsize, PatchBlendMode mode, bool clamp) {
+  switch (mode) {
+    case PatchBlendMode::kAdd:
+      for (size_t x = 0; x < xsize; x++) {
+        out[x] = bg[x] + fg[x];
+      }
+      break;
+    case PatchBlendMode::kMul:
+      PerformMulBlending(bg, fg, out, xsize, clamp);
+      break;
+    case PatchBlendMode::kReplace:
+      if (out != fg) memcpy(out, fg, xsize * sizeof(*out));
+      break;
+    case PatchBlendMode::kNone:
+      if (out != bg) memcpy(out, bg, xsize * sizeof(*out));
+      break;
+    default:
+      JXL_ABORT("Unreachable");
+  }
+}
+
+}  // namespace
+
 void PerformBlending(const float* const* bg, const float* const* fg,
                      float* const* out, size_t x0, size_t xsize,
                      const PatchBlending& color_blending,
@@ -43,6 +114,41 @@ void PerformBlending(const float* const* bg, const float* const* fg,
       break;
     }
   }
+  if (xsize == 0) return;
+
+  // Fast path: all the channels can be blended independently, e.g. kReplace
+  // and kAdd frames, or kBlend frames with an opaque foreground.
+  const PatchBlendMode color_mode =
+      PerChannelBlendMode(color_blending, has_alpha, bg, fg, x0, xsize);
+  bool per_channel = color_mode != PatchBlendMode::kNumBlendModes;
+  // Alpha blending of the color channels also determines the alpha channel.
+  size_t color_alpha = num_ec;
+  if (has_alpha && (color_blending.mode == PatchBlendMode::kBlendAbove ||
+                    color_blending.mode == PatchBlendMode::kBlendBelow)) {
+    color_alpha = color_blending.alpha_channel;
+  }
+  std::vector<PatchBlendMode> ec_modes(num_ec);
+  for (size_t i = 0; per_channel && i < num_ec; i++) {
+    // Alpha-dependent modes of extra channels always use an alpha channel.
+    ec_modes[i] = i == color_alpha
+                      ? color_mode
+                      : PerChannelBlendMode(ec_blending[i], /*has_alpha=*/true,
+                                            bg, fg, x0, xsize);
+    per_channel = ec_modes[i] != PatchBlendMode::kNumBlendModes;
+  }
+  if (per_channel) {
+    for (size_t c = 0; c < 3; c++) {
+      PerformPerChannelBlending(bg[c] + x0, fg[c] + x0, out[c] + x0, xsize,
+                                color_mode, color_blending.clamp);
+    }
+    for (size_t i = 0; i < num_ec; i++) {
+      PerformPerChannelBlending(bg[3 + i] + x0, fg[3 + i] + x0,
+                                out[3 + i] + x0, xsize, ec_modes[i],
+                                ec_blending[i].clamp);
+    }
+    return;
+  }
+
   ImageF tmp(xsize, 3 + num_ec);
   // Blend extra channels first so that we use the pre-blending alpha.
   for (size_t i = 0; i < num_ec; i++) {
@@ -3,6 +3,8 @@
 // Use of this source code is governed by a BSD-style
 // license that can be found in the LICENSE file.
 
+#include "lib/jxl/blending.h"
+
 #include "lib/extras/codec.h"
 #include "lib/jxl/image_test_utils.h"
 #include "lib/jxl/test_utils.h"
@@ -34,5 +36,57 @@ TEST(BlendingTest, Crops) {
   }
 }
 
+TEST(BlendingTest, OpaqueForeground) {
+  constexpr size_t kXSize = 37;
+  std::vector<ExtraChannelInfo> extra_channel_info(1);
+  extra_channel_info[0].type = ExtraChannel::kAlpha;
+  extra_channel_info[0].alpha_associated = false;
+  PatchBlending blending;
+  blending.mode = PatchBlendMode::kBlendAbove;
+  blending.alpha_channel = 0;
+  blending.clamp = false;
+  PatchBlending ec_blending = blending;
+
+  std::vector<float> bg_rows[4];
+  std::vector<float> fg_rows[4];
+  std::vector<float> out_rows[4];
+  const float* bg[4];
+  const float* fg[4];
+  float* out[4];
+  for (size_t c = 0; c < 4; c++) {
+    bg_rows[c].resize(kXSize);
+    fg_rows[c].resize(kXSize);
+    out_rows[c].resize(kXSize);
+    for (size_t x = 0; x < kXSize; x++) {
+      bg_rows[c][x] = c == 3 ? 0.5f : 0.1f * c + 0.01f * x;
+      fg_rows[c][x] = c == 3 ? 1.0f : 0.2f * c - 0.02f * x;
+    }
+    bg[c] = bg_rows[c].data();
+    fg[c] = fg_rows[c].data();
+    out[c] = out_rows[c].data();
+  }
+
+  // Blending an opaque foreground gives the foreground.
+  PerformBlending(bg, fg, out, 0, kXSize, blending, &ec_blending,
+                  extra_channel_info);
+  for (size_t c = 0; c < 4; c++) {
+    for (size_t x = 0; x < kXSize; x++) {
+      EXPECT_EQ(out_rows[c][x], fg_rows[c][x]);
+    }
+  }
+
+  // With a translucent pixel the general path is used.
+  fg_rows[3][kXSize / 2] = 0.5f;
+  PerformBlending(bg, fg, out, 0, kXSize, blending, &ec_blending,
+                  extra_channel_info);
+  EXPECT_FLOAT_EQ(out_rows[3][kXSize / 2], 0.75f);
+  for (size_t c = 0; c < 3; c++) {
+    const size_t x = kXSize / 2;
+    EXPECT_NEAR(out_rows[c][x],
+                (fg_rows[c][x] * 0.5f + bg_rows[c][x] * 0.5f * 0.5f) / 0.75f,
+                1e-6f);
+  }
+}
+
 }  // namespace
 }  // namespace jxl
@@ -1797,6 +1797,55 @@ double ButteraugliScoreFromDiffmap(const ImageF& diffmap,
   return retval;
 }
 
+void ButteraugliDiffmapOfRect(const Image3F& rgb0, const Image3F& rgb1,
+                              const ButteraugliParams& params, const Rect& rect,
+                              ImageF& diffmap) {
+  JXL_DASSERT(SameSize(rgb0, rgb1) && SameSize(rgb0, diffmap));
+  JXL_DASSERT(rect.x0() % 2 == 0 && rect.y0() % 2 == 0);
+  const size_t margin = kButteraugliDiffmapMargin;
+  const size_t x0 = rect.x0() > margin ? rect.x0() - margin : 0;
+  const size_t y0 = rect.y0() > margin ? rect.y0() - margin : 0;
+  const Rect crop(x0, y0, rect.x1() + margin - x0, rect.y1() + margin - y0,
+                  rgb0.xsize(), rgb0.ysize());
+  ImageF crop_diffmap(crop.xsize(), crop.ysize());
+  {
+    Image3F crop_rgb(crop.xsize(), crop.ysize());
+    CopyImageTo(crop, rgb0, Rect(crop_rgb), &crop_rgb);
+    ButteraugliComparator butteraugli(crop_rgb, params);
+    CopyImageTo(crop, rgb1, Rect(crop_rgb), &crop_rgb);
+    butteraugli.Diffmap(crop_rgb, crop_diffmap);
+  }
+  CopyImageTo(Rect(rect.x0() - x0, rect.y0() - y0, rect.xsize(), rect.ysize()),
+              crop_diffmap, rect, &diffmap);
+}
+
+// Rows of the diffmap computed per strip, even like the margin.
+static const size_t kStripRows = 256;
+
+void ButteraugliDiffmapInStrips(const Image3F& rgb0, const Image3F& rgb1,
+                                const ButteraugliParams& params,
+                                ThreadPool* pool, ImageF& diffmap) {
+  PROFILER_FUNC;
+  JXL_CHECK(SameSize(rgb0, rgb1));
+  const size_t xsize = rgb0.xsize();
+  const size_t ysize = rgb0.ysize();
+  if (ysize <= kStripRows + 2 * kButteraugliDiffmapMargin) {
+    ButteraugliComparator butteraugli(rgb0, params);
+    butteraugli.Diffmap(rgb1, diffmap);
+    return;
+  }
+  diffmap = ImageF(xsize, ysize);
+  const size_t num_strips = DivCeil(ysize, kStripRows);
+  JXL_CHECK(RunOnPool(
+      pool, 0, num_strips, ThreadPool::NoInit,
+      [&](const uint32_t strip, size_t /*thread*/) {
+        const Rect rect(0, strip * kStripRows, xsize, kStripRows, xsize,
+                        ysize);
+        ButteraugliDiffmapOfRect(rgb0, rgb1, params, rect, diffmap);
+      },
+      "ButteraugliStrips"));
+}
+
 bool ButteraugliDiffmap(const Image3F& rgb0, const Image3F& rgb1,
                         double hf_asymmetry, double xmul, ImageF& diffmap) {
   ButteraugliParams params;
@@ -1851,8 +1900,7 @@ bool ButteraugliDiffmap(const Image3F& rgb0, const Image3F& rgb1,
     }
     return ok;
   }
-  ButteraugliComparator butteraugli(rgb0, params);
-  butteraugli.Diffmap(rgb1, diffmap);
+  ButteraugliDiffmapInStrips(rgb0, rgb1, params, /*pool=*/nullptr, diffmap);
   return true;
 }
 
@@ -19,6 +19,7 @@
 #include <vector>
 
 #include "lib/jxl/base/compiler_specific.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/common.h"
 #include "lib/jxl/image.h"
 #include "lib/jxl/image_ops.h"
@@ -197,6 +198,29 @@ bool ButteraugliDiffmap(const Image3F &rgb0, const Image3F &rgb1,
 bool ButteraugliDiffmap(const Image3F &rgb0, const Image3F &rgb1,
                         const ButteraugliParams &params, ImageF &diffmap);
 
+// Rows and columns around a part of the images that can change the diffmap of
+// that part. The diffmap of a pixel depends on pixels up to 37 pixels away at
+// full resolution (blurs, Malta filter and fuzzy erosion), and 37 pixels at
+// half resolution, i.e. 74 + 1 pixels. Even, so that crops are subsampled in
+// the same way as the whole images.
+constexpr size_t kButteraugliDiffmapMargin = 80;
+
+// Sets `rect` of `diffmap`, which must have the size of the images, to the
+// same values as ButteraugliComparator(rgb0, params).Diffmap() would, but only
+// looks at the images within kButteraugliDiffmapMargin of `rect`. The origin
+// of `rect` must be even.
+void ButteraugliDiffmapOfRect(const Image3F &rgb0, const Image3F &rgb1,
+                              const ButteraugliParams &params, const Rect &rect,
+                              ImageF &diffmap);
+
+// Computes the same diffmap as ButteraugliComparator(rgb0, params).Diffmap(),
+// but in overlapping horizontal strips, so that the intermediate images only
+// need memory proportional to the strip size instead of the image size. The
+// strips are processed in parallel on `pool`, which may be null.
+void ButteraugliDiffmapInStrips(const Image3F &rgb0, const Image3F &rgb1,
+                                const ButteraugliParams &params,
+                                ThreadPool *pool, ImageF &diffmap);
+
 double ButteraugliScoreFromDiffmap(const ImageF &diffmap,
                                    const ButteraugliParams *params = nullptr);
 
@@ -7,6 +7,15 @@
 
 #include "gtest/gtest.h"
 #include "jxl/butteraugli_cxx.h"
+#include "lib/jxl/base/thread_pool_internal.h"
+#include "lib/jxl/butteraugli/butteraugli.h"
+#include "lib/jxl/color_encoding_internal.h"
+#include "lib/jxl/enc_butteraugli_comparator.h"
+#include "lib/jxl/enc_color_management.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/image_bundle.h"
+#include "lib/jxl/image_ops.h"
+#include "lib/jxl/image_test_utils.h"
 #include "lib/jxl/test_utils.h"
 
 TEST(ButteraugliTest, Lossless) {
@@ -100,3 +109,130 @@ TEST(ButteraugliTest, Api) {
 
   EXPECT_NE(distance1, distance2);
 }
+
+TEST(ButteraugliTest, Reference) {
+  uint32_t xsize = 171;
+  uint32_t ysize = 219;
+  std::vector<uint8_t> orig_pixels =
+      jxl::test::GetSomeTestImage(xsize, ysize, 4, 0);
+  JxlPixelFormat pixel_format = {4, JXL_TYPE_UINT16, JXL_BIG_ENDIAN, 0};
+  JxlPixelFormat pixel_format_rgb = {3, JXL_TYPE_UINT16, JXL_BIG_ENDIAN, 0};
+
+  JxlButteraugliApiPtr api(JxlButteraugliApiCreate(nullptr));
+  JxlButteraugliReferencePtr reference(
+      JxlButteraugliReferenceCreate(api.get(), xsize, ysize, &pixel_format,
+                                    orig_pixels.data(), orig_pixels.size()));
+  ASSERT_TRUE(reference);
+
+  for (int i = 0; i < 4; ++i) {
+    const JxlPixelFormat& dist_format =
+        (i & 1) ? pixel_format_rgb : pixel_format;
+    std::vector<uint8_t> dist_pixels = jxl::test::GetSomeTestImage(
+        xsize, ysize, dist_format.num_channels, i / 2);
+    dist_pixels[0] += 128;
+
+    JxlButteraugliResultPtr expected(JxlButteraugliCompute(
+        api.get(), xsize, ysize, &pixel_format, orig_pixels.data(),
+        orig_pixels.size(), &dist_format, dist_pixels.data(),
+        dist_pixels.size()));
+    JxlButteraugliResultPtr result(JxlButteraugliCompareWithReference(
+        api.get(), reference.get(), &dist_format, dist_pixels.data(),
+        dist_pixels.size()));
+    ASSERT_TRUE(expected);
+    ASSERT_TRUE(result);
+    EXPECT_NE(0.0, JxlButteraugliResultGetDistance(result.get(), 8.0));
+    EXPECT_EQ(JxlButteraugliResultGetDistance(expected.get(), 8.0),
+              JxlButteraugliResultGetDistance(result.get(), 8.0));
+    EXPECT_EQ(JxlButteraugliResultGetMaxDistance(expected.get()),
+              JxlButteraugliResultGetMaxDistance(result.get()));
+  }
+}
+
+TEST(ButteraugliTest, DiffmapInStrips) {
+  const size_t xsize = 91;
+  const size_t ysize = 701;
+  jxl::Image3F rgb0(xsize, ysize);
+  jxl::RandomFillImage(&rgb0, 0.0f, 1.0f, 123);
+  jxl::Image3F rgb1 = jxl::CopyImage(rgb0);
+  jxl::Image3F noise(xsize, ysize);
+  jxl::RandomFillImage(&noise, -0.05f, 0.05f, 456);
+  jxl::AddTo(noise, &rgb1);
+
+  jxl::ButteraugliParams params;
+  jxl::ImageF expected;
+  jxl::ButteraugliComparator comparator(rgb0, params);
+  comparator.Diffmap(rgb1, expected);
+
+  jxl::ThreadPoolInternal pool(4);
+  for (jxl::ThreadPool* p : {static_cast<jxl::ThreadPool*>(nullptr),
+                             static_cast<jxl::ThreadPool*>(&pool)}) {
+    jxl::ImageF diffmap;
+    jxl::ButteraugliDiffmapInStrips(rgb0, rgb1, params, p, diffmap);
+    ASSERT_TRUE(jxl::SameSize(expected, diffmap));
+    for (size_t y = 0; y < ysize; ++y) {
+      for (size_t x = 0; x < xsize; ++x) {
+        ASSERT_EQ(expected.ConstRow(y)[x], diffmap.ConstRow(y)[x]);
+      }
+    }
+  }
+}
+
+TEST(ButteraugliTest, IncrementalComparator) {
+  const size_t xsize = 600;
+  const size_t ysize = 500;
+  jxl::Image3F rgb0(xsize, ysize);
+  jxl::RandomFillImage(&rgb0, 0.0f, 1.0f, 123);
+  jxl::Image3F rgb1 = jxl::CopyImage(rgb0);
+  jxl::Image3F noise(xsize, ysize);
+  jxl::RandomFillImage(&noise, -0.05f, 0.05f, 456);
+  jxl::AddTo(noise, &rgb1);
+
+  jxl::ImageMetadata metadata;
+  jxl::ImageBundle ref(&metadata);
+  ref.SetFromImage(std::move(rgb0), jxl::ColorEncoding::LinearSRGB());
+  jxl::ButteraugliParams params;
+  jxl::JxlButteraugliComparator full(params, jxl::GetJxlCms());
+  ASSERT_TRUE(full.SetReferenceImage(ref));
+
+  jxl::ThreadPoolInternal pool(4);
+  for (jxl::ThreadPool* p : {static_cast<jxl::ThreadPool*>(nullptr),
+                             static_cast<jxl::ThreadPool*>(&pool)}) {
+    jxl::IncrementalButteraugliComparator incremental(params, jxl::GetJxlCms(),
+                                                      p);
+    ASSERT_TRUE(incremental.SetReferenceImage(ref));
+    jxl::Image3F distorted = jxl::CopyImage(rgb1);
+    // The first image is compared as a whole, the change in the corner only
+    // in the first 256x256 tile, the unchanged image in no tile, and the
+    // change in the middle in the whole image again, since it touches four of
+    // the six tiles.
+    const jxl::Rect changes[] = {jxl::Rect(0, 0, 0, 0), jxl::Rect(8, 8, 16, 16),
+                                 jxl::Rect(0, 0, 0, 0),
+                                 jxl::Rect(240, 240, 32, 32)};
+    for (const jxl::Rect& change : changes) {
+      for (size_t c = 0; c < 3; ++c) {
+        for (size_t y = 0; y < change.ysize(); ++y) {
+          float* row = change.PlaneRow(&distorted, c, y);
+          for (size_t x = 0; x < change.xsize(); ++x) {
+            row[x] += 0.1f;
+          }
+        }
+      }
+      jxl::ImageBundle actual(&metadata);
+      actual.SetFromImage(jxl::CopyImage(distorted),
+                          jxl::ColorEncoding::LinearSRGB());
+      jxl::ImageF expected;
+      float expected_score;
+      ASSERT_TRUE(full.CompareWith(actual, &expected, &expected_score));
+      jxl::ImageF diffmap;
+      float score;
+      ASSERT_TRUE(incremental.CompareWith(actual, &diffmap, &score));
+      EXPECT_EQ(expected_score, score);
+      ASSERT_TRUE(jxl::SameSize(expected, diffmap));
+      for (size_t y = 0; y < ysize; ++y) {
+        for (size_t x = 0; x < xsize; ++x) {
+          ASSERT_EQ(expected.ConstRow(y)[x], diffmap.ConstRow(y)[x]);
+        }
+      }
+    }
+  }
+}
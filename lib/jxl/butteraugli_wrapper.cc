@@ -22,38 +22,6 @@
 #include "lib/jxl/image_bundle.h"
 #include "lib/jxl/memory_manager_internal.h"
 
-namespace {
-
-void SetMetadataFromPixelFormat(const JxlPixelFormat* pixel_format,
-                                jxl::ImageMetadata* metadata) {
-  uint32_t potential_alpha_bits = 0;
-  switch (pixel_format->data_type) {
-    case JXL_TYPE_FLOAT:
-      metadata->SetFloat32Samples();
-      potential_alpha_bits = 16;
-      break;
-    case JXL_TYPE_FLOAT16:
-      metadata->SetFloat16Samples();
-      potential_alpha_bits = 16;
-      break;
-    case JXL_TYPE_UINT16:
-      metadata->SetUintSamples(16);
-      potential_alpha_bits = 16;
-      break;
-    case JXL_TYPE_UINT8:
-      metadata->SetUintSamples(8);
-      potential_alpha_bits = 8;
-      break;
-    default:
-      JXL_ABORT("Unhandled JxlDataType");
-  }
-  if (pixel_format->num_channels == 2 || pixel_format->num_channels == 4) {
-    metadata->SetAlphaBits(potential_alpha_bits);
-  }
-}
-
-}  // namespace
-
 struct JxlButteraugliResultStruct {
   JxlMemoryManager memory_manager;
 
@@ -123,33 +91,20 @@ JxlButteraugliResult* JxlButteraugliCompute(
     size_t size_orig, const JxlPixelFormat* pixel_format_dist,
     const void* buffer_dist, size_t size_dist) {
   jxl::ImageMetadata orig_metadata;
-  SetMetadataFromPixelFormat(pixel_format_orig, &orig_metadata);
   jxl::ImageBundle orig_ib(&orig_metadata);
-  jxl::ColorEncoding c_current;
-  if (pixel_format_orig->data_type == JXL_TYPE_FLOAT) {
-    c_current =
-        jxl::ColorEncoding::LinearSRGB(pixel_format_orig->num_channels < 3);
-  } else {
-    c_current = jxl::ColorEncoding::SRGB(pixel_format_orig->num_channels < 3);
-  }
-  if (!jxl::BufferToImageBundle(*pixel_format_orig, xsize, ysize, buffer_orig,
-                                size_orig, api->thread_pool.get(), c_current,
-                                &orig_ib)) {
+  if (!jxl::BufferToSRGBImageBundle(*pixel_format_orig, xsize, ysize,
+                                    buffer_orig, size_orig,
+                                    api->thread_pool.get(), &orig_metadata,
+                                    &orig_ib)) {
     return nullptr;
   }
 
   jxl::ImageMetadata dist_metadata;
-  SetMetadataFromPixelFormat(pixel_format_dist, &dist_metadata);
   jxl::ImageBundle dist_ib(&dist_metadata);
-  if (pixel_format_dist->data_type == JXL_TYPE_FLOAT) {
-    c_current =
-        jxl::ColorEncoding::LinearSRGB(pixel_format_dist->num_channels < 3);
-  } else {
-    c_current = jxl::ColorEncoding::SRGB(pixel_format_dist->num_channels < 3);
-  }
-  if (!jxl::BufferToImageBundle(*pixel_format_dist, xsize, ysize, buffer_dist,
-                                size_dist, api->thread_pool.get(), c_current,
-                                &dist_ib)) {
+  if (!jxl::BufferToSRGBImageBundle(*pixel_format_dist, xsize, ysize,
+                                    buffer_dist, size_dist,
+                                    api->thread_pool.get(), &dist_metadata,
+                                    &dist_ib)) {
     return nullptr;
   }
 
@@ -168,6 +123,93 @@ JxlButteraugliResult* JxlButteraugliCompute(
   return result;
 }
 
+struct JxlButteraugliReferenceStruct {
+  JxlButteraugliReferenceStruct(const jxl::ButteraugliParams& params,
+                                const JxlCmsInterface& cms)
+      : params(params),
+        comparator_black(params, cms),
+        comparator_white(params, cms),
+        comparison(&comparator_black, &comparator_white, cms) {}
+
+  JxlMemoryManager memory_manager;
+  uint32_t xsize;
+  uint32_t ysize;
+
+  jxl::ButteraugliParams params;
+  jxl::JxlButteraugliComparator comparator_black;
+  jxl::JxlButteraugliComparator comparator_white;
+  jxl::ReferenceComparison comparison;
+};
+
+JxlButteraugliReference* JxlButteraugliReferenceCreate(
+    const JxlButteraugliApi* api, uint32_t xsize, uint32_t ysize,
+    const JxlPixelFormat* pixel_format, const void* buffer, size_t size) {
+  jxl::ImageMetadata metadata;
+  jxl::ImageBundle ib(&metadata);
+  if (!jxl::BufferToSRGBImageBundle(*pixel_format, xsize, ysize, buffer, size,
+                                    api->thread_pool.get(), &metadata, &ib)) {
+    return nullptr;
+  }
+
+  jxl::ButteraugliParams params;
+  params.hf_asymmetry = api->hf_asymmetry;
+  params.xmul = api->xmul;
+  params.intensity_target = api->intensity_target;
+
+  void* alloc = jxl::MemoryManagerAlloc(&api->memory_manager,
+                                        sizeof(JxlButteraugliReference));
+  if (!alloc) return nullptr;
+  // Placement new constructor on allocated memory
+  JxlButteraugliReference* reference =
+      new (alloc) JxlButteraugliReference(params, api->cms);
+  reference->memory_manager = api->memory_manager;
+  reference->xsize = xsize;
+  reference->ysize = ysize;
+  if (!reference->comparison.SetReferenceImage(ib, api->thread_pool.get())) {
+    JxlButteraugliReferenceDestroy(reference);
+    return nullptr;
+  }
+  return reference;
+}
+
+JxlButteraugliResult* JxlButteraugliCompareWithReference(
+    const JxlButteraugliApi* api, JxlButteraugliReference* reference,
+    const JxlPixelFormat* pixel_format_dist, const void* buffer_dist,
+    size_t size_dist) {
+  jxl::ImageMetadata dist_metadata;
+  jxl::ImageBundle dist_ib(&dist_metadata);
+  if (!jxl::BufferToSRGBImageBundle(*pixel_format_dist, reference->xsize,
+                                    reference->ysize, buffer_dist, size_dist,
+                                    api->thread_pool.get(), &dist_metadata,
+                                    &dist_ib)) {
+    return nullptr;
+  }
+
+  void* alloc = jxl::MemoryManagerAlloc(&api->memory_manager,
+                                        sizeof(JxlButteraugliResult));
+  if (!alloc) return nullptr;
+  // Placement new constructor on allocated memory
+  JxlButteraugliResult* result = new (alloc) JxlButteraugliResult();
+  result->memory_manager = api->memory_manager;
+  result->params = reference->params;
+  if (!reference->comparison.CompareWith(dist_ib, &result->distmap,
+                                         /*score=*/nullptr,
+                                         api->thread_pool.get())) {
+    JxlButteraugliResultDestroy(result);
+    return nullptr;
+  }
+  return result;
+}
+
+void JxlButteraugliReferenceDestroy(JxlButteraugliReference* reference) {
+  if (reference) {
+    JxlMemoryManager local_memory_manager = reference->memory_manager;
+    // Call destructor directly since custom free function is used.
+    reference->~JxlButteraugliReference();
+    jxl::MemoryManagerFree(&local_memory_manager, reference);
+  }
+}
+
 float JxlButteraugliResultGetDistance(const JxlButteraugliResult* result,
                                       float pnorm) {
   return static_cast<float>(
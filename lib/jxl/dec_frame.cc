@@ -345,6 +345,20 @@ Status FrameDecoder::AllocateOutput() {
   return true;
 }
 
+size_t FrameDecoder::NumCompleteBlockRows() const {
+  const size_t num_passes = frame_header_.passes.num_passes;
+  size_t gy = 0;
+  for (; gy < frame_dim_.ysize_groups; ++gy) {
+    for (size_t gx = 0; gx < frame_dim_.xsize_groups; ++gx) {
+      size_t g = gy * frame_dim_.xsize_groups + gx;
+      if (decoded_passes_per_ac_group_[g] < num_passes) {
+        return gy * kGroupDimInBlocks;
+      }
+    }
+  }
+  return frame_dim_.ysize_blocks;
+}
+
 Status FrameDecoder::ProcessACGlobal(BitReader* br) {
   JXL_CHECK(finalized_dc_);
 
@@ -120,6 +120,10 @@ class FrameDecoder {
                              decoded_passes_per_ac_group_.end());
   }
 
+  // Returns the number of rows of blocks, counted from the top of the frame,
+  // for which all passes of all AC groups are decoded.
+  size_t NumCompleteBlockRows() const;
+
   // If enabled, ProcessSections will stop and return true when the DC
   // sections have been processed, instead of starting the AC sections. This
   // will only occur if supported (that is, flushing will produce a valid
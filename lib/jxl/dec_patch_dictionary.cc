@@ -10,6 +10,7 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <limits>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -182,6 +183,13 @@ struct PatchInterval {
   size_t idx;
   size_t y0, y1;
 };
+
+// Minimum number of entries the per-row patch index is always allowed to
+// have, regardless of the number of patches.
+constexpr size_t kMinRowIndexEntries = 1 << 20;
+// Maximum average number of per-row index entries per patch; this keeps the
+// index within the memory budget of patches (about 64 bytes per patch).
+constexpr size_t kMaxRowIndexEntriesPerPatch = 16;
 }  // namespace
 
 void PatchDictionary::ComputePatchTree() {
@@ -189,6 +197,8 @@ void PatchDictionary::ComputePatchTree() {
   num_patches_.clear();
   sorted_patches_y0_.clear();
   sorted_patches_y1_.clear();
+  row_patches_.clear();
+  row_patches_start_.clear();
   if (positions_.empty()) {
     return;
   }
@@ -215,8 +225,34 @@ void PatchDictionary::ComputePatchTree() {
   // Count the number of patches for each row.
   sort_by_y1(0, intervals.size());
   num_patches_.resize(intervals.back().y1);
+  size_t num_row_entries = 0;
   for (auto iv : intervals) {
     for (size_t y = iv.y0; y < iv.y1; ++y) num_patches_[y]++;
+    num_row_entries += iv.y1 - iv.y0;
+  }
+  // If it fits in the memory budget, build a per-row index of the patches,
+  // which makes looking up the patches of a row a simple array access. This
+  // is the common case for text-like content with many small patches.
+  if (positions_.size() <= std::numeric_limits<uint32_t>::max() &&
+      num_row_entries <=
+          std::max(kMinRowIndexEntries,
+                   kMaxRowIndexEntriesPerPatch * positions_.size())) {
+    row_patches_start_.resize(num_patches_.size() + 1);
+    for (size_t y = 0; y < num_patches_.size(); ++y) {
+      row_patches_start_[y + 1] = row_patches_start_[y] + num_patches_[y];
+    }
+    row_patches_.resize(num_row_entries);
+    std::vector<size_t> row_pos(row_patches_start_.begin(),
+                                row_patches_start_.end() - 1);
+    // Visiting the patches in order keeps each row sorted by patch index.
+    for (size_t i = 0; i < positions_.size(); ++i) {
+      const auto& pos = positions_[i];
+      const size_t y1 = pos.y + ref_positions_[pos.ref_pos_idx].ysize;
+      for (size_t y = pos.y; y < y1; ++y) {
+        row_patches_[row_pos[y]++] = static_cast<uint32_t>(i);
+      }
+    }
+    return;
   }
   PatchTreeNode root;
   root.start = 0;
@@ -279,6 +315,11 @@ std::vector<size_t> PatchDictionary::GetPatchesForRow(size_t y) const {
   std::vector<size_t> result;
   if (y < num_patches_.size() && num_patches_[y] > 0) {
     result.reserve(num_patches_[y]);
+    if (!row_patches_start_.empty()) {
+      result.assign(row_patches_.begin() + row_patches_start_[y],
+                    row_patches_.begin() + row_patches_start_[y + 1]);
+      return result;
+    }
     for (ssize_t tree_idx = 0; tree_idx != -1;) {
       JXL_DASSERT(tree_idx < (ssize_t)patch_tree_.size());
       const auto& node = patch_tree_[tree_idx];
@@ -310,9 +351,10 @@ std::vector<size_t> PatchDictionary::GetPatchesForRow(size_t y) const {
 // to be located at position (x0, y) in the frame.
 void PatchDictionary::AddOneRow(float* const* inout, size_t y, size_t x0,
                                 size_t xsize) const {
+  if (y >= num_patches_.size() || num_patches_[y] == 0) return;
   size_t num_ec = shared_->metadata->m.num_extra_channels;
   std::vector<const float*> fg_ptrs(3 + num_ec);
-  for (size_t pos_idx : GetPatchesForRow(y)) {
+  const auto add_patch = [&](size_t pos_idx) {
     const size_t blending_idx = pos_idx * (num_ec + 1);
     const PatchPosition& pos = positions_[pos_idx];
     const PatchReferencePosition& ref_pos = ref_positions_[pos.ref_pos_idx];
@@ -323,8 +365,8 @@ void PatchDictionary::AddOneRow(float* const* inout, size_t y, size_t x0,
     JXL_DASSERT(y < by + ref_pos.ysize);
     size_t iy = y - by;
     size_t ref = ref_pos.ref;
-    if (bx >= x0 + xsize) continue;
-    if (bx + patch_xsize < x0) continue;
+    if (bx >= x0 + xsize) return;
+    if (bx + patch_xsize < x0) return;
     size_t patch_x0 = std::max(bx, x0);
     size_t patch_x1 = std::min(bx + patch_xsize, x0 + xsize);
     for (size_t c = 0; c < 3; c++) {
@@ -342,6 +384,16 @@ void PatchDictionary::AddOneRow(float* const* inout, size_t y, size_t x0,
                     patch_x1 - patch_x0, blendings_[blending_idx],
                     blendings_.data() + blending_idx + 1,
                     shared_->metadata->m.extra_channel_info);
+  };
+  if (!row_patches_start_.empty()) {
+    for (size_t i = row_patches_start_[y]; i < row_patches_start_[y + 1];
+         i++) {
+      add_patch(row_patches_[i]);
+    }
+  } else {
+    for (size_t pos_idx : GetPatchesForRow(y)) {
+      add_patch(pos_idx);
+    }
   }
 }
 }  // namespace jxl
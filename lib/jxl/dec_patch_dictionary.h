@@ -9,6 +9,7 @@
 // Chooses reference patches, and avoids encoding them once per occurrence.
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/types.h>
 
@@ -142,6 +143,11 @@ class PatchDictionary {
   std::vector<size_t> num_patches_;
   std::vector<std::pair<size_t, size_t>> sorted_patches_y0_;
   std::vector<std::pair<size_t, size_t>> sorted_patches_y1_;
+  // Per-row index of the patches, sorted by patch index: the patches of row y
+  // are row_patches_[row_patches_start_[y], row_patches_start_[y + 1]). Only
+  // built when its size is bounded; otherwise the interval tree is used.
+  std::vector<uint32_t> row_patches_;
+  std::vector<size_t> row_patches_start_;
 
   void ComputePatchTree();
 };
@@ -31,6 +31,7 @@
 #include "lib/jxl/headers.h"
 #include "lib/jxl/icc_codec.h"
 #include "lib/jxl/image_bundle.h"
+#include "lib/jxl/image_ops.h"
 #include "lib/jxl/loop_filter.h"
 #include "lib/jxl/memory_manager_internal.h"
 #include "lib/jxl/sanitizers.h"
@@ -289,6 +290,22 @@ struct ExtraChannelOutput {
   size_t buffer_size;
 };
 
+// Reference frame storage at a frame boundary, kept across a rewind.
+struct ReferenceSnapshot {
+  // Number of internal and external frames decoded before the snapshot.
+  size_t internal_frames;
+  size_t external_frames;
+  // Frame counting depends on coalescing.
+  bool coalescing;
+  // Reference frames are stored in the output color encoding.
+  bool color_encoding_is_original;
+  jxl::ColorEncoding color_encoding;
+  float desired_intensity_target;
+  jxl::Image3F dc_frames[4];
+  jxl::ImageBundle reference_frames[4];
+  bool ib_is_in_xyb[4];
+};
+
 }  // namespace
 
 namespace jxl {
@@ -501,6 +518,19 @@ struct JxlDecoderStruct {
   // vector, it must be treated as a required frame.
   std::vector<char> frame_required;
 
+  // The reference frames and DC frames as they were when JxlDecoderRewind was
+  // last called at a frame boundary. After the rewind, if all frames up to that
+  // point are skipped, they do not need to be decoded again: the storage is
+  // restored from the snapshot instead. This keeps a second copy of the
+  // reference frame storage until JxlDecoderReset or JxlDecoderDestroy.
+  std::unique_ptr<ReferenceSnapshot> reference_snapshot;
+  // Whether the frames covered by reference_snapshot are skipped since the last
+  // rewind, and the snapshot must be restored after them.
+  bool use_reference_snapshot;
+  // Whether the reference frame storage reflects all the frames since the last
+  // rewind, i.e. no frame that can be referenced was skipped without decoding.
+  bool reference_storage_complete;
+
   // Codestream input data is copied here temporarily when the decoder needs
   // more input bytes to process the next part of the stream. We copy the input
   // data in order to be able to release it all through the API it when
@@ -761,6 +791,8 @@ void JxlDecoderRewindDecodingState(JxlDecoder* dec) {
   dec->skipping_frame = false;
   dec->internal_frames = 0;
   dec->external_frames = 0;
+  dec->use_reference_snapshot = false;
+  dec->reference_storage_complete = true;
 }
 
 void JxlDecoderReset(JxlDecoder* dec) {
@@ -777,6 +809,7 @@ void JxlDecoderReset(JxlDecoder* dec) {
   dec->frame_saved_as.clear();
   dec->frame_external_to_internal.clear();
   dec->frame_required.clear();
+  dec->reference_snapshot.reset();
   dec->decompress_boxes = false;
 }
 
@@ -816,7 +849,82 @@ void JxlDecoderDestroy(JxlDecoder* dec) {
   }
 }
 
-void JxlDecoderRewind(JxlDecoder* dec) { JxlDecoderRewindDecodingState(dec); }
+namespace {
+
+// Moves the reference frame storage into dec->reference_snapshot if the
+// decoder is at a frame boundary and the storage reflects all frames so far.
+// Otherwise, the previous snapshot is kept. In particular, it is kept while it
+// is still to be restored, since the storage then lacks the skipped frames.
+void SaveReferenceSnapshot(JxlDecoder* dec) {
+  if (!dec->passes_state || dec->frame_stage != FrameStage::kHeader ||
+      !dec->is_last_of_still || !dec->reference_storage_complete ||
+      dec->use_reference_snapshot || dec->internal_frames == 0) {
+    return;
+  }
+  const jxl::OutputEncodingInfo& output_encoding =
+      dec->passes_state->output_encoding_info;
+  auto snapshot = jxl::make_unique<ReferenceSnapshot>();
+  snapshot->internal_frames = dec->internal_frames;
+  snapshot->external_frames = dec->external_frames;
+  snapshot->coalescing = dec->coalescing;
+  snapshot->color_encoding_is_original =
+      output_encoding.color_encoding_is_original;
+  snapshot->color_encoding = output_encoding.color_encoding;
+  snapshot->desired_intensity_target =
+      output_encoding.desired_intensity_target;
+  auto& shared = dec->passes_state->shared_storage;
+  for (size_t i = 0; i < 4; ++i) {
+    snapshot->dc_frames[i] = std::move(shared.dc_frames[i]);
+    snapshot->reference_frames[i] = std::move(shared.reference_frames[i].frame);
+    snapshot->ib_is_in_xyb[i] = shared.reference_frames[i].ib_is_in_xyb;
+  }
+  dec->reference_snapshot = std::move(snapshot);
+}
+
+// Whether the snapshot was taken with the same frame counting and output
+// encoding as the current decoding.
+bool ReferenceSnapshotMatches(const JxlDecoder* dec) {
+  const ReferenceSnapshot& snapshot = *dec->reference_snapshot;
+  const jxl::OutputEncodingInfo& output_encoding =
+      dec->passes_state->output_encoding_info;
+  if (snapshot.coalescing != dec->coalescing ||
+      snapshot.desired_intensity_target !=
+          output_encoding.desired_intensity_target ||
+      snapshot.color_encoding_is_original !=
+          output_encoding.color_encoding_is_original) {
+    return false;
+  }
+  // The original encoding is that of the image, which may only be given as an
+  // ICC profile. Other output encodings are given by fields.
+  return snapshot.color_encoding_is_original ||
+         snapshot.color_encoding.SameColorEncoding(
+             output_encoding.color_encoding);
+}
+
+void RestoreReferenceSnapshot(JxlDecoder* dec) {
+  const ReferenceSnapshot& snapshot = *dec->reference_snapshot;
+  auto& shared = dec->passes_state->shared_storage;
+  for (size_t i = 0; i < 4; ++i) {
+    shared.dc_frames[i] = jxl::CopyImage(snapshot.dc_frames[i]);
+    shared.reference_frames[i].frame = snapshot.reference_frames[i].Copy();
+    shared.reference_frames[i].ib_is_in_xyb = snapshot.ib_is_in_xyb[i];
+  }
+}
+
+// Whether the current frame could be referenced by any future frame: either
+// because it's a frame saved for blending or patches, or because it's a DC
+// frame.
+bool IsReferenceable(const JxlDecoder* dec) {
+  return dec->frame_header->CanBeReferenced() ||
+         dec->frame_header->frame_type == jxl::FrameType::kDCFrame;
+}
+
+}  // namespace
+
+void JxlDecoderRewind(JxlDecoder* dec) {
+  SaveReferenceSnapshot(dec);
+  JxlDecoderRewindDecodingState(dec);
+}
 
 void JxlDecoderSkipFrames(JxlDecoder* dec, size_t amount) {
   // Increment amount, rather than set it: making the amount smaller is
@@ -852,6 +960,7 @@ JxlDecoderStatus JxlDecoderSkipCurrentFrame(JxlDecoder* dec) {
     return JXL_DEC_ERROR;
   }
   JXL_DASSERT(dec->frame_dec);
+  if (IsReferenceable(dec)) dec->reference_storage_complete = false;
   dec->frame_stage = FrameStage::kHeader;
   dec->AdvanceCodestream(dec->remaining_frame_size);
   if (dec->is_last_of_still) {
@@ -1103,6 +1212,25 @@ JxlDecoderStatus JxlDecoderReadAllHeaders(JxlDecoder* dec) {
   return JXL_DEC_SUCCESS;
 }
 
+#if JPEGXL_ENABLE_TRANSCODE_JPEG
+// Copies the EXIF and XMP box contents to the JPEG reconstruction data. Must
+// only be called when !dec->JbrdNeedMoreBoxes().
+JxlDecoderStatus SetJPEGMetadata(JxlDecoder* dec) {
+  jxl::jpeg::JPEGData* jpeg_data = dec->ib->jpeg_data.get();
+  if (dec->recon_exif_size) {
+    JxlDecoderStatus status = jxl::JxlToJpegDecoder::SetExif(
+        dec->exif_metadata.data(), dec->exif_metadata.size(), jpeg_data);
+    if (status != JXL_DEC_SUCCESS) return status;
+  }
+  if (dec->recon_xmp_size) {
+    JxlDecoderStatus status = jxl::JxlToJpegDecoder::SetXmp(
+        dec->xmp_metadata.data(), dec->xmp_metadata.size(), jpeg_data);
+    if (status != JXL_DEC_SUCCESS) return status;
+  }
+  return JXL_DEC_SUCCESS;
+}
+#endif
+
 JxlDecoderStatus JxlDecoderProcessSections(JxlDecoder* dec) {
   Span<const uint8_t> span;
   JXL_API_RETURN_IF_ERROR(dec->GetCodestreamInput(&span));
@@ -1239,6 +1367,12 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
       if (!dec->ib) {
         dec->ib.reset(new jxl::ImageBundle(&dec->image_metadata));
       }
+      if (dec->use_reference_snapshot &&
+          dec->internal_frames == dec->reference_snapshot->internal_frames) {
+        // All frames before this one were skipped without decoding.
+        RestoreReferenceSnapshot(dec);
+        dec->use_reference_snapshot = false;
+      }
 #if JPEGXL_ENABLE_TRANSCODE_JPEG
       // If JPEG reconstruction is wanted and possible, set the jpeg_data of
       // the ImageBundle.
@@ -1309,6 +1443,18 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
       if (dec->is_last_of_still) dec->external_frames++;
       dec->internal_frames++;
 
+      if (internal_frame_index == 0 && dec->reference_snapshot) {
+        // After a rewind, the frames covered by the reference snapshot need
+        // not be decoded if they are all skipped. A snapshot for other
+        // decoding settings is of no further use.
+        if (!ReferenceSnapshotMatches(dec)) {
+          dec->reference_snapshot.reset();
+        } else {
+          dec->use_reference_snapshot =
+              dec->skip_frames >= dec->reference_snapshot->external_frames;
+        }
+      }
+
       if (dec->skip_frames > 0) {
         dec->skipping_frame = true;
         if (dec->is_last_of_still) {
@@ -1337,15 +1483,16 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
       }
 
       if (dec->skipping_frame) {
-        // Whether this frame could be referenced by any future frame: either
-        // because it's a frame saved for blending or patches, or because it's
-        // a DC frame.
-        bool referenceable =
-            dec->frame_header->CanBeReferenced() ||
-            dec->frame_header->frame_type == FrameType::kDCFrame;
-        if (internal_frame_index < dec->frame_required.size() &&
-            !dec->frame_required[internal_frame_index]) {
+        bool referenceable = IsReferenceable(dec);
+        if (dec->use_reference_snapshot &&
+            internal_frame_index < dec->reference_snapshot->internal_frames) {
+          // The storage is restored from the snapshot after this frame.
+          referenceable = false;
+        } else if (referenceable &&
+                   internal_frame_index < dec->frame_required.size() &&
+                   !dec->frame_required[internal_frame_index]) {
           referenceable = false;
+          dec->reference_storage_complete = false;
         }
         if (!referenceable) {
           // Skip all decoding for this frame, since the user is skipping this
@@ -1387,6 +1534,7 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
       if (dec->preview_frame || (dec->events_wanted & JXL_DEC_FULL_IMAGE)) {
         dec->frame_stage = FrameStage::kFull;
       } else if (!dec->is_last_total) {
+        if (IsReferenceable(dec)) dec->reference_storage_complete = false;
         dec->frame_stage = FrameStage::kHeader;
         dec->AdvanceCodestream(dec->remaining_frame_size);
         continue;
@@ -1462,6 +1610,25 @@ JxlDecoderStatus JxlDecoderProcessCodestream(JxlDecoder* dec) {
         return JXL_DEC_FRAME_PROGRESSION;
       }
 
+#if JPEGXL_ENABLE_TRANSCODE_JPEG
+      // Write the beginning of the reconstructed JPEG as soon as the top rows
+      // of the coefficients are decoded. This is only possible if the EXIF and
+      // XMP boxes needed by the JPEG reconstruction were already decoded.
+      if (!all_sections_done && dec->jpeg_decoder.IsOutputSet() &&
+          dec->ib->jpeg_data != nullptr && !dec->JbrdNeedMoreBoxes()) {
+        size_t num_block_rows = dec->frame_dec->NumCompleteBlockRows();
+        if (num_block_rows > 0) {
+          JxlDecoderStatus status = SetJPEGMetadata(dec);
+          if (status != JXL_DEC_SUCCESS) return status;
+          status = dec->jpeg_decoder.WriteOutput(
+              *dec->ib->jpeg_data, dec->thread_pool.get(), num_block_rows);
+          if (status != JXL_DEC_SUCCESS && status != JXL_DEC_NEED_MORE_INPUT) {
+            return status;
+          }
+        }
+      }
+#endif
+
       if (!all_sections_done) {
         // Not all sections have been processed yet
         return dec->RequestMoreInput();
@@ -1686,24 +1853,15 @@ static JxlDecoderStatus HandleBoxes(JxlDecoder* dec) {
 #if JPEGXL_ENABLE_TRANSCODE_JPEG
     if (dec->recon_output_jpeg == JpegReconStage::kSettingMetadata &&
         !dec->JbrdNeedMoreBoxes()) {
-      jxl::jpeg::JPEGData* jpeg_data = dec->ib->jpeg_data.get();
-      if (dec->recon_exif_size) {
-        JxlDecoderStatus status = jxl::JxlToJpegDecoder::SetExif(
-            dec->exif_metadata.data(), dec->exif_metadata.size(), jpeg_data);
-        if (status != JXL_DEC_SUCCESS) return status;
-      }
-      if (dec->recon_xmp_size) {
-        JxlDecoderStatus status = jxl::JxlToJpegDecoder::SetXmp(
-            dec->xmp_metadata.data(), dec->xmp_metadata.size(), jpeg_data);
-        if (status != JXL_DEC_SUCCESS) return status;
-      }
+      JxlDecoderStatus status = jxl::SetJPEGMetadata(dec);
+      if (status != JXL_DEC_SUCCESS) return status;
       dec->recon_output_jpeg = JpegReconStage::kOutputting;
     }
 
     if (dec->recon_output_jpeg == JpegReconStage::kOutputting &&
         !dec->JbrdNeedMoreBoxes()) {
-      JxlDecoderStatus status =
-          dec->jpeg_decoder.WriteOutput(*dec->ib->jpeg_data);
+      JxlDecoderStatus status = dec->jpeg_decoder.WriteOutput(
+          *dec->ib->jpeg_data, dec->thread_pool.get());
       if (status != JXL_DEC_SUCCESS) return status;
       dec->recon_output_jpeg = JpegReconStage::kFinished;
       dec->ib.reset();
@@ -3232,6 +3232,34 @@ TEST(DecodeTest, SkipFrameWithBlendingTest) {
     if (test_skipping) i += test_skipping;
   }
 
+  // The first rewind above happened at a frame boundary, so the decoder kept
+  // the reference frames at that point and skipping past it does not need to
+  // decode the earlier frames again. The output must be the same.
+  JxlDecoderRewind(dec);
+  EXPECT_EQ(JXL_DEC_SUCCESS,
+            JxlDecoderSubscribeEvents(dec, JXL_DEC_FRAME | JXL_DEC_FULL_IMAGE));
+  EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderSetInput(dec, next_in, avail_in));
+  JxlDecoderSkipFrames(dec, 11);
+
+  for (size_t i = 11; i < num_frames; ++i) {
+    std::vector<uint8_t> pixels(buffer_size);
+
+    EXPECT_EQ(JXL_DEC_FRAME, JxlDecoderProcessInput(dec));
+
+    JxlFrameHeader frame_header;
+    EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderGetFrameHeader(dec, &frame_header));
+    EXPECT_EQ(frame_durations[i], frame_header.duration);
+
+    EXPECT_EQ(JXL_DEC_NEED_IMAGE_OUT_BUFFER, JxlDecoderProcessInput(dec));
+
+    EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderSetImageOutBuffer(
+                                   dec, &format, pixels.data(), pixels.size()));
+
+    EXPECT_EQ(JXL_DEC_FULL_IMAGE, JxlDecoderProcessInput(dec));
+    EXPECT_EQ(0u, jxl::test::ComparePixels(frames[i].data(), pixels.data(),
+                                           xsize, ysize, format, format));
+  }
+
   JxlThreadParallelRunnerDestroy(runner);
   JxlDecoderDestroy(dec);
 }
@@ -4825,26 +4853,27 @@ TEST(DecodeTest, JXL_TRANSCODE_JPEG_TEST(JPEGReconstructTestCodestream)) {
 }
 #endif  // JPEGXL_ENABLE_JPEG
 
-TEST(DecodeTest, JXL_TRANSCODE_JPEG_TEST(JPEGReconstructionTest)) {
-  const std::string jpeg_path = "jxl/flower/flower.png.im_q85_420.jpg";
-  const jxl::PaddedBytes orig = jxl::ReadTestData(jpeg_path);
+// Returns a container with the jbrd box and the codestream of a lossless JPEG
+// recompression of `orig`.
+jxl::PaddedBytes CreateJPEGReconstructionContainer(
+    const jxl::PaddedBytes& orig) {
   jxl::CodecInOut orig_io;
-  ASSERT_TRUE(
+  EXPECT_TRUE(
       jxl::jpeg::DecodeImageJPG(jxl::Span<const uint8_t>(orig), &orig_io));
   orig_io.metadata.m.xyb_encoded = false;
   jxl::BitWriter writer;
-  ASSERT_TRUE(WriteCodestreamHeaders(&orig_io.metadata, &writer, nullptr));
+  EXPECT_TRUE(WriteCodestreamHeaders(&orig_io.metadata, &writer, nullptr));
   writer.ZeroPadToByte();
   jxl::PassesEncoderState enc_state;
   jxl::CompressParams cparams;
   cparams.color_transform = jxl::ColorTransform::kNone;
-  ASSERT_TRUE(jxl::EncodeFrame(cparams, jxl::FrameInfo{}, &orig_io.metadata,
+  EXPECT_TRUE(jxl::EncodeFrame(cparams, jxl::FrameInfo{}, &orig_io.metadata,
                                orig_io.Main(), &enc_state, jxl::GetJxlCms(),
                                /*pool=*/nullptr, &writer,
                                /*aux_out=*/nullptr));
 
   jxl::PaddedBytes jpeg_data;
-  ASSERT_TRUE(
+  EXPECT_TRUE(
       EncodeJPEGData(*orig_io.Main().jpeg_data.get(), &jpeg_data, cparams));
   jxl::PaddedBytes container;
   container.append(jxl::kContainerHeader,
@@ -4855,9 +4884,73 @@ TEST(DecodeTest, JXL_TRANSCODE_JPEG_TEST(JPEGReconstructionTest)) {
   jxl::AppendBoxHeader(jxl::MakeBoxType("jxlc"), 0, true, &container);
   jxl::PaddedBytes codestream = std::move(writer).TakeBytes();
   container.append(codestream.data(), codestream.data() + codestream.size());
+  return container;
+}
+
+TEST(DecodeTest, JXL_TRANSCODE_JPEG_TEST(JPEGReconstructionTest)) {
+  const std::string jpeg_path = "jxl/flower/flower.png.im_q85_420.jpg";
+  const jxl::PaddedBytes orig = jxl::ReadTestData(jpeg_path);
+  jxl::PaddedBytes container = CreateJPEGReconstructionContainer(orig);
   VerifyJPEGReconstruction(container, orig);
 }
 
+TEST(DecodeTest, JXL_TRANSCODE_JPEG_TEST(JPEGReconstructionStreamingTest)) {
+  const std::string jpeg_path = "jxl/flower/flower.png.im_q85_420.jpg";
+  const jxl::PaddedBytes orig = jxl::ReadTestData(jpeg_path);
+  jxl::PaddedBytes container = CreateJPEGReconstructionContainer(orig);
+
+  JxlDecoderPtr dec = JxlDecoderMake(nullptr);
+  EXPECT_EQ(JXL_DEC_SUCCESS,
+            JxlDecoderSubscribeEvents(
+                dec.get(), JXL_DEC_JPEG_RECONSTRUCTION | JXL_DEC_FULL_IMAGE));
+  std::vector<uint8_t> reconstructed(orig.size());
+  const size_t kIncrement = 4096;
+  const uint8_t* next_in = container.data();
+  size_t avail_in = 0;
+  size_t total_in = 0;
+  size_t used = 0;
+  bool jpeg_buffer_set = false;
+  // Number of JPEG bytes written before the whole input was available.
+  size_t used_with_partial_input = 0;
+  for (;;) {
+    EXPECT_EQ(JXL_DEC_SUCCESS,
+              JxlDecoderSetInput(dec.get(), next_in, avail_in));
+    if (total_in == container.size()) JxlDecoderCloseInput(dec.get());
+    JxlDecoderStatus status = JxlDecoderProcessInput(dec.get());
+    size_t remaining = JxlDecoderReleaseInput(dec.get());
+    next_in += avail_in - remaining;
+    avail_in = remaining;
+    if (status == JXL_DEC_NEED_MORE_INPUT) {
+      ASSERT_LT(total_in, container.size());
+      if (jpeg_buffer_set) {
+        // Check how much of the JPEG bytestream is already written.
+        used = reconstructed.size() - JxlDecoderReleaseJPEGBuffer(dec.get());
+        used_with_partial_input = used;
+        EXPECT_EQ(JXL_DEC_SUCCESS, JxlDecoderSetJPEGBuffer(
+                                       dec.get(), reconstructed.data() + used,
+                                       reconstructed.size() - used));
+      }
+      size_t increment = std::min(kIncrement, container.size() - total_in);
+      total_in += increment;
+      avail_in += increment;
+    } else if (status == JXL_DEC_JPEG_RECONSTRUCTION) {
+      EXPECT_EQ(JXL_DEC_SUCCESS,
+                JxlDecoderSetJPEGBuffer(dec.get(), reconstructed.data(),
+                                        reconstructed.size()));
+      jpeg_buffer_set = true;
+    } else {
+      ASSERT_EQ(JXL_DEC_FULL_IMAGE, status);
+      break;
+    }
+  }
+  used = reconstructed.size() - JxlDecoderReleaseJPEGBuffer(dec.get());
+  ASSERT_EQ(used, orig.size());
+  EXPECT_EQ(0, memcmp(reconstructed.data(), orig.data(), used));
+  // Most of the JPEG bytestream can be written before the last group row of
+  // the image is decoded.
+  EXPECT_GT(used_with_partial_input, orig.size() / 2);
+}
+
 TEST(DecodeTest, JXL_TRANSCODE_JPEG_TEST(JPEGReconstructionMetadataTest)) {
   const std::string jpeg_path = "jxl/jpeg_reconstruction/1x1_exif_xmp.jpg";
   const std::string jxl_path = "jxl/jpeg_reconstruction/1x1_exif_xmp.jxl";
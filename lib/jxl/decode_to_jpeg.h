@@ -13,10 +13,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include <algorithm>
+#include <limits>
 #include <memory>
 #include <vector>
 
 #include "jxl/decode.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/common.h"  // JPEGXL_ENABLE_TRANSCODE_JPEG
 #include "lib/jxl/image_bundle.h"
@@ -105,6 +108,7 @@ class JxlToJpegDecoder {
   // Releases the JpegData from this decoder if set.
   Status SetImageBundleJpegData(ImageBundle* ib) {
     if (IsOutputSet() && jpeg_data_ != nullptr) {
+      serialization_state_.reset();
       if (!jpeg::SetJPEGDataFromICC(ib->metadata()->color_encoding.ICC(),
                                     jpeg_data_.get())) {
         return false;
@@ -114,7 +118,25 @@ class JxlToJpegDecoder {
     return true;
   }
 
-  JxlDecoderStatus WriteOutput(const jpeg::JPEGData& jpeg_data) {
+  // Writes the JPEG bytestream to the output buffer, using `pool` to encode the
+  // restart intervals of sequential scans in parallel. If only the first
+  // `num_available_block_rows` rows of blocks of the coefficients are decoded,
+  // writes the part of the bytestream that depends only on them and returns
+  // JXL_DEC_NEED_MORE_INPUT; the next call continues from there. Returns
+  // JXL_DEC_SUCCESS once the whole bytestream is written, and
+  // JXL_DEC_JPEG_NEED_MORE_OUTPUT if the output buffer is full, in which case
+  // the bytes written so far are kept and the next call, with a new output
+  // buffer, continues after them.
+  JxlDecoderStatus WriteOutput(
+      const jpeg::JPEGData& jpeg_data, ThreadPool* pool,
+      size_t num_available_block_rows = std::numeric_limits<size_t>::max()) {
+    if (serialization_state_ == nullptr) {
+      serialization_state_ = make_unique<jpeg::SerializationState>();
+    }
+    int max_v_samp_factor = 1;
+    for (const auto& c : jpeg_data.components) {
+      max_v_samp_factor = std::max(c.v_samp_factor, max_v_samp_factor);
+    }
     // Copy JPEG bytestream if desired.
     uint8_t* tmp_next_out = next_out_;
     size_t tmp_avail_size = avail_size_;
@@ -126,15 +148,21 @@ class JxlToJpegDecoder {
       tmp_avail_size -= to_write;
       return to_write;
     };
-    Status write_result = jpeg::WriteJpeg(jpeg_data, write);
+    Status write_result = jpeg::WriteJpegIncremental(
+        jpeg_data, num_available_block_rows / max_v_samp_factor, write, pool,
+        serialization_state_.get());
+    next_out_ = tmp_next_out;
+    avail_size_ = tmp_avail_size;
     if (!write_result) {
       if (tmp_avail_size == 0) {
         return JXL_DEC_JPEG_NEED_MORE_OUTPUT;
       }
       return JXL_DEC_ERROR;
     }
-    next_out_ = tmp_next_out;
-    avail_size_ = tmp_avail_size;
+    if (serialization_state_->stage != jpeg::SerializationState::STAGE_DONE) {
+      return JXL_DEC_NEED_MORE_INPUT;
+    }
+    serialization_state_.reset();
     return JXL_DEC_SUCCESS;
   }
 
@@ -146,6 +174,9 @@ class JxlToJpegDecoder {
   // stored here.
   std::unique_ptr<jpeg::JPEGData> jpeg_data_;
 
+  // Progress of the JPEG bytestream that is currently being written, if any.
+  std::unique_ptr<jpeg::SerializationState> serialization_state_;
+
   // True if the decoder is currently reading bytes inside a JPEG reconstruction
   // box.
   bool inside_box_ = false;
@@ -205,7 +236,10 @@ class JxlToJpegDecoder {
     return JXL_DEC_ERROR;
   }
 
-  JxlDecoderStatus WriteOutput(const jpeg::JPEGData& /* jpeg_data */) {
+  JxlDecoderStatus WriteOutput(
+      const jpeg::JPEGData& /* jpeg_data */, ThreadPool* /* pool */,
+      size_t /* num_available_block_rows */ =
+          std::numeric_limits<size_t>::max()) {
     return JXL_DEC_SUCCESS;
   }
 };
@@ -11,6 +11,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -38,6 +40,7 @@
 #include "lib/jxl/enc_group.h"
 #include "lib/jxl/enc_modular.h"
 #include "lib/jxl/enc_params.h"
+#include "lib/jxl/enc_ssimulacra2.h"
 #include "lib/jxl/enc_transforms-inl.h"
 #include "lib/jxl/epf.h"
 #include "lib/jxl/fast_math-inl.h"
@@ -765,10 +768,8 @@ void FindBestQuantization(const ImageBundle& linear, const Image3F& opsin,
   if (fabs(params.intensity_target - 255.0f) < 1e-3) {
     params.intensity_target = 80.0f;
   }
-  JxlButteraugliComparator comparator(params, cms);
+  IncrementalButteraugliComparator comparator(params, cms, pool);
   JXL_CHECK(comparator.SetReferenceImage(linear));
-  bool lower_is_better =
-      (comparator.GoodQualityScore() < comparator.BadQualityScore());
   const float initial_quant_dc = InitialQuantDC(butteraugli_target);
   AdjustQuantField(enc_state->shared.ac_strategy, Rect(quant_field),
                    &quant_field);
@@ -809,11 +810,9 @@ void FindBestQuantization(const ImageBundle& linear, const Image3F& opsin,
     PROFILER_ZONE("enc Butteraugli");
     float score;
     ImageF diffmap;
+    // Only the tiles near the blocks whose decoded pixels changed since the
+    // previous iteration are compared again.
     JXL_CHECK(comparator.CompareWith(dec_linear, &diffmap, &score));
-    if (!lower_is_better) {
-      score = -score;
-      diffmap = ScaleImage(-1.0f, diffmap);
-    }
     tile_distmap = TileDistMap(diffmap, 8 * cparams.resampling, 0,
                                enc_state->shared.ac_strategy);
     if (WantDebugOutput(aux_out)) {
@@ -987,6 +986,125 @@ void FindBestQuantizationMaxError(const Image3F& opsin,
   quantizer.SetQuantField(initial_quant_dc, quant_field, &raw_quant_field);
 }
 
+// Rough models of the butteraugli distance at which an image reaches a score,
+// only used to choose the distances tried by the target quality search.
+float DistanceFromSsimulacra2(float score) {
+  return std::pow(std::max(100.0f - score, 0.1f) / 12.0f, 1.0f / 0.7f);
+}
+
+float DistanceFromButteraugli(float score) { return score * (1.0f / 1.4f); }
+
+// Searches for the global scale of the quantization field, expressed as a
+// butteraugli distance, with the largest distance whose decoded image still
+// reaches the target quality. The color transform, AC strategy and CfL map of
+// the initial distance are kept, and the reference image is prepared only
+// once, so each step only costs a roundtrip and a comparison.
+void FindQuantizationForTargetQuality(const ImageBundle& linear,
+                                      const Image3F& opsin,
+                                      PassesEncoderState* enc_state,
+                                      const JxlCmsInterface& cms,
+                                      ThreadPool* pool, AuxOut* aux_out) {
+  const CompressParams& cparams = enc_state->cparams;
+  // SSIMULACRA 2 does not look at images smaller than 8x8, these keep the
+  // quantization of the initial distance.
+  if (linear.xsize() < 8 || linear.ysize() < 8) return;
+  Quantizer& quantizer = enc_state->shared.quantizer;
+  ImageI& raw_quant_field = enc_state->shared.raw_quant_field;
+  ImageF& quant_field = enc_state->initial_quant_field;
+  const ImageF initial_quant_field = CopyImage(quant_field);
+  const float initial_distance = cparams.butteraugli_distance;
+
+  // Alpha is not compared, as in the butteraugli loop.
+  ImageMetadata metadata = *linear.metadata();
+  metadata.num_extra_channels = 0;
+  metadata.extra_channel_info.clear();
+  ImageBundle reference(&metadata);
+  reference.SetFromImage(CopyImage(linear.color()), linear.c_current());
+
+  std::unique_ptr<Comparator> comparator;
+  float target;
+  float tolerance;
+  float (*distance_from_score)(float);
+  if (cparams.target_ssimulacra2 > 0.0f) {
+    comparator = jxl::make_unique<Ssimulacra2Comparator>(cms, pool);
+    target = cparams.target_ssimulacra2;
+    tolerance = 0.5f;
+    distance_from_score = DistanceFromSsimulacra2;
+  } else {
+    ButteraugliParams params = cparams.ba_params;
+    params.intensity_target = linear.metadata()->IntensityTarget();
+    // Same default intensity target as in FindBestQuantization.
+    if (fabs(params.intensity_target - 255.0f) < 1e-3) {
+      params.intensity_target = 80.0f;
+    }
+    comparator = jxl::make_unique<JxlButteraugliComparator>(params, cms);
+    target = cparams.target_butteraugli;
+    tolerance = 0.02f * target;
+    distance_from_score = DistanceFromButteraugli;
+  }
+  JXL_CHECK(comparator->SetReferenceImage(reference));
+  const bool higher_is_better =
+      comparator->GoodQualityScore() > comparator->BadQualityScore();
+
+  const auto set_quantization = [&](float distance) {
+    const float mul = initial_distance / distance;
+    for (size_t y = 0; y < quant_field.ysize(); ++y) {
+      const float* JXL_RESTRICT row_init = initial_quant_field.ConstRow(y);
+      float* JXL_RESTRICT row_q = quant_field.Row(y);
+      for (size_t x = 0; x < quant_field.xsize(); ++x) {
+        row_q[x] = row_init[x] * mul;
+      }
+    }
+    quantizer.SetQuantField(InitialQuantDC(distance), quant_field,
+                            &raw_quant_field);
+  };
+
+  // Largest distance that reached the target, and smallest one that did not.
+  float good_distance = 0.0f;
+  float bad_distance = std::numeric_limits<float>::max();
+  float distance = initial_distance;
+  for (int i = 0; i < cparams.max_target_quality_iters; ++i) {
+    set_quantization(distance);
+    ImageBundle decoded = RoundtripImage(opsin, enc_state, cms, pool);
+    Image3F decoded_color = std::move(*decoded.color());
+    decoded_color.ShrinkTo(reference.xsize(), reference.ysize());
+    ImageBundle actual(&metadata);
+    actual.SetFromImage(std::move(decoded_color), decoded.c_current());
+    if (WantDebugOutput(aux_out)) {
+      aux_out->DumpImage(("dec" + ToString(i)).c_str(), *actual.color());
+    }
+    float score;
+    JXL_CHECK(comparator->CompareWith(actual, nullptr, &score));
+    if (cparams.log_search_state) {
+      printf("\nTarget quality iter: %d/%d\n", i,
+             cparams.max_target_quality_iters);
+      printf("distance: %f  score: %f  (target = %f)\n", distance, score,
+             target);
+    }
+    const bool reached = higher_is_better ? score >= target : score <= target;
+    if (reached) {
+      good_distance = std::max(good_distance, distance);
+      if (std::abs(score - target) < tolerance) break;
+    } else {
+      bad_distance = std::min(bad_distance, distance);
+    }
+    if (bad_distance < 1.01f * good_distance) break;
+    // Correct the distance by the ratio of the modeled distances, at most by
+    // a factor of 4, and bisect if that leaves the known interval.
+    float next = distance * distance_from_score(target) /
+                 distance_from_score(score);
+    next = std::min(std::max(next, 0.25f * distance), 4.0f * distance);
+    if (next <= good_distance || next >= bad_distance) {
+      next = good_distance > 0.0f ? std::sqrt(good_distance * bad_distance)
+                                  : 0.5f * bad_distance;
+    }
+    distance = Clamp1(next, kMinButteraugliDistance, kMaxButteraugliDistance);
+    if (distance <= good_distance || distance >= bad_distance) break;
+  }
+  // If the target was never reached, the best quality that was tried is used.
+  set_quantization(good_distance > 0.0f ? good_distance : bad_distance);
+}
+
 }  // namespace
 
 void AdjustQuantField(const AcStrategyImage& ac_strategy, const Rect& rect,
@@ -1040,12 +1158,26 @@ ImageF InitialQuantField(const float butteraugli_target, const Image3F& opsin,
       butteraugli_target, opsin, frame_dim, quant_ac * rescale, pool, mask);
 }
 
+float InitialDistanceForTargetQuality(const CompressParams& cparams) {
+  const float distance =
+      cparams.target_ssimulacra2 > 0.0f
+          ? DistanceFromSsimulacra2(cparams.target_ssimulacra2)
+          : DistanceFromButteraugli(cparams.target_butteraugli);
+  return Clamp1(distance, kMinButteraugliDistance, kMaxButteraugliDistance);
+}
+
 void FindBestQuantizer(const ImageBundle* linear, const Image3F& opsin,
                        PassesEncoderState* enc_state,
                        const JxlCmsInterface& cms, ThreadPool* pool,
                        AuxOut* aux_out, double rescale) {
   const CompressParams& cparams = enc_state->cparams;
-  if (cparams.max_error_mode) {
+  const bool has_target_quality =
+      cparams.target_ssimulacra2 > 0.0f || cparams.target_butteraugli > 0.0f;
+  if (has_target_quality && cparams.resampling == 1) {
+    PROFILER_ZONE("enc find target quality");
+    FindQuantizationForTargetQuality(*linear, opsin, enc_state, cms, pool,
+                                     aux_out);
+  } else if (cparams.max_error_mode) {
     PROFILER_ZONE("enc find best maxerr");
     FindBestQuantizationMaxError(opsin, enc_state, cms, pool, aux_out);
   } else if (cparams.speed_tier <= SpeedTier::kKitten) {
@@ -53,10 +53,15 @@ float InitialQuantDC(float butteraugli_target);
 void AdjustQuantField(const AcStrategyImage& ac_strategy, const Rect& rect,
                       ImageF* quant_field);
 
+// Returns the butteraugli distance at which the target quality of `cparams`
+// is expected to be reached, where the search of FindBestQuantizer starts.
+float InitialDistanceForTargetQuality(const CompressParams& cparams);
+
 // Returns a quantizer that uses an adjusted version of the provided
 // quant_field. Also computes the dequant_map corresponding to the given
 // dequant_float_map and chosen quantization levels.
-// `linear` is only used in Kitten mode or slower.
+// `linear` is only used in Kitten mode or slower, or if a target quality is
+// set, in which case the quantization field is scaled to reach it.
 void FindBestQuantizer(const ImageBundle* linear, const Image3F& opsin,
                        PassesEncoderState* enc_state,
                        const JxlCmsInterface& cms, ThreadPool* pool,
@@ -6,6 +6,7 @@
 #include "lib/jxl/enc_ans.h"
 
 #include <stdint.h>
+#include <string.h>
 
 #include <algorithm>
 #include <array>
@@ -19,6 +20,7 @@
 
 #include "lib/jxl/ans_common.h"
 #include "lib/jxl/base/bits.h"
+#include "lib/jxl/base/byte_order.h"
 #include "lib/jxl/dec_ans.h"
 #include "lib/jxl/enc_aux_out.h"
 #include "lib/jxl/enc_cluster.h"
@@ -697,7 +699,8 @@ class HistogramBuilder {
       const HistogramParams& params,
       const std::vector<std::vector<Token>>& tokens, EntropyEncodingData* codes,
       std::vector<uint8_t>* context_map, bool use_prefix_code,
-      BitWriter* writer, size_t layer, AuxOut* aux_out) const {
+      BitWriter* writer, size_t layer, AuxOut* aux_out,
+      ThreadPool* pool) const {
     size_t cost = 0;
     codes->encoding_info.clear();
     std::vector<Histogram> clustered_histograms(histograms_);
@@ -706,7 +709,7 @@ class HistogramBuilder {
       if (!ans_fuzzer_friendly_) {
         std::vector<uint32_t> histogram_symbols;
         ClusterHistograms(params, histograms_, kClustersLimit,
-                          &clustered_histograms, &histogram_symbols);
+                          &clustered_histograms, &histogram_symbols, pool);
         for (size_t c = 0; c < histograms_.size(); ++c) {
           (*context_map)[c] = static_cast<uint8_t>(histogram_symbols[c]);
         }
@@ -773,25 +776,57 @@ class HistogramBuilder {
       }
     }
     cost += size_writer.size;
-    for (size_t c = 0; c < clustered_histograms.size(); ++c) {
-      size_t num_symbol = 1;
+    const size_t num_histograms = clustered_histograms.size();
+    std::vector<size_t> num_symbols(num_histograms);
+    for (size_t c = 0; c < num_histograms; ++c) {
+      num_symbols[c] = 1;
       for (size_t i = 0; i < clustered_histograms[c].data_.size(); i++) {
-        if (clustered_histograms[c].data_[i]) num_symbol = i + 1;
+        if (clustered_histograms[c].data_[i]) num_symbols[c] = i + 1;
       }
       codes->encoding_info.emplace_back();
-      codes->encoding_info.back().resize(std::max<size_t>(1, num_symbol));
-
-      BitWriter::Allotment allotment(writer, 256 + num_symbol * 24);
-      cost += BuildAndStoreANSEncodingData(
-          params.ans_histogram_strategy, clustered_histograms[c].data_.data(),
-          num_symbol, log_alpha_size, use_prefix_code,
-          codes->encoding_info.back().data(), writer);
+      codes->encoding_info.back().resize(std::max<size_t>(1, num_symbols[c]));
+    }
+    // The histograms are normalized and encoded independently into their own
+    // BitWriters, which are then concatenated in order.
+    std::vector<BitWriter> histogram_writers(writer ? num_histograms : 0);
+    std::vector<size_t> histogram_costs(num_histograms);
+    JXL_CHECK(RunOnPool(
+        pool, 0, num_histograms, ThreadPool::NoInit,
+        [&](const uint32_t c, size_t /* thread */) {
+          BitWriter* histogram_writer =
+              writer ? &histogram_writers[c] : nullptr;
+          BitWriter::Allotment allotment(histogram_writer,
+                                         256 + num_symbols[c] * 24);
+          histogram_costs[c] = BuildAndStoreANSEncodingData(
+              params.ans_histogram_strategy,
+              clustered_histograms[c].data_.data(), num_symbols[c],
+              log_alpha_size, use_prefix_code, codes->encoding_info[c].data(),
+              histogram_writer);
+          allotment.ReclaimAndCharge(histogram_writer, layer,
+                                     /*aux_out=*/nullptr);
+        },
+        "BuildANSEncodingData"));
+    for (size_t c = 0; c < num_histograms; ++c) {
+      cost += histogram_costs[c];
+      if (writer == nullptr) continue;
+      BitWriter::Allotment allotment(writer,
+                                     histogram_writers[c].BitsWritten());
+      writer->AppendUnaligned(histogram_writers[c]);
       allotment.FinishedHistogram(writer);
       allotment.ReclaimAndCharge(writer, layer, aux_out);
     }
     return cost;
   }
 
+  // Adds the symbols visited by `other`, which must have the same number of
+  // contexts.
+  void Add(const HistogramBuilder& other) {
+    JXL_DASSERT(other.histograms_.size() == histograms_.size());
+    for (size_t i = 0; i < histograms_.size(); ++i) {
+      histograms_[i].AddHistogram(other.histograms_[i]);
+    }
+  }
+
   const Histogram& Histo(size_t i) const { return histograms_[i]; }
 
  private:
@@ -1025,6 +1060,30 @@ struct HashChain {
     return result & hash_mask_;
   }
 
+  // Returns the number of equal values starting at positions i and j < i,
+  // without reaching `end`. Compares two values at a time.
+  size_t MatchLength(size_t i, size_t j, size_t end) const {
+    const uint32_t* a = data_.data() + i;
+    const uint32_t* b = data_.data() + j;
+    const size_t max_len = end - i;
+    size_t len = 0;
+    for (; len + 2 <= max_len; len += 2) {
+      uint64_t va, vb;
+      memcpy(&va, a + len, sizeof(va));
+      memcpy(&vb, b + len, sizeof(vb));
+      const uint64_t diff = va ^ vb;
+      if (diff != 0) {
+#if JXL_BYTE_ORDER_LITTLE
+        return len + Num0BitsBelowLS1Bit_Nonzero(diff) / 32;
+#else
+        return len + Num0BitsAboveMS1Bit_Nonzero(diff) / 32;
+#endif
+      }
+    }
+    if (len < max_len && a[len] == b[len]) len++;
+    return len;
+  }
+
   uint32_t CountZeros(size_t pos, uint32_t prevzeros) const {
     size_t end = pos + window_size_;
     if (end > size_) end = size_;
@@ -1088,11 +1147,7 @@ struct HashChain {
           i += r;
           j += r;
         }
-        while (i < end && data_[i] == data_[j]) {
-          i++;
-          j++;
-        }
-        len = i - pos;
+        len = i + MatchLength(i, j, end) - pos;
         // This can trigger even if the new length is slightly smaller than the
         // best length, because it is possible for a slightly cheaper distance
         // symbol to occur.
@@ -1248,6 +1303,7 @@ void ApplyLZ77_LZ77(const HistogramParams& params, size_t num_contexts,
 
     HashChain chain(in.data(), in.size(), window_size, min_length, max_length,
                     distance_multiplier);
+    chain.maxchainlength = params.lz77_max_chain_length;
     size_t len, dist_symbol;
 
     const size_t max_lazy_match_len = 256;  // 0 to disable lazy matching
@@ -1355,6 +1411,7 @@ void ApplyLZ77_Optimal(const HistogramParams& params, size_t num_contexts,
 
     HashChain chain(in.data(), in.size(), window_size, min_length, max_length,
                     distance_multiplier);
+    chain.maxchainlength = params.lz77_max_chain_length;
 
     struct MatchInfo {
       uint32_t len;
@@ -1466,6 +1523,43 @@ void ApplyLZ77(const HistogramParams& params, size_t num_contexts,
     JXL_ABORT("Not implemented");
   }
 }
+
+// Returns the hybrid uint configuration used for the histograms that are
+// clustered.
+HybridUintConfig ClusteringUintConfig(const HistogramParams& params) {
+  HybridUintConfig uint_config;  //  Default config for clustering.
+  // Unless we are using the kContextMap histogram option.
+  if (params.uint_method == HistogramParams::HybridUintMethod::kContextMap) {
+    uint_config = HybridUintConfig(2, 0, 1);
+  }
+  if (params.uint_method == HistogramParams::HybridUintMethod::k000) {
+    uint_config = HybridUintConfig(0, 0, 0);
+  }
+  if (ans_fuzzer_friendly_) {
+    uint_config = HybridUintConfig(10, 0, 0);
+  }
+  return uint_config;
+}
+
+bool UsePrefixCode(const HistogramParams& params, size_t total_tokens,
+                   size_t num_contexts, const HistogramBuilder& builder) {
+  bool use_prefix_code =
+      params.force_huffman || total_tokens < 100 ||
+      params.clustering == HistogramParams::ClusteringType::kFastest ||
+      ans_fuzzer_friendly_;
+  if (!use_prefix_code) {
+    bool all_singleton = true;
+    for (size_t i = 0; i < num_contexts; i++) {
+      if (builder.Histo(i).ShannonEntropy() >= 1e-5) {
+        all_singleton = false;
+      }
+    }
+    if (all_singleton) {
+      use_prefix_code = true;
+    }
+  }
+  return use_prefix_code;
+}
 }  // namespace
 
 size_t BuildAndEncodeHistograms(const HistogramParams& params,
@@ -1474,7 +1568,7 @@ size_t BuildAndEncodeHistograms(const HistogramParams& params,
                                 EntropyEncodingData* codes,
                                 std::vector<uint8_t>* context_map,
                                 BitWriter* writer, size_t layer,
-                                AuxOut* aux_out) {
+                                AuxOut* aux_out, ThreadPool* pool) {
   size_t total_bits = 0;
   codes->lz77.nonserialized_distance_context = num_contexts;
   std::vector<std::vector<Token>> tokens_lz77;
@@ -1512,17 +1606,7 @@ size_t BuildAndEncodeHistograms(const HistogramParams& params,
   size_t total_tokens = 0;
   // Build histograms.
   HistogramBuilder builder(num_contexts);
-  HybridUintConfig uint_config;  //  Default config for clustering.
-  // Unless we are using the kContextMap histogram option.
-  if (params.uint_method == HistogramParams::HybridUintMethod::kContextMap) {
-    uint_config = HybridUintConfig(2, 0, 1);
-  }
-  if (params.uint_method == HistogramParams::HybridUintMethod::k000) {
-    uint_config = HybridUintConfig(0, 0, 0);
-  }
-  if (ans_fuzzer_friendly_) {
-    uint_config = HybridUintConfig(10, 0, 0);
-  }
+  const HybridUintConfig uint_config = ClusteringUintConfig(params);
   for (size_t i = 0; i < tokens.size(); ++i) {
     if (codes->lz77.enabled) {
       for (size_t j = 0; j < tokens[i].size(); ++j) {
@@ -1553,26 +1637,92 @@ size_t BuildAndEncodeHistograms(const HistogramParams& params,
     }
   }
 
-  bool use_prefix_code =
-      params.force_huffman || total_tokens < 100 ||
-      params.clustering == HistogramParams::ClusteringType::kFastest ||
-      ans_fuzzer_friendly_;
-  if (!use_prefix_code) {
-    bool all_singleton = true;
-    for (size_t i = 0; i < num_contexts; i++) {
-      if (builder.Histo(i).ShannonEntropy() >= 1e-5) {
-        all_singleton = false;
-      }
-    }
-    if (all_singleton) {
-      use_prefix_code = true;
-    }
-  }
+  const bool use_prefix_code =
+      UsePrefixCode(params, total_tokens, num_contexts, builder);
 
   // Encode histograms.
   total_bits += builder.BuildAndStoreEntropyCodes(params, tokens, codes,
                                                   context_map, use_prefix_code,
-                                                  writer, layer, aux_out);
+                                                  writer, layer, aux_out, pool);
+  allotment.FinishedHistogram(writer);
+  allotment.ReclaimAndCharge(writer, layer, aux_out);
+
+  if (aux_out != nullptr) {
+    aux_out->layers[layer].num_clustered_histograms +=
+        codes->encoding_info.size();
+  }
+  return total_bits;
+}
+
+size_t BuildAndEncodeHistograms(
+    const HistogramParams& params, size_t num_contexts, size_t num_streams,
+    const std::function<void(size_t, std::vector<Token>*)>& get_tokens,
+    EntropyEncodingData* codes, std::vector<uint8_t>* context_map,
+    BitWriter* writer, size_t layer, AuxOut* aux_out, ThreadPool* pool) {
+  // The hybrid uint configurations of these methods do not depend on the
+  // tokens, see ChooseUintConfigs.
+  JXL_ASSERT(params.uint_method == HistogramParams::HybridUintMethod::kNone ||
+             params.uint_method == HistogramParams::HybridUintMethod::k000 ||
+             params.uint_method ==
+                 HistogramParams::HybridUintMethod::kContextMap);
+  JXL_ASSERT(params.lz77_method == HistogramParams::LZ77Method::kNone);
+  size_t total_bits = 0;
+  codes->lz77.enabled = false;
+  codes->lz77.nonserialized_distance_context = num_contexts;
+
+  const size_t max_contexts = std::min(num_contexts, kClustersLimit);
+  BitWriter::Allotment allotment(writer,
+                                 128 + num_contexts * 40 + max_contexts * 96);
+  if (writer) {
+    JXL_CHECK(Bundle::Write(codes->lz77, writer, layer, aux_out));
+  } else {
+    size_t ebits, bits;
+    JXL_CHECK(Bundle::CanEncode(codes->lz77, &ebits, &bits));
+    total_bits += bits;
+  }
+
+  // Build histograms, one set per thread, without keeping the tokens of more
+  // than one stream per thread.
+  const HybridUintConfig uint_config = ClusteringUintConfig(params);
+  std::vector<HistogramBuilder> thread_builders;
+  std::vector<std::vector<Token>> thread_tokens;
+  std::vector<size_t> thread_total_tokens;
+  const auto init = [&](size_t num_threads) {
+    thread_builders.resize(num_threads, HistogramBuilder(num_contexts));
+    thread_tokens.resize(num_threads);
+    thread_total_tokens.resize(num_threads);
+    return true;
+  };
+  const auto visit_stream = [&](const uint32_t stream, size_t thread) {
+    std::vector<Token>& tokens = thread_tokens[thread];
+    tokens.clear();
+    get_tokens(stream, &tokens);
+    for (const Token& token : tokens) {
+      uint32_t tok, nbits, bits;
+      uint_config.Encode(token.value, &tok, &nbits, &bits);
+      thread_builders[thread].VisitSymbol(tok, token.context);
+    }
+    thread_total_tokens[thread] += tokens.size();
+  };
+  JXL_CHECK(RunOnPool(pool, 0, num_streams, init, visit_stream,
+                      "BuildHistograms"));
+  thread_tokens.clear();
+  // Symbol counts are integers, so the sum does not depend on which thread
+  // visited which stream.
+  HistogramBuilder builder(num_contexts);
+  size_t total_tokens = 0;
+  for (size_t i = 0; i < thread_builders.size(); ++i) {
+    builder.Add(thread_builders[i]);
+    total_tokens += thread_total_tokens[i];
+  }
+
+  const bool use_prefix_code =
+      UsePrefixCode(params, total_tokens, num_contexts, builder);
+
+  // Encode histograms. Given the above parameters, the tokens are not needed.
+  total_bits += builder.BuildAndStoreEntropyCodes(
+      params, /*tokens=*/{}, codes, context_map, use_prefix_code, writer, layer,
+      aux_out, pool);
   allotment.FinishedHistogram(writer);
   allotment.ReclaimAndCharge(writer, layer, aux_out);
 
@@ -16,11 +16,13 @@
 #include <string.h>
 
 #include <algorithm>
+#include <functional>
 #include <vector>
 
 #include "lib/jxl/ans_common.h"
 #include "lib/jxl/ans_params.h"
 #include "lib/jxl/base/compiler_specific.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
 #include "lib/jxl/dec_ans.h"
 #include "lib/jxl/enc_ans_params.h"
@@ -115,7 +117,19 @@ size_t BuildAndEncodeHistograms(const HistogramParams& params,
                                 EntropyEncodingData* codes,
                                 std::vector<uint8_t>* context_map,
                                 BitWriter* writer, size_t layer,
-                                AuxOut* aux_out);
+                                AuxOut* aux_out, ThreadPool* pool = nullptr);
+
+// Same as above, but the tokens of each of the `num_streams` streams are
+// obtained by calling `get_tokens(stream, &tokens)` and are not kept, so only
+// one stream per thread is in memory at a time. Only supports parameters that
+// do not need all the tokens to choose the encoding, i.e. no LZ77 and a fixed
+// hybrid uint configuration (kNone, k000 or kContextMap).
+size_t BuildAndEncodeHistograms(
+    const HistogramParams& params, size_t num_contexts, size_t num_streams,
+    const std::function<void(size_t, std::vector<Token>*)>& get_tokens,
+    EntropyEncodingData* codes, std::vector<uint8_t>* context_map,
+    BitWriter* writer, size_t layer, AuxOut* aux_out,
+    ThreadPool* pool = nullptr);
 
 // Write the tokens to a string.
 void WriteTokens(const std::vector<Token>& tokens,
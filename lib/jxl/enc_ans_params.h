@@ -65,6 +65,9 @@ struct HistogramParams {
   ClusteringType clustering = ClusteringType::kBest;
   HybridUintMethod uint_method = HybridUintMethod::kBest;
   LZ77Method lz77_method = LZ77Method::kRLE;
+  // Maximum number of earlier positions tried by the LZ77 matcher for each
+  // symbol. Lower values are faster but may miss the longest matches.
+  uint32_t lz77_max_chain_length = 256;
   ANSHistogramStrategy ans_histogram_strategy = ANSHistogramStrategy::kPrecise;
   std::vector<size_t> image_widths;
   size_t max_histograms = ~0;
@@ -105,6 +105,18 @@ void BitWriter::AppendByteAligned(const BitWriter& other) {
   AppendByteAligned(other.GetSpan());
 }
 
+void BitWriter::AppendUnaligned(const BitWriter& other) {
+  const size_t full_bytes = other.BitsWritten() / kBitsPerByte;
+  const size_t remainder_bits = other.BitsWritten() % kBitsPerByte;
+  for (size_t i = 0; i < full_bytes; ++i) {
+    Write(kBitsPerByte, other.storage_[i]);
+  }
+  if (remainder_bits != 0) {
+    Write(remainder_bits,
+          other.storage_[full_bytes] & ((1u << remainder_bits) - 1));
+  }
+}
+
 void BitWriter::AppendByteAligned(const std::vector<BitWriter>& others) {
   // Total size to add so we can preallocate
   size_t other_bytes = 0;
@@ -68,6 +68,10 @@ struct BitWriter {
   void AppendByteAligned(const std::vector<std::unique_ptr<BitWriter>>& others);
   void AppendByteAligned(const std::vector<BitWriter>& others);
 
+  // Appends all the bits of `other`, which need not be byte-aligned, and
+  // neither does *this. Unlike AppendByteAligned, requires an allotment.
+  void AppendUnaligned(const BitWriter& other);
+
   class Allotment {
    public:
     // Expands a BitWriter's storage. Must happen before calling Write or
@@ -8,7 +8,9 @@
 #include <algorithm>
 #include <vector>
 
+#include "lib/jxl/base/profiler.h"
 #include "lib/jxl/color_management.h"
+#include "lib/jxl/common.h"
 #include "lib/jxl/enc_image_bundle.h"
 
 namespace jxl {
@@ -17,6 +19,11 @@ JxlButteraugliComparator::JxlButteraugliComparator(
     const ButteraugliParams& params, const JxlCmsInterface& cms)
     : params_(params), cms_(cms) {}
 
+JxlButteraugliComparator::JxlButteraugliComparator(
+    const ButteraugliParams& params, const JxlCmsInterface& cms,
+    bool in_strips, ThreadPool* pool)
+    : params_(params), cms_(cms), in_strips_(in_strips), pool_(pool) {}
+
 Status JxlButteraugliComparator::SetReferenceImage(const ImageBundle& ref) {
   const ImageBundle* ref_linear_srgb;
   ImageMetadata metadata = *ref.metadata();
@@ -26,8 +33,12 @@ Status JxlButteraugliComparator::SetReferenceImage(const ImageBundle& ref) {
     return false;
   }
 
-  comparator_.reset(
-      new ButteraugliComparator(ref_linear_srgb->color(), params_));
+  if (in_strips_) {
+    ref_ = CopyImage(ref_linear_srgb->color());
+  } else {
+    comparator_.reset(
+        new ButteraugliComparator(ref_linear_srgb->color(), params_));
+  }
   xsize_ = ref.xsize();
   ysize_ = ref.ysize();
   return true;
@@ -35,7 +46,7 @@ Status JxlButteraugliComparator::SetReferenceImage(const ImageBundle& ref) {
 
 Status JxlButteraugliComparator::CompareWith(const ImageBundle& actual,
                                              ImageF* diffmap, float* score) {
-  if (!comparator_) {
+  if (in_strips_ ? ref_.xsize() == 0 : !comparator_) {
     return JXL_FAILURE("Must set reference image first");
   }
   if (xsize_ != actual.xsize() || ysize_ != actual.ysize()) {
@@ -52,7 +63,12 @@ Status JxlButteraugliComparator::CompareWith(const ImageBundle& actual,
   }
 
   ImageF temp_diffmap(xsize_, ysize_);
-  comparator_->Diffmap(actual_linear_srgb->color(), temp_diffmap);
+  if (in_strips_) {
+    ButteraugliDiffmapInStrips(ref_, actual_linear_srgb->color(), params_,
+                               pool_, temp_diffmap);
+  } else {
+    comparator_->Diffmap(actual_linear_srgb->color(), temp_diffmap);
+  }
 
   if (score != nullptr) {
     *score = ButteraugliScoreFromDiffmap(temp_diffmap, &params_);
@@ -72,11 +88,155 @@ float JxlButteraugliComparator::BadQualityScore() const {
   return ButteraugliFuzzyInverse(0.5);
 }
 
+namespace {
+
+// Side of the tiles that are compared separately. Even, as required by
+// ButteraugliDiffmapOfRect.
+constexpr size_t kTileDim = 256;
+// Side of the cells in which the changed pixels are tracked.
+constexpr size_t kCellDim = 32;
+static_assert(kTileDim % kCellDim == 0, "Tiles must consist of cells");
+
+}  // namespace
+
+IncrementalButteraugliComparator::IncrementalButteraugliComparator(
+    const ButteraugliParams& params, const JxlCmsInterface& cms,
+    ThreadPool* pool)
+    : params_(params), cms_(cms), pool_(pool) {}
+
+Status IncrementalButteraugliComparator::SetReferenceImage(
+    const ImageBundle& ref) {
+  JXL_RETURN_IF_ERROR(ToLinearSRGB(ref, &reference_));
+  comparator_ = jxl::make_unique<ButteraugliComparator>(reference_, params_);
+  num_tiles_ = DivCeil(reference_.xsize(), kTileDim) *
+               DivCeil(reference_.ysize(), kTileDim);
+  previous_ = Image3F();
+  return true;
+}
+
+Status IncrementalButteraugliComparator::CompareWith(const ImageBundle& actual,
+                                                     ImageF* diffmap,
+                                                     float* score) {
+  if (!comparator_) {
+    return JXL_FAILURE("Must set reference image first");
+  }
+  if (!SameSize(reference_, actual)) {
+    return JXL_FAILURE("Images must have same size");
+  }
+  Image3F distorted;
+  JXL_RETURN_IF_ERROR(ToLinearSRGB(actual, &distorted));
+  std::vector<uint32_t> dirty_tiles;
+  if (previous_.xsize() == 0 || !FindDirtyTiles(distorted, &dirty_tiles)) {
+    PROFILER_ZONE("enc Butteraugli full");
+    diffmap_ = ImageF(distorted.xsize(), distorted.ysize());
+    comparator_->Diffmap(distorted, diffmap_);
+  } else {
+    PROFILER_ZONE("enc Butteraugli tiles");
+    const auto compare_tile = [&](const uint32_t i, size_t /* thread */) {
+      ButteraugliDiffmapOfRect(reference_, distorted, params_,
+                               TileRect(dirty_tiles[i]), diffmap_);
+    };
+    JXL_RETURN_IF_ERROR(RunOnPool(pool_, 0, dirty_tiles.size(),
+                                  ThreadPool::NoInit, compare_tile,
+                                  "IncrementalButteraugli"));
+  }
+  previous_ = std::move(distorted);
+  if (score != nullptr) {
+    *score = ButteraugliScoreFromDiffmap(diffmap_, &params_);
+  }
+  if (diffmap != nullptr) {
+    *diffmap = CopyImage(diffmap_);
+  }
+  return true;
+}
+
+float IncrementalButteraugliComparator::GoodQualityScore() const {
+  return ButteraugliFuzzyInverse(1.5);
+}
+
+float IncrementalButteraugliComparator::BadQualityScore() const {
+  return ButteraugliFuzzyInverse(0.5);
+}
+
+Status IncrementalButteraugliComparator::ToLinearSRGB(const ImageBundle& ib,
+                                                      Image3F* out) const {
+  ImageMetadata metadata = *ib.metadata();
+  ImageBundle store(&metadata);
+  const ImageBundle* linear_srgb;
+  JXL_RETURN_IF_ERROR(TransformIfNeeded(
+      ib, ColorEncoding::LinearSRGB(ib.IsGray()), cms_, pool_, &store,
+      &linear_srgb));
+  *out = CopyImage(*linear_srgb->color());
+  return true;
+}
+
+Rect IncrementalButteraugliComparator::TileRect(size_t tile) const {
+  const size_t xsize_tiles = DivCeil(reference_.xsize(), kTileDim);
+  const size_t x0 = (tile % xsize_tiles) * kTileDim;
+  const size_t y0 = (tile / xsize_tiles) * kTileDim;
+  return Rect(x0, y0, kTileDim, kTileDim, reference_.xsize(),
+              reference_.ysize());
+}
+
+bool IncrementalButteraugliComparator::FindDirtyTiles(
+    const Image3F& distorted, std::vector<uint32_t>* dirty_tiles) const {
+  const size_t xsize = distorted.xsize();
+  const size_t ysize = distorted.ysize();
+  const size_t xsize_cells = DivCeil(xsize, kCellDim);
+  const size_t ysize_cells = DivCeil(ysize, kCellDim);
+  std::vector<uint8_t> changed(xsize_cells * ysize_cells);
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 0; y < ysize; ++y) {
+      const float* JXL_RESTRICT row = distorted.ConstPlaneRow(c, y);
+      const float* JXL_RESTRICT row_prev = previous_.ConstPlaneRow(c, y);
+      uint8_t* JXL_RESTRICT row_changed =
+          changed.data() + (y / kCellDim) * xsize_cells;
+      for (size_t x = 0; x < xsize; ++x) {
+        if (row[x] != row_prev[x]) row_changed[x / kCellDim] = 1;
+      }
+    }
+  }
+  const size_t tile_cells = kTileDim / kCellDim;
+  const size_t margin_cells = DivCeil(kButteraugliDiffmapMargin, kCellDim);
+  const size_t margin = kButteraugliDiffmapMargin;
+  size_t cost = 0;
+  for (size_t tile = 0; tile < num_tiles_; ++tile) {
+    const Rect tile_rect = TileRect(tile);
+    const size_t cx = tile_rect.x0() / kCellDim;
+    const size_t cy = tile_rect.y0() / kCellDim;
+    const size_t cx0 = cx - std::min(cx, margin_cells);
+    const size_t cy0 = cy - std::min(cy, margin_cells);
+    const size_t cx1 = std::min(xsize_cells, cx + tile_cells + margin_cells);
+    const size_t cy1 = std::min(ysize_cells, cy + tile_cells + margin_cells);
+    bool dirty = false;
+    for (size_t y = cy0; y < cy1 && !dirty; ++y) {
+      for (size_t x = cx0; x < cx1; ++x) {
+        if (changed[y * xsize_cells + x]) {
+          dirty = true;
+          break;
+        }
+      }
+    }
+    if (!dirty) continue;
+    // A tile computes both the reference and the distorted side of its crop,
+    // the whole image only the distorted side.
+    const size_t crop_xsize =
+        std::min(tile_rect.x1() + margin, xsize) -
+        (tile_rect.x0() > margin ? tile_rect.x0() - margin : 0);
+    const size_t crop_ysize =
+        std::min(tile_rect.y1() + margin, ysize) -
+        (tile_rect.y0() > margin ? tile_rect.y0() - margin : 0);
+    cost += 2 * crop_xsize * crop_ysize;
+    dirty_tiles->push_back(tile);
+  }
+  return cost < xsize * ysize;
+}
+
 float ButteraugliDistance(const ImageBundle& rgb0, const ImageBundle& rgb1,
                           const ButteraugliParams& params,
                           const JxlCmsInterface& cms, ImageF* distmap,
                           ThreadPool* pool) {
-  JxlButteraugliComparator comparator(params, cms);
+  JxlButteraugliComparator comparator(params, cms, /*in_strips=*/true, pool);
   return ComputeScore(rgb0, rgb1, &comparator, cms, distmap, pool);
 }
 
@@ -85,7 +245,7 @@ float ButteraugliDistance(const std::vector<ImageBundle>& frames0,
                           const ButteraugliParams& params,
                           const JxlCmsInterface& cms, ImageF* distmap,
                           ThreadPool* pool) {
-  JxlButteraugliComparator comparator(params, cms);
+  JxlButteraugliComparator comparator(params, cms, /*in_strips=*/true, pool);
   JXL_ASSERT(frames0.size() == frames1.size());
   float max_dist = 0.0f;
   for (size_t i = 0; i < frames0.size(); ++i) {
@@ -10,6 +10,7 @@
 #include <stddef.h>
 
 #include <memory>
+#include <vector>
 
 #include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/base/status.h"
@@ -25,6 +26,14 @@ class JxlButteraugliComparator : public Comparator {
   explicit JxlButteraugliComparator(const ButteraugliParams& params,
                                     const JxlCmsInterface& cms);
 
+  // If `in_strips` is set, only a copy of the reference image is kept and
+  // every comparison is computed by ButteraugliDiffmapInStrips on `pool`. The
+  // results are the same, but this needs much less memory for one comparison
+  // and is slower for many comparisons with the same reference.
+  JxlButteraugliComparator(const ButteraugliParams& params,
+                           const JxlCmsInterface& cms, bool in_strips,
+                           ThreadPool* pool);
+
   Status SetReferenceImage(const ImageBundle& ref) override;
 
   Status CompareWith(const ImageBundle& actual, ImageF* diffmap,
@@ -37,10 +46,52 @@ class JxlButteraugliComparator : public Comparator {
   ButteraugliParams params_;
   JxlCmsInterface cms_;
   std::unique_ptr<ButteraugliComparator> comparator_;
+  bool in_strips_ = false;
+  ThreadPool* pool_ = nullptr;
+  // Only used if in_strips_.
+  Image3F ref_;
   size_t xsize_ = 0;
   size_t ysize_ = 0;
 };
 
+// Same as JxlButteraugliComparator, for a sequence of images that differ from
+// each other only in some areas, such as the decoded images of the
+// quantization loop. Only the tiles whose diffmap may differ from the one of
+// the previous image are compared again, with ButteraugliDiffmapOfRect on
+// `pool`; the diffmaps are the same as with JxlButteraugliComparator.
+class IncrementalButteraugliComparator : public Comparator {
+ public:
+  IncrementalButteraugliComparator(const ButteraugliParams& params,
+                                   const JxlCmsInterface& cms,
+                                   ThreadPool* pool);
+
+  Status SetReferenceImage(const ImageBundle& ref) override;
+
+  Status CompareWith(const ImageBundle& actual, ImageF* diffmap,
+                     float* score) override;
+
+  float GoodQualityScore() const override;
+  float BadQualityScore() const override;
+
+ private:
+  Status ToLinearSRGB(const ImageBundle& ib, Image3F* out) const;
+  Rect TileRect(size_t tile) const;
+  // Sets `dirty_tiles` to the tiles whose diffmap may differ from the one of
+  // the previous image. Returns false if comparing the whole image is cheaper.
+  bool FindDirtyTiles(const Image3F& distorted,
+                      std::vector<uint32_t>* dirty_tiles) const;
+
+  ButteraugliParams params_;
+  JxlCmsInterface cms_;
+  ThreadPool* pool_;
+  // Linear sRGB images.
+  Image3F reference_;
+  Image3F previous_;
+  ImageF diffmap_;
+  std::unique_ptr<ButteraugliComparator> comparator_;
+  size_t num_tiles_ = 0;
+};
+
 // Returns the butteraugli distance between rgb0 and rgb1.
 // If distmap is not null, it must be the same size as rgb0 and rgb1.
 float ButteraugliDistance(const ImageBundle& rgb0, const ImageBundle& rgb1,
@@ -82,9 +82,33 @@ float HistogramDistance(const Histogram& a, const Histogram& b) {
   return total_distance - a.entropy_ - b.entropy_;
 }
 
+// Number of input histograms processed by one thread pool task.
+constexpr size_t kHistogramsPerTask = 64;
+
+// Runs func(i) for all the input histograms i, in parallel if there are
+// enough of them.
+template <typename Func>
+void ForEachHistogram(size_t num_histograms, ThreadPool* pool,
+                      const Func& func) {
+  const size_t num_tasks = DivCeil(num_histograms, kHistogramsPerTask);
+  JXL_CHECK(RunOnPool(
+      num_tasks > 1 ? pool : nullptr, 0, num_tasks, ThreadPool::NoInit,
+      [&](const uint32_t task, size_t /* thread */) {
+        const size_t begin = task * kHistogramsPerTask;
+        const size_t end =
+            std::min(num_histograms, begin + kHistogramsPerTask);
+        for (size_t i = begin; i < end; i++) func(i);
+      },
+      "ClusterHistograms"));
+}
+
 // First step of a k-means clustering with a fancy distance metric.
+// The entropies and distances are computed in parallel, but the choices based
+// on them are made in the same order as serially, so the result does not
+// depend on the thread pool.
 void FastClusterHistograms(const std::vector<Histogram>& in,
-                           size_t max_histograms, std::vector<Histogram>* out,
+                           size_t max_histograms, ThreadPool* pool,
+                           std::vector<Histogram>* out,
                            std::vector<uint32_t>* histogram_symbols) {
   PROFILER_FUNC;
   out->clear();
@@ -93,29 +117,36 @@ void FastClusterHistograms(const std::vector<Histogram>& in,
   histogram_symbols->resize(in.size(), max_histograms);
 
   std::vector<float> dists(in.size(), std::numeric_limits<float>::max());
-  size_t largest_idx = 0;
-  for (size_t i = 0; i < in.size(); i++) {
+  ForEachHistogram(in.size(), pool, [&](size_t i) {
     if (in[i].total_count_ == 0) {
       (*histogram_symbols)[i] = 0;
       dists[i] = 0.0f;
-      continue;
+      return;
     }
     HistogramEntropy(in[i]);
+  });
+  size_t largest_idx = 0;
+  for (size_t i = 0; i < in.size(); i++) {
     if (in[i].total_count_ > in[largest_idx].total_count_) {
       largest_idx = i;
     }
   }
 
   constexpr float kMinDistanceForDistinct = 48.0f;
+  std::vector<uint8_t> updated(in.size());
   while (out->size() < max_histograms) {
     (*histogram_symbols)[largest_idx] = out->size();
     out->push_back(in[largest_idx]);
     dists[largest_idx] = 0.0f;
+    const Histogram& last = out->back();
+    ForEachHistogram(in.size(), pool, [&](size_t i) {
+      updated[i] = dists[i] != 0.0f;
+      if (!updated[i]) return;
+      dists[i] = std::min(HistogramDistance(in[i], last), dists[i]);
+    });
     largest_idx = 0;
     for (size_t i = 0; i < in.size(); i++) {
-      if (dists[i] == 0.0f) continue;
-      dists[i] = std::min(HistogramDistance(in[i], out->back()), dists[i]);
-      if (dists[i] > dists[largest_idx]) largest_idx = i;
+      if (updated[i] && dists[i] > dists[largest_idx]) largest_idx = i;
     }
     if (dists[largest_idx] < kMinDistanceForDistinct) break;
   }
@@ -184,7 +215,8 @@ void HistogramReindex(std::vector<Histogram>* out,
 void ClusterHistograms(const HistogramParams params,
                        const std::vector<Histogram>& in, size_t max_histograms,
                        std::vector<Histogram>* out,
-                       std::vector<uint32_t>* histogram_symbols) {
+                       std::vector<uint32_t>* histogram_symbols,
+                       ThreadPool* pool) {
   max_histograms = std::min(max_histograms, params.max_histograms);
   max_histograms = std::min(max_histograms, in.size());
   if (params.clustering == HistogramParams::ClusteringType::kFastest) {
@@ -192,7 +224,7 @@ void ClusterHistograms(const HistogramParams params,
   }
 
   HWY_DYNAMIC_DISPATCH(FastClusterHistograms)
-  (in, max_histograms, out, histogram_symbols);
+  (in, max_histograms, pool, out, histogram_symbols);
 
   if (params.clustering == HistogramParams::ClusteringType::kBest) {
     for (size_t i = 0; i < out->size(); i++) {
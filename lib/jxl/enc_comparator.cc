@@ -127,4 +127,83 @@ float ComputeScore(const ImageBundle& rgb0, const ImageBundle& rgb1,
   return std::max(dist_black, dist_white);
 }
 
+Status ReferenceComparison::SetReferenceImage(const ImageBundle& ref,
+                                              ThreadPool* pool) {
+  PROFILER_FUNC;
+  reference_set_ = false;
+  ImageMetadata metadata = *ref.metadata();
+  ImageBundle store(&metadata);
+  const ImageBundle* linear_srgb;
+  JXL_RETURN_IF_ERROR(TransformIfNeeded(
+      ref, ColorEncoding::LinearSRGB(ref.IsGray()), cms_, pool, &store,
+      &linear_srgb));
+  reference_has_alpha_ = ref.HasAlpha();
+  if (!reference_has_alpha_) {
+    // Blending would not change the reference, so one comparator suffices.
+    JXL_RETURN_IF_ERROR(comparator_black_->SetReferenceImage(*linear_srgb));
+  } else {
+    ImageBundle blended_black = linear_srgb->Copy();
+    AlphaBlend(0.0f, &blended_black);
+    JXL_RETURN_IF_ERROR(comparator_black_->SetReferenceImage(blended_black));
+    ImageBundle blended_white = linear_srgb->Copy();
+    AlphaBlend(1.0f, &blended_white);
+    JXL_RETURN_IF_ERROR(comparator_white_->SetReferenceImage(blended_white));
+  }
+  reference_set_ = true;
+  return true;
+}
+
+Status ReferenceComparison::CompareWith(const ImageBundle& actual,
+                                        ImageF* diffmap, float* score,
+                                        ThreadPool* pool) {
+  PROFILER_FUNC;
+  if (!reference_set_) {
+    return JXL_FAILURE("Must set reference image first");
+  }
+  ImageMetadata metadata = *actual.metadata();
+  ImageBundle store(&metadata);
+  const ImageBundle* linear_srgb;
+  JXL_RETURN_IF_ERROR(TransformIfNeeded(
+      actual, ColorEncoding::LinearSRGB(actual.IsGray()), cms_, pool, &store,
+      &linear_srgb));
+
+  if (!reference_has_alpha_ && !actual.HasAlpha()) {
+    float dist;
+    JXL_RETURN_IF_ERROR(
+        comparator_black_->CompareWith(*linear_srgb, diffmap, &dist));
+    if (score != nullptr) *score = dist;
+    return true;
+  }
+
+  ImageBundle blended_black = linear_srgb->Copy();
+  AlphaBlend(0.0f, &blended_black);
+  ImageBundle blended_white = linear_srgb->Copy();
+  AlphaBlend(1.0f, &blended_white);
+  Comparator* comparator_white =
+      reference_has_alpha_ ? comparator_white_ : comparator_black_;
+  ImageF diffmap_black, diffmap_white;
+  float dist_black, dist_white;
+  JXL_RETURN_IF_ERROR(comparator_black_->CompareWith(
+      blended_black, diffmap ? &diffmap_black : nullptr, &dist_black));
+  JXL_RETURN_IF_ERROR(comparator_white->CompareWith(
+      blended_white, diffmap ? &diffmap_white : nullptr, &dist_white));
+
+  // diffmap and score are the max of diffmap_black/white.
+  if (diffmap != nullptr) {
+    const size_t xsize = actual.xsize();
+    const size_t ysize = actual.ysize();
+    *diffmap = ImageF(xsize, ysize);
+    for (size_t y = 0; y < ysize; ++y) {
+      const float* JXL_RESTRICT row_black = diffmap_black.ConstRow(y);
+      const float* JXL_RESTRICT row_white = diffmap_white.ConstRow(y);
+      float* JXL_RESTRICT row_out = diffmap->Row(y);
+      for (size_t x = 0; x < xsize; ++x) {
+        row_out[x] = std::max(row_black[x], row_white[x]);
+      }
+    }
+  }
+  if (score != nullptr) *score = std::max(dist_black, dist_white);
+  return true;
+}
+
 }  // namespace jxl
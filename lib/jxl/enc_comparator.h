@@ -47,6 +47,31 @@ float ComputeScore(const ImageBundle& rgb0, const ImageBundle& rgb1,
                    Comparator* comparator, const JxlCmsInterface& cms,
                    ImageF* diffmap = nullptr, ThreadPool* pool = nullptr);
 
+// Computes the same scores as ComputeScore between a fixed reference image and
+// any number of other images, but prepares the reference only once. Images
+// with alpha are blended on black and on white backgrounds, and compared with
+// the respective comparator. The comparators must outlive this object.
+class ReferenceComparison {
+ public:
+  ReferenceComparison(Comparator* comparator_black,
+                      Comparator* comparator_white, const JxlCmsInterface& cms)
+      : comparator_black_(comparator_black),
+        comparator_white_(comparator_white),
+        cms_(cms) {}
+
+  Status SetReferenceImage(const ImageBundle& ref, ThreadPool* pool = nullptr);
+
+  Status CompareWith(const ImageBundle& actual, ImageF* diffmap, float* score,
+                     ThreadPool* pool = nullptr);
+
+ private:
+  Comparator* comparator_black_;
+  Comparator* comparator_white_;
+  JxlCmsInterface cms_;
+  bool reference_set_ = false;
+  bool reference_has_alpha_ = false;
+};
+
 }  // namespace jxl
 
 #endif  // LIB_JXL_ENC_COMPARATOR_H_
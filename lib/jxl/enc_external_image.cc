@@ -256,4 +256,41 @@ Status BufferToImageBundle(const JxlPixelFormat& pixel_format, uint32_t xsize,
   return true;
 }
 
+Status BufferToSRGBImageBundle(const JxlPixelFormat& pixel_format,
+                               uint32_t xsize, uint32_t ysize,
+                               const void* buffer, size_t size,
+                               ThreadPool* pool, ImageMetadata* metadata,
+                               ImageBundle* ib) {
+  uint32_t alpha_bits = 0;
+  switch (pixel_format.data_type) {
+    case JXL_TYPE_FLOAT:
+      metadata->SetFloat32Samples();
+      alpha_bits = 16;
+      break;
+    case JXL_TYPE_FLOAT16:
+      metadata->SetFloat16Samples();
+      alpha_bits = 16;
+      break;
+    case JXL_TYPE_UINT16:
+      metadata->SetUintSamples(16);
+      alpha_bits = 16;
+      break;
+    case JXL_TYPE_UINT8:
+      metadata->SetUintSamples(8);
+      alpha_bits = 8;
+      break;
+    default:
+      return JXL_FAILURE("Unhandled JxlDataType");
+  }
+  if (pixel_format.num_channels == 2 || pixel_format.num_channels == 4) {
+    metadata->SetAlphaBits(alpha_bits);
+  }
+  const bool is_gray = pixel_format.num_channels < 3;
+  const ColorEncoding& c_current = pixel_format.data_type == JXL_TYPE_FLOAT
+                                       ? ColorEncoding::LinearSRGB(is_gray)
+                                       : ColorEncoding::SRGB(is_gray);
+  return BufferToImageBundle(pixel_format, xsize, ysize, buffer, size, pool,
+                             c_current, ib);
+}
+
 }  // namespace jxl
@@ -40,6 +40,15 @@ Status BufferToImageBundle(const JxlPixelFormat& pixel_format, uint32_t xsize,
                            jxl::ThreadPool* pool,
                            const jxl::ColorEncoding& c_current,
                            jxl::ImageBundle* ib);
+// Same as BufferToImageBundle for a buffer in linear sRGB if it has float
+// samples and in sRGB otherwise, as in the butteraugli and SSIMULACRA 2 APIs.
+// Also sets the sample type and alpha bits of `metadata`, which must be the
+// metadata of `ib`, from `pixel_format`.
+Status BufferToSRGBImageBundle(const JxlPixelFormat& pixel_format,
+                               uint32_t xsize, uint32_t ysize,
+                               const void* buffer, size_t size,
+                               ThreadPool* pool, ImageMetadata* metadata,
+                               ImageBundle* ib);
 
 }  // namespace jxl
 
@@ -764,27 +764,33 @@ class LossyFrameEncoder {
       enc_state_->coeffs[0]->ZeroFill();
     }
     // JPEG DC is from -1024 to 1023.
-    std::vector<size_t> dc_counts[3] = {};
-    dc_counts[0].resize(2048);
-    dc_counts[1].resize(2048);
-    dc_counts[2].resize(2048);
-    size_t total_dc[3] = {};
-    for (size_t c : {1, 0, 2}) {
-      if (jpeg_data.components.size() == 1 && c != 1) {
+    constexpr size_t kNumDCValues = 2048;
+    const bool is_gray = jpeg_data.components.size() == 1;
+    if (is_gray) {
+      for (size_t c : {0, 2}) {
         enc_state_->coeffs[0]->ZeroFillPlane(c);
         ZeroFillImage(&dc.Plane(c));
-        // Ensure no division by 0.
-        dc_counts[c][1024] = 1;
-        total_dc[c] = 1;
-        continue;
       }
-      size_t hshift = frame_header->chroma_subsampling.HShift(c);
-      size_t vshift = frame_header->chroma_subsampling.VShift(c);
-      ImageSB& map = (c == 0 ? shared.cmap.ytox_map : shared.cmap.ytob_map);
-      for (size_t group_index = 0; group_index < frame_dim.num_groups;
-           group_index++) {
-        const size_t gx = group_index % frame_dim.xsize_groups;
-        const size_t gy = group_index / frame_dim.xsize_groups;
+    }
+    // The groups are converted in parallel, each thread collects its own DC
+    // histograms, which are merged after all groups are done.
+    std::vector<std::vector<size_t>> thread_dc_counts;
+    const auto convert_group_init = [&](const size_t num_threads) {
+      thread_dc_counts.assign(num_threads,
+                              std::vector<size_t>(3 * kNumDCValues));
+      return true;
+    };
+    const auto convert_group = [&](const uint32_t group_index,
+                                   const size_t thread) {
+      const size_t gx = group_index % frame_dim.xsize_groups;
+      const size_t gy = group_index / frame_dim.xsize_groups;
+      for (size_t c : {1, 0, 2}) {
+        if (is_gray && c != 1) continue;
+        size_t* JXL_RESTRICT dc_counts =
+            &thread_dc_counts[thread][c * kNumDCValues];
+        size_t hshift = frame_header->chroma_subsampling.HShift(c);
+        size_t vshift = frame_header->chroma_subsampling.VShift(c);
+        ImageSB& map = (c == 0 ? shared.cmap.ytox_map : shared.cmap.ytob_map);
         size_t offset = 0;
         int32_t* JXL_RESTRICT ac =
             enc_state_->coeffs[0]->PlaneRow(c, group_index, 0).ptr32;
@@ -806,9 +812,8 @@ class LossyFrameEncoder {
             } else {
               idc = inputjpeg[base] + 1024 / qt[c * 64];
             }
-            dc_counts[c][std::min(static_cast<uint32_t>(idc + 1024),
-                                  uint32_t(2047))]++;
-            total_dc[c]++;
+            dc_counts[std::min(static_cast<uint32_t>(idc + 1024),
+                               uint32_t(kNumDCValues - 1))]++;
             fdc[bx >> hshift] = idc * dcquantization_r[c];
             if (c == 1 || !enc_state_->cparams.force_cfl_jpeg_recompression ||
                 !frame_header->chroma_subsampling.Is444()) {
@@ -842,6 +847,26 @@ class LossyFrameEncoder {
           }
         }
       }
+    };
+    JXL_RETURN_IF_ERROR(RunOnPool(pool_, 0, frame_dim.num_groups,
+                                  convert_group_init, convert_group,
+                                  "ConvertJPEGCoefficients"));
+    std::vector<size_t> dc_counts[3];
+    size_t total_dc[3] = {};
+    for (size_t c = 0; c < 3; c++) {
+      dc_counts[c].resize(kNumDCValues);
+      if (is_gray && c != 1) {
+        // Ensure no division by 0.
+        dc_counts[c][1024] = 1;
+        total_dc[c] = 1;
+        continue;
+      }
+      for (const auto& counts : thread_dc_counts) {
+        for (size_t j = 0; j < kNumDCValues; j++) {
+          dc_counts[c][j] += counts[c * kNumDCValues + j];
+          total_dc[c] += counts[c * kNumDCValues + j];
+        }
+      }
     }
 
     auto& dct = enc_state_->shared.block_ctx_map.dc_thresholds;
@@ -855,7 +880,7 @@ class LossyFrameEncoder {
       num_thresholds = std::min(std::max(num_thresholds, 0), 2);
       size_t cumsum = 0;
       size_t cut = total_dc[i] / (num_thresholds + 1);
-      for (int j = 0; j < 2048; j++) {
+      for (int j = 0; j < static_cast<int>(kNumDCValues); j++) {
         cumsum += dc_counts[i][j];
         if (cumsum > cut) {
           dct[i].push_back(j - 1025);
@@ -1003,7 +1028,8 @@ class LossyFrameEncoder {
           enc_state_->shared.num_histograms *
               enc_state_->shared.block_ctx_map.NumACContexts(),
           enc_state_->passes[i].ac_tokens, &enc_state_->passes[i].codes,
-          &enc_state_->passes[i].context_map, writer, kLayerAC, aux_out_);
+          &enc_state_->passes[i].context_map, writer, kLayerAC, aux_out_,
+          pool_);
     }
 
     return true;
@@ -1220,6 +1246,17 @@ Status EncodeFrame(const CompressParams& cparams_orig,
     }
     cparams.quant_ac_rescale = best_rescale;
   }
+  if (cparams.target_ssimulacra2 > 0.0f || cparams.target_butteraugli > 0.0f) {
+    if (frame_info.frame_type == FrameType::kRegularFrame && !ib.IsJPEG() &&
+        !cparams.IsLossless()) {
+      // The search in FindBestQuantizer starts at this distance, which also
+      // determines the frame parameters that depend on the distance.
+      cparams.butteraugli_distance = InitialDistanceForTargetQuality(cparams);
+    } else {
+      cparams.target_ssimulacra2 = 0.0f;
+      cparams.target_butteraugli = 0.0f;
+    }
+  }
   ib.VerifyMetadata();
 
   passes_enc_state->special_frames.clear();
@@ -1356,15 +1393,19 @@ Status EncodeFrame(const CompressParams& cparams_orig,
         Image3F(RoundUpToBlockDim(ib.xsize()), RoundUpToBlockDim(ib.ysize()));
     opsin.ShrinkTo(ib.xsize(), ib.ysize());
 
-    const bool want_linear = frame_header->encoding == FrameEncoding::kVarDCT &&
-                             cparams.speed_tier <= SpeedTier::kKitten;
+    const bool has_target_quality = cparams.target_ssimulacra2 > 0.0f ||
+                                    cparams.target_butteraugli > 0.0f;
+    const bool want_linear =
+        frame_header->encoding == FrameEncoding::kVarDCT &&
+        (cparams.speed_tier <= SpeedTier::kKitten || has_target_quality);
     const ImageBundle* JXL_RESTRICT ib_or_linear = &ib;
 
     if (frame_header->color_transform == ColorTransform::kXYB &&
         frame_info.ib_needs_color_transform) {
-      // linear_storage would only be used by the Butteraugli loop (passing
-      // linear sRGB avoids a color conversion there). Otherwise, don't
-      // fill it to reduce memory usage.
+      // linear_storage would only be used by the Butteraugli loop and the
+      // target quality search (passing linear sRGB avoids a color conversion
+      // there, and its invisible pixels are simplified as in opsin).
+      // Otherwise, don't fill it to reduce memory usage.
       ib_or_linear =
           ToXYB(ib, pool, &opsin, cms, want_linear ? &linear_storage : nullptr);
     } else {  // RGB or YCbCr: don't do anything (forward YCbCr is not
@@ -1480,7 +1521,7 @@ Status EncodeFrame(const CompressParams& cparams_orig,
         lossy_frame_encoder.EncodeGlobalDCInfo(*frame_header, get_output(0)));
   }
   JXL_RETURN_IF_ERROR(
-      modular_frame_encoder->EncodeGlobalInfo(get_output(0), aux_out));
+      modular_frame_encoder->EncodeGlobalInfo(get_output(0), aux_out, pool));
   JXL_RETURN_IF_ERROR(modular_frame_encoder->EncodeStream(
       get_output(0), aux_out, kLayerModularGlobal, ModularStreamId::Global()));
 
@@ -998,71 +998,78 @@ Status ModularFrameEncoder::PrepareEncoding(const FrameHeader& frame_header,
 
     std::atomic_flag invalid_force_wp = ATOMIC_FLAG_INIT;
 
-    std::vector<Tree> trees(useful_splits.size() - 1);
-    JXL_RETURN_IF_ERROR(RunOnPool(
-        pool, 0, useful_splits.size() - 1, ThreadPool::NoInit,
-        [&](const uint32_t chunk, size_t /* thread */) {
-          // TODO(veluca): parallelize more.
-          size_t total_pixels = 0;
-          uint32_t start = useful_splits[chunk];
-          uint32_t stop = useful_splits[chunk + 1];
-          while (start < stop && stream_images_[start].empty()) ++start;
-          while (start < stop && stream_images_[stop - 1].empty()) --stop;
-          uint32_t max_c = 0;
-          if (stream_options_[start].tree_kind !=
-              ModularOptions::TreeKind::kLearn) {
-            for (size_t i = start; i < stop; i++) {
-              for (const Channel& ch : stream_images_[i].channel) {
-                total_pixels += ch.w * ch.h;
-              }
-            }
-            trees[chunk] =
-                PredefinedTree(stream_options_[start].tree_kind, total_pixels);
-            return;
-          }
-          TreeSamples tree_samples;
-          if (!tree_samples.SetPredictor(stream_options_[start].predictor,
-                                         stream_options_[start].wp_tree_mode)) {
-            invalid_force_wp.test_and_set(std::memory_order_acq_rel);
-            return;
-          }
-          if (!tree_samples.SetProperties(
-                  stream_options_[start].splitting_heuristics_properties,
-                  stream_options_[start].wp_tree_mode)) {
-            invalid_force_wp.test_and_set(std::memory_order_acq_rel);
-            return;
-          }
-          std::vector<pixel_type> pixel_samples;
-          std::vector<pixel_type> diff_samples;
-          std::vector<uint32_t> group_pixel_count;
-          std::vector<uint32_t> channel_pixel_count;
-          for (size_t i = start; i < stop; i++) {
-            max_c = std::max<uint32_t>(stream_images_[i].channel.size(), max_c);
-            CollectPixelSamples(stream_images_[i], stream_options_[i], i,
-                                group_pixel_count, channel_pixel_count,
-                                pixel_samples, diff_samples);
-          }
-          StaticPropRange range;
-          range[0] = {{0, max_c}};
-          range[1] = {{start, stop}};
-          auto local_multiplier_info = multiplier_info_;
-
-          tree_samples.PreQuantizeProperties(
-              range, local_multiplier_info, group_pixel_count,
-              channel_pixel_count, pixel_samples, diff_samples,
-              stream_options_[start].max_property_values);
-          for (size_t i = start; i < stop; i++) {
-            JXL_CHECK(ModularGenericCompress(
-                stream_images_[i], stream_options_[i], /*writer=*/nullptr,
-                /*aux_out=*/nullptr, 0, i, &tree_samples, &total_pixels));
+    const size_t num_trees = useful_splits.size() - 1;
+    std::vector<Tree> trees(num_trees);
+    const auto learn_tree = [&](const uint32_t chunk, size_t /* thread */) {
+      // TODO(veluca): parallelize more.
+      size_t total_pixels = 0;
+      uint32_t start = useful_splits[chunk];
+      uint32_t stop = useful_splits[chunk + 1];
+      while (start < stop && stream_images_[start].empty()) ++start;
+      while (start < stop && stream_images_[stop - 1].empty()) --stop;
+      uint32_t max_c = 0;
+      if (stream_options_[start].tree_kind !=
+          ModularOptions::TreeKind::kLearn) {
+        for (size_t i = start; i < stop; i++) {
+          for (const Channel& ch : stream_images_[i].channel) {
+            total_pixels += ch.w * ch.h;
           }
+        }
+        trees[chunk] =
+            PredefinedTree(stream_options_[start].tree_kind, total_pixels);
+        return;
+      }
+      TreeSamples tree_samples;
+      if (!tree_samples.SetPredictor(stream_options_[start].predictor,
+                                     stream_options_[start].wp_tree_mode)) {
+        invalid_force_wp.test_and_set(std::memory_order_acq_rel);
+        return;
+      }
+      if (!tree_samples.SetProperties(
+              stream_options_[start].splitting_heuristics_properties,
+              stream_options_[start].wp_tree_mode)) {
+        invalid_force_wp.test_and_set(std::memory_order_acq_rel);
+        return;
+      }
+      std::vector<pixel_type> pixel_samples;
+      std::vector<pixel_type> diff_samples;
+      std::vector<uint32_t> group_pixel_count;
+      std::vector<uint32_t> channel_pixel_count;
+      for (size_t i = start; i < stop; i++) {
+        max_c = std::max<uint32_t>(stream_images_[i].channel.size(), max_c);
+        CollectPixelSamples(stream_images_[i], stream_options_[i], i,
+                            group_pixel_count, channel_pixel_count,
+                            pixel_samples, diff_samples);
+      }
+      StaticPropRange range;
+      range[0] = {{0, max_c}};
+      range[1] = {{start, stop}};
+      auto local_multiplier_info = multiplier_info_;
+
+      tree_samples.PreQuantizeProperties(
+          range, local_multiplier_info, group_pixel_count,
+          channel_pixel_count, pixel_samples, diff_samples,
+          stream_options_[start].max_property_values);
+      for (size_t i = start; i < stop; i++) {
+        JXL_CHECK(ModularGenericCompress(
+            stream_images_[i], stream_options_[i], /*writer=*/nullptr,
+            /*aux_out=*/nullptr, 0, i, &tree_samples, &total_pixels));
+      }
 
-          // TODO(veluca): parallelize more.
-          trees[chunk] =
-              LearnTree(std::move(tree_samples), total_pixels,
-                        stream_options_[start], local_multiplier_info, range);
-        },
-        "LearnTrees"));
+      // The thread pool is only free for learning the tree if this is the
+      // only one, see below.
+      trees[chunk] = LearnTree(std::move(tree_samples), total_pixels,
+                               stream_options_[start], local_multiplier_info,
+                               range, num_trees == 1 ? pool : nullptr);
+    };
+    if (num_trees == 1) {
+      // A single tree is learned on the calling thread, so that the thread
+      // pool can be used by the tree learning itself.
+      learn_tree(0, 0);
+    } else {
+      JXL_RETURN_IF_ERROR(RunOnPool(pool, 0, num_trees, ThreadPool::NoInit,
+                                    learn_tree, "LearnTrees"));
+    }
     if (invalid_force_wp.test_and_set(std::memory_order_acq_rel)) {
       return JXL_FAILURE("PrepareEncoding: force_no_wp with {Weighted}");
     }
@@ -1103,30 +1110,43 @@ Status ModularFrameEncoder::PrepareEncoding(const FrameHeader& frame_header,
   }
 
   image_widths_.resize(num_streams);
+  // With bounded token memory, the tokens are computed while building the
+  // histograms and again while writing each stream.
+  if (cparams_.bounded_token_memory) return true;
   JXL_RETURN_IF_ERROR(RunOnPool(
       pool, 0, num_streams, ThreadPool::NoInit,
       [&](const uint32_t stream_id, size_t /* thread */) {
-        AuxOut my_aux_out;
-        if (aux_out) {
-          my_aux_out.dump_image = aux_out->dump_image;
-          my_aux_out.debug_prefix = aux_out->debug_prefix;
-        }
         tokens_[stream_id].clear();
-        JXL_CHECK(ModularGenericCompress(
-            stream_images_[stream_id], stream_options_[stream_id],
-            /*writer=*/nullptr, &my_aux_out, 0, stream_id,
-            /*tree_samples=*/nullptr,
-            /*total_pixels=*/nullptr,
-            /*tree=*/&tree_, /*header=*/&stream_headers_[stream_id],
-            /*tokens=*/&tokens_[stream_id],
-            /*widths=*/&image_widths_[stream_id]));
+        JXL_CHECK(ComputeStreamTokens(stream_id, aux_out,
+                                      &stream_headers_[stream_id],
+                                      &tokens_[stream_id],
+                                      &image_widths_[stream_id]));
       },
       "ComputeTokens"));
   return true;
 }
 
+Status ModularFrameEncoder::ComputeStreamTokens(size_t stream_id,
+                                                AuxOut* aux_out,
+                                                GroupHeader* header,
+                                                std::vector<Token>* tokens,
+                                                size_t* width) {
+  AuxOut my_aux_out;
+  if (aux_out) {
+    my_aux_out.dump_image = aux_out->dump_image;
+    my_aux_out.debug_prefix = aux_out->debug_prefix;
+  }
+  return ModularGenericCompress(
+      stream_images_[stream_id], stream_options_[stream_id],
+      /*writer=*/nullptr, &my_aux_out, 0, stream_id,
+      /*tree_samples=*/nullptr,
+      /*total_pixels=*/nullptr,
+      /*tree=*/&tree_, header, tokens, width);
+}
+
 Status ModularFrameEncoder::EncodeGlobalInfo(BitWriter* writer,
-                                             AuxOut* aux_out) {
+                                             AuxOut* aux_out,
+                                             ThreadPool* pool) {
   BitWriter::Allotment allotment(writer, 1);
   // If we are using brotli, or not using modular mode.
   if (tree_tokens_.empty() || tree_tokens_[0].empty()) {
@@ -1145,12 +1165,23 @@ Status ModularFrameEncoder::EncodeGlobalInfo(BitWriter* writer,
         cparams_.speed_tier > SpeedTier::kThunder
             ? HistogramParams::ANSHistogramStrategy::kFast
             : HistogramParams::ANSHistogramStrategy::kApproximate;
-    params.lz77_method =
-        cparams_.decoding_speed_tier >= 3 && cparams_.modular_mode
-            ? (cparams_.speed_tier >= SpeedTier::kFalcon
-                   ? HistogramParams::LZ77Method::kRLE
-                   : HistogramParams::LZ77Method::kLZ77)
-            : HistogramParams::LZ77Method::kNone;
+    if (cparams_.decoding_speed_tier >= 3 && cparams_.modular_mode) {
+      params.lz77_method = cparams_.speed_tier >= SpeedTier::kFalcon
+                               ? HistogramParams::LZ77Method::kRLE
+                               : HistogramParams::LZ77Method::kLZ77;
+    } else if (cparams_.modular_fast_lz77 && cparams_.modular_mode &&
+               cparams_.decoding_speed_tier == 0 &&
+               cparams_.speed_tier >= SpeedTier::kSquirrel &&
+               cparams_.speed_tier <= SpeedTier::kWombat) {
+      // With short hash chains, LZ77 may be cheap enough to try at efforts 6
+      // and 7; it mostly helps synthetic images and screenshots. Higher
+      // efforts and faster decoding settings keep their LZ77 method and the
+      // default chain length.
+      params.lz77_method = HistogramParams::LZ77Method::kLZ77;
+      params.lz77_max_chain_length = 32;
+    } else {
+      params.lz77_method = HistogramParams::LZ77Method::kNone;
+    }
     // Near-lossless DC, as well as modular mode, require choosing hybrid uint
     // more carefully.
     if ((!extra_dc_precision.empty() && extra_dc_precision[0] != 0) ||
@@ -1182,10 +1213,28 @@ Status ModularFrameEncoder::EncodeGlobalInfo(BitWriter* writer,
                            &context_map_, writer, kLayerModularTree, aux_out);
   WriteTokens(tree_tokens_[0], code_, context_map_, writer, kLayerModularTree,
               aux_out);
+  if (cparams_.bounded_token_memory) {
+    params.lz77_method = HistogramParams::LZ77Method::kNone;
+    if (params.uint_method == HistogramParams::HybridUintMethod::kFast ||
+        params.uint_method == HistogramParams::HybridUintMethod::kBest) {
+      params.uint_method = HistogramParams::HybridUintMethod::kNone;
+    }
+    // Write histograms of the tokens computed one stream at a time.
+    BuildAndEncodeHistograms(
+        params, (tree_.size() + 1) / 2, stream_images_.size(),
+        [&](size_t stream_id, std::vector<Token>* tokens) {
+          JXL_CHECK(ComputeStreamTokens(stream_id, aux_out,
+                                        &stream_headers_[stream_id], tokens,
+                                        &image_widths_[stream_id]));
+        },
+        &code_, &context_map_, writer, kLayerModularGlobal, aux_out, pool);
+    return true;
+  }
   params.image_widths = image_widths_;
   // Write histograms.
   BuildAndEncodeHistograms(params, (tree_.size() + 1) / 2, tokens_, &code_,
-                           &context_map_, writer, kLayerModularGlobal, aux_out);
+                           &context_map_, writer, kLayerModularGlobal, aux_out,
+                           pool);
   return true;
 }
 
@@ -1196,6 +1245,16 @@ Status ModularFrameEncoder::EncodeStream(BitWriter* writer, AuxOut* aux_out,
   if (stream_images_[stream_id].channel.empty()) {
     return true;  // Image with no channels, header never gets decoded.
   }
+  if (cparams_.bounded_token_memory) {
+    GroupHeader header;
+    std::vector<Token> tokens;
+    size_t width;
+    JXL_RETURN_IF_ERROR(
+        ComputeStreamTokens(stream_id, aux_out, &header, &tokens, &width));
+    JXL_RETURN_IF_ERROR(Bundle::Write(header, writer, layer, aux_out));
+    WriteTokens(tokens, code_, context_map_, writer, layer, aux_out);
+    return true;
+  }
   JXL_RETURN_IF_ERROR(
       Bundle::Write(stream_headers_[stream_id], writer, layer, aux_out));
   WriteTokens(tokens_[stream_id], code_, context_map_, writer, layer, aux_out);
@@ -33,7 +33,8 @@ class ModularFrameEncoder {
                              const JxlCmsInterface& cms, ThreadPool* pool,
                              AuxOut* aux_out, bool do_color);
   // Encodes global info (tree + histograms) in the `writer`.
-  Status EncodeGlobalInfo(BitWriter* writer, AuxOut* aux_out);
+  Status EncodeGlobalInfo(BitWriter* writer, AuxOut* aux_out,
+                          ThreadPool* pool = nullptr);
   // Encodes a specific modular image (identified by `stream`) in the `writer`,
   // assigning bits to the provided `layer`.
   Status EncodeStream(BitWriter* writer, AuxOut* aux_out, size_t layer,
@@ -66,6 +67,10 @@ class ModularFrameEncoder {
   Status PrepareEncoding(const FrameHeader& frame_header, ThreadPool* pool,
                          EncoderHeuristics* heuristics,
                          AuxOut* aux_out = nullptr);
+  // Computes the header and the tokens of the stream with the global tree.
+  Status ComputeStreamTokens(size_t stream_id, AuxOut* aux_out,
+                             GroupHeader* header, std::vector<Token>* tokens,
+                             size_t* width);
   Status PrepareStreamParams(const Rect& rect, const CompressParams& cparams,
                              int minShift, int maxShift,
                              const ModularStreamId& stream, bool do_color);
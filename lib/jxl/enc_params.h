@@ -57,6 +57,15 @@ struct CompressParams {
   size_t target_size = 0;
   float target_bitrate = 0.0f;
 
+  // If positive, VarDCT frames are quantized to reach this SSIMULACRA 2 score,
+  // or this butteraugli max-norm distance, as measured on the decoded frame,
+  // instead of using butteraugli_distance. The SSIMULACRA 2 target wins if
+  // both are set. The search evaluates at most max_target_quality_iters
+  // quantization scales.
+  float target_ssimulacra2 = 0.0f;
+  float target_butteraugli = 0.0f;
+  int max_target_quality_iters = 6;
+
   // 0.0 means search for the adaptive quantization map that matches the
   // butteraugli distance, positive values mean quantize everywhere with that
   // value.
@@ -148,6 +157,16 @@ struct CompressParams {
   float channel_colors_percent = 80.f;
   int palette_colors = 1 << 10;  // up to 10-bit palette is probably worthwhile
   bool lossy_palette = false;
+  // If true, the tokens of the modular streams are not kept in memory between
+  // building the histograms and writing the groups, but computed again for
+  // each group. This bounds the token memory to one group per thread, at the
+  // cost of tokenizing twice and of not using LZ77 nor a searched hybrid uint
+  // configuration for the modular streams.
+  bool bounded_token_memory = false;
+  // If true, modular streams at efforts 6 and 7 try LZ77 with short hash
+  // chains instead of not using LZ77. Off until its size and speed effect is
+  // measured.
+  bool modular_fast_lz77 = false;
 
   // Returns whether these params are lossless as defined by SetLossless();
   bool IsLossless() const {
@@ -196,6 +215,8 @@ static constexpr float kMinButteraugliForNoise = 99.0f;
 
 // Minimum butteraugli distance the encoder accepts.
 static constexpr float kMinButteraugliDistance = 0.001f;
+// Maximum butteraugli distance the encoder API accepts.
+static constexpr float kMaxButteraugliDistance = 25.0f;
 
 // Tile size for encoder-side processing. Must be equal to color tile dim in the
 // current implementation.
@@ -0,0 +1,599 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+/*
+SSIMULACRA 2
+Structural SIMilarity Unveiling Local And Compression Related Artifacts
+
+Perceptual metric developed by Jon Sneyers (Cloudinary) in July 2022.
+Design:
+- XYB color space (X+0.5, Y, Y-B+1.0)
+- SSIM map (with correction: no double gamma correction)
+- 'blockiness/ringing' map (distorted has edges where original is smooth)
+- 'smoothing' map (distorted is smooth where original has edges)
+- error maps are computed at 6 scales (1:1 to 1:32) for each component (X,Y,B)
+- downscaling is done in linear RGB
+- for all 6*3*3=54 maps, two norms are computed: 1-norm (mean) and 4-norm
+- a weighted sum of these 54*2=108 norms leads to the final score
+- weights were tuned based on a large set of subjective scores for images
+  compressed with JPEG, JPEG 2000, JPEG XL, WebP, AVIF, and HEIC.
+*/
+
+#include "lib/jxl/enc_ssimulacra2.h"
+
+#include <algorithm>
+#include <cmath>
+
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "lib/jxl/enc_ssimulacra2.cc"
+#include <hwy/foreach_target.h>
+#include <hwy/highway.h>
+
+#include "lib/jxl/base/profiler.h"
+#include "lib/jxl/enc_color_management.h"
+#include "lib/jxl/enc_xyb.h"
+#include "lib/jxl/gauss_blur.h"
+#include "lib/jxl/image_ops.h"
+HWY_BEFORE_NAMESPACE();
+namespace jxl {
+namespace HWY_NAMESPACE {
+
+// These templates are not found via ADL.
+using hwy::HWY_NAMESPACE::Abs;
+using hwy::HWY_NAMESPACE::Add;
+using hwy::HWY_NAMESPACE::Div;
+using hwy::HWY_NAMESPACE::GetLane;
+using hwy::HWY_NAMESPACE::Max;
+using hwy::HWY_NAMESPACE::Mul;
+using hwy::HWY_NAMESPACE::MulAdd;
+using hwy::HWY_NAMESPACE::Neg;
+using hwy::HWY_NAMESPACE::Sub;
+
+static const float kC2 = 0.0009f;
+
+double tothe4th(double x) {
+  x *= x;
+  x *= x;
+  return x;
+}
+
+// Averages 2x2 blocks of linear RGB, replicating the last row and column of
+// images with odd sizes.
+Image3F Downsample2x(const Image3F& in, ThreadPool* pool) {
+  const size_t out_xsize = (in.xsize() + 1) / 2;
+  const size_t out_ysize = (in.ysize() + 1) / 2;
+  Image3F out(out_xsize, out_ysize);
+  // Quarter of the sums of the two input rows of each output row.
+  Image3F vsum(in.xsize(), out_ysize);
+  JXL_CHECK(RunOnPool(
+      pool, 0, out_ysize, ThreadPool::NoInit,
+      [&](const uint32_t oy, size_t /*thread*/) {
+        const HWY_FULL(float) d;
+        const auto normalize = Set(d, 0.25f);
+        const size_t y0 = 2 * oy;
+        const size_t y1 = std::min<size_t>(y0 + 1, in.ysize() - 1);
+        for (size_t c = 0; c < 3; ++c) {
+          const float* JXL_RESTRICT row0 = in.ConstPlaneRow(c, y0);
+          const float* JXL_RESTRICT row1 = in.ConstPlaneRow(c, y1);
+          float* JXL_RESTRICT row_sum = vsum.PlaneRow(c, oy);
+          for (size_t x = 0; x < in.xsize(); x += Lanes(d)) {
+            const auto sum = Add(Load(d, row0 + x), Load(d, row1 + x));
+            Store(Mul(sum, normalize), d, row_sum + x);
+          }
+          float* JXL_RESTRICT row_out = out.PlaneRow(c, oy);
+          for (size_t ox = 0; ox < out_xsize; ++ox) {
+            const size_t x0 = 2 * ox;
+            const size_t x1 = std::min<size_t>(x0 + 1, in.xsize() - 1);
+            row_out[ox] = row_sum[x0] + row_sum[x1];
+          }
+        }
+      },
+      "SSIMULACRA2Downsample"));
+  return out;
+}
+
+// Add 0.5 to X and turn B into 1 + B-Y
+// (SSIM expects non-negative ranges)
+void MakePositiveXYB(Image3F* img) {
+  const HWY_FULL(float) d;
+  const auto offset_x = Set(d, 0.5f);
+  const auto offset_y = Set(d, 0.05f);
+  const auto offset_b = Set(d, 1.1f);
+  for (size_t y = 0; y < img->ysize(); ++y) {
+    float* JXL_RESTRICT rowY = img->PlaneRow(1, y);
+    float* JXL_RESTRICT rowB = img->PlaneRow(2, y);
+    float* JXL_RESTRICT rowX = img->PlaneRow(0, y);
+    for (size_t x = 0; x < img->xsize(); x += Lanes(d)) {
+      const auto vy = Load(d, rowY + x);
+      Store(Add(Load(d, rowB + x), Sub(offset_b, vy)), d, rowB + x);
+      Store(Add(Load(d, rowX + x), offset_x), d, rowX + x);
+      Store(Add(vy, offset_y), d, rowY + x);
+    }
+  }
+}
+
+void Multiply(const ImageF& a, const ImageF& b, ImageF* mul) {
+  const HWY_FULL(float) d;
+  for (size_t y = 0; y < a.ysize(); ++y) {
+    const float* JXL_RESTRICT in1 = a.ConstRow(y);
+    const float* JXL_RESTRICT in2 = b.ConstRow(y);
+    float* JXL_RESTRICT out = mul->Row(y);
+    for (size_t x = 0; x < a.xsize(); x += Lanes(d)) {
+      Store(Mul(Load(d, in1 + x), Load(d, in2 + x)), d, out + x);
+    }
+  }
+}
+
+// The sums over rows are accumulated in vectors of floats, the sums over
+// the image in doubles. Pixels beyond the last full vector are handled one by
+// one, because the padding of the rows is not initialized.
+void SSIMMap(const ImageF& m1, const ImageF& m2, const ImageF& s11,
+             const ImageF& s22, const ImageF& s12, double* plane_averages) {
+  const HWY_FULL(float) d;
+  const size_t xsize = m1.xsize();
+  const double onePerPixels = 1.0 / (m1.ysize() * xsize);
+  const auto one = Set(d, 1.0f);
+  const auto two = Set(d, 2.0f);
+  const auto c2 = Set(d, kC2);
+  double sum1[2] = {0.0};
+  for (size_t y = 0; y < m1.ysize(); ++y) {
+    const float* JXL_RESTRICT row_m1 = m1.ConstRow(y);
+    const float* JXL_RESTRICT row_m2 = m2.ConstRow(y);
+    const float* JXL_RESTRICT row_s11 = s11.ConstRow(y);
+    const float* JXL_RESTRICT row_s22 = s22.ConstRow(y);
+    const float* JXL_RESTRICT row_s12 = s12.ConstRow(y);
+    auto sum_d = Zero(d);
+    auto sum_d4 = Zero(d);
+    size_t x = 0;
+    for (; x + Lanes(d) <= xsize; x += Lanes(d)) {
+      const auto mu1 = Load(d, row_m1 + x);
+      const auto mu2 = Load(d, row_m2 + x);
+      const auto mu11 = Mul(mu1, mu1);
+      const auto mu22 = Mul(mu2, mu2);
+      const auto mu12 = Mul(mu1, mu2);
+      const auto mu_diff = Sub(mu1, mu2);
+      const auto num_m = Sub(one, Mul(mu_diff, mu_diff));
+      const auto num_s = MulAdd(two, Sub(Load(d, row_s12 + x), mu12), c2);
+      const auto denom_s =
+          Add(Add(Sub(Load(d, row_s11 + x), mu11),
+                  Sub(Load(d, row_s22 + x), mu22)),
+              c2);
+      const auto dv =
+          Max(Sub(one, Div(Mul(num_m, num_s), denom_s)), Zero(d));
+      sum_d = Add(sum_d, dv);
+      const auto dv2 = Mul(dv, dv);
+      sum_d4 = MulAdd(dv2, dv2, sum_d4);
+    }
+    sum1[0] += GetLane(SumOfLanes(d, sum_d));
+    sum1[1] += GetLane(SumOfLanes(d, sum_d4));
+    for (; x < xsize; ++x) {
+      float mu1 = row_m1[x];
+      float mu2 = row_m2[x];
+      float mu11 = mu1 * mu1;
+      float mu22 = mu2 * mu2;
+      float mu12 = mu1 * mu2;
+      float num_m = 1.0 - (mu1 - mu2) * (mu1 - mu2);
+      float num_s = 2 * (row_s12[x] - mu12) + kC2;
+      float denom_s = (row_s11[x] - mu11) + (row_s22[x] - mu22) + kC2;
+      double ssim_d = 1.0 - ((num_m * num_s) / (denom_s));
+      ssim_d = std::max(ssim_d, 0.0);
+      sum1[0] += ssim_d;
+      sum1[1] += tothe4th(ssim_d);
+    }
+  }
+  plane_averages[0] = onePerPixels * sum1[0];
+  plane_averages[1] = sqrt(sqrt(onePerPixels * sum1[1]));
+}
+
+void EdgeDiffMap(const ImageF& img1, const ImageF& mu1, const ImageF& img2,
+                 const ImageF& mu2, double* plane_averages) {
+  const HWY_FULL(float) d;
+  const size_t xsize = img1.xsize();
+  const double onePerPixels = 1.0 / (img1.ysize() * xsize);
+  const auto one = Set(d, 1.0f);
+  double sum1[4] = {0.0};
+  for (size_t y = 0; y < img1.ysize(); ++y) {
+    const float* JXL_RESTRICT row1 = img1.ConstRow(y);
+    const float* JXL_RESTRICT row2 = img2.ConstRow(y);
+    const float* JXL_RESTRICT rowm1 = mu1.ConstRow(y);
+    const float* JXL_RESTRICT rowm2 = mu2.ConstRow(y);
+    auto sum_artifact = Zero(d);
+    auto sum_artifact4 = Zero(d);
+    auto sum_detail_lost = Zero(d);
+    auto sum_detail_lost4 = Zero(d);
+    size_t x = 0;
+    for (; x + Lanes(d) <= xsize; x += Lanes(d)) {
+      const auto edge1 =
+          Add(one, Abs(Sub(Load(d, row1 + x), Load(d, rowm1 + x))));
+      const auto edge2 =
+          Add(one, Abs(Sub(Load(d, row2 + x), Load(d, rowm2 + x))));
+      const auto d1 = Sub(Div(edge2, edge1), one);
+      const auto artifact = Max(d1, Zero(d));
+      sum_artifact = Add(sum_artifact, artifact);
+      const auto artifact2 = Mul(artifact, artifact);
+      sum_artifact4 = MulAdd(artifact2, artifact2, sum_artifact4);
+      const auto detail_lost = Max(Neg(d1), Zero(d));
+      sum_detail_lost = Add(sum_detail_lost, detail_lost);
+      const auto detail_lost2 = Mul(detail_lost, detail_lost);
+      sum_detail_lost4 = MulAdd(detail_lost2, detail_lost2, sum_detail_lost4);
+    }
+    sum1[0] += GetLane(SumOfLanes(d, sum_artifact));
+    sum1[1] += GetLane(SumOfLanes(d, sum_artifact4));
+    sum1[2] += GetLane(SumOfLanes(d, sum_detail_lost));
+    sum1[3] += GetLane(SumOfLanes(d, sum_detail_lost4));
+    for (; x < xsize; ++x) {
+      double d1 = (1.0 + std::abs(row2[x] - rowm2[x])) /
+                      (1.0 + std::abs(row1[x] - rowm1[x])) -
+                  1.0;
+      // d1 > 0: distorted has an edge where original is smooth
+      //         (indicating ringing, color banding, blockiness, etc)
+      // d1 < 0: original has an edge where distorted is smooth
+      //         (indicating smoothing, blurring, smearing, etc)
+      double artifact = std::max(d1, 0.0);
+      sum1[0] += artifact;
+      sum1[1] += tothe4th(artifact);
+      double detail_lost = std::max(-d1, 0.0);
+      sum1[2] += detail_lost;
+      sum1[3] += tothe4th(detail_lost);
+    }
+  }
+  plane_averages[0] = onePerPixels * sum1[0];
+  plane_averages[1] = sqrt(sqrt(onePerPixels * sum1[1]));
+  plane_averages[2] = onePerPixels * sum1[2];
+  plane_averages[3] = sqrt(sqrt(onePerPixels * sum1[3]));
+}
+
+// Computes the blurs of one channel of the reference image at one scale,
+// which do not depend on the distorted image.
+void ReferenceBlurs(const ImageF& img1,
+                    const hwy::AlignedUniquePtr<RecursiveGaussian>& rg,
+                    ImageF* mu1, ImageF* sigma1_sq) {
+  ThreadPool* null_pool = nullptr;
+  ImageF temp(img1.xsize(), img1.ysize());
+  ImageF mul(img1.xsize(), img1.ysize());
+  Multiply(img1, img1, &mul);
+  FastGaussian(rg, mul, null_pool, &temp, sigma1_sq);
+  FastGaussian(rg, img1, null_pool, &temp, mu1);
+}
+
+// Computes the SSIM and edge difference norms of one channel at one scale.
+void ChannelScores(const ImageF& img1, const ImageF& mu1,
+                   const ImageF& sigma1_sq, const ImageF& img2,
+                   const hwy::AlignedUniquePtr<RecursiveGaussian>& rg,
+                   double* avg_ssim, double* avg_edgediff) {
+  const size_t xsize = img1.xsize();
+  const size_t ysize = img1.ysize();
+  ThreadPool* null_pool = nullptr;
+  ImageF temp(xsize, ysize);
+  ImageF mul(xsize, ysize);
+
+  ImageF sigma2_sq(xsize, ysize);
+  Multiply(img2, img2, &mul);
+  FastGaussian(rg, mul, null_pool, &temp, &sigma2_sq);
+
+  ImageF sigma12(xsize, ysize);
+  Multiply(img1, img2, &mul);
+  FastGaussian(rg, mul, null_pool, &temp, &sigma12);
+
+  ImageF mu2(xsize, ysize);
+  FastGaussian(rg, img2, null_pool, &temp, &mu2);
+
+  SSIMMap(mu1, mu2, sigma1_sq, sigma2_sq, sigma12, avg_ssim);
+  EdgeDiffMap(img1, mu1, img2, mu2, avg_edgediff);
+}
+
+// NOLINTNEXTLINE(google-readability-namespace-comments)
+}  // namespace HWY_NAMESPACE
+}  // namespace jxl
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE
+namespace jxl {
+
+HWY_EXPORT(Downsample2x);
+HWY_EXPORT(MakePositiveXYB);
+HWY_EXPORT(ReferenceBlurs);
+HWY_EXPORT(ChannelScores);
+
+namespace {
+
+static const int kNumScales = 6;
+
+void AlphaBlend(ImageBundle& img, float bg) {
+  for (size_t y = 0; y < img.ysize(); ++y) {
+    float* JXL_RESTRICT r = img.color()->PlaneRow(0, y);
+    float* JXL_RESTRICT g = img.color()->PlaneRow(1, y);
+    float* JXL_RESTRICT b = img.color()->PlaneRow(2, y);
+    const float* JXL_RESTRICT a = img.alpha()->Row(y);
+    for (size_t x = 0; x < img.xsize(); ++x) {
+      r[x] = a[x] * r[x] + (1.f - a[x]) * bg;
+      g[x] = a[x] * g[x] + (1.f - a[x]) * bg;
+      b[x] = a[x] * b[x] + (1.f - a[x]) * bg;
+    }
+  }
+}
+
+// Returns the XYB images, made positive, of all scales of 'in'.
+std::vector<Image3F> XybPyramid(const ImageBundle& in,
+                                const JxlCmsInterface& cms, ThreadPool* pool) {
+  ImageBundle img = in.Copy();
+  JXL_CHECK(
+      img.TransformTo(ColorEncoding::LinearSRGB(img.IsGray()), cms, pool));
+  std::vector<Image3F> pyramid;
+  for (int scale = 0; scale < kNumScales; scale++) {
+    if (img.xsize() < 8 || img.ysize() < 8) {
+      break;
+    }
+    if (scale) {
+      img.SetFromImage(HWY_DYNAMIC_DISPATCH(Downsample2x)(*img.color(), pool),
+                       ColorEncoding::LinearSRGB(img.IsGray()));
+    }
+    pyramid.emplace_back(img.xsize(), img.ysize());
+    ToXYB(img, pool, &pyramid.back(), cms, nullptr);
+    HWY_DYNAMIC_DISPATCH(MakePositiveXYB)(&pyramid.back());
+  }
+  return pyramid;
+}
+
+}  // namespace
+
+/*
+The final score is based on a weighted sum of 108 sub-scores:
+- for 6 scales (1:1 to 1:32)
+- for 3 components (X + 0.5, Y, B - Y + 1.0)
+- using 2 norms (the 1-norm and the 4-norm)
+- over 3 error maps:
+    - SSIM
+    - "ringing" (distorted edges where there are no orig edges)
+    - "blurring" (orig edges where there are no distorted edges)
+
+The weights were obtained by running Nelder-Mead simplex search,
+optimizing to minimize MSE and maximize Kendall and Pearson correlation
+for training data consisting of 17611 subjective quality scores,
+validated on separate validation data consisting of 4292 scores.
+*/
+double Msssim::Score() const {
+  double ssim = 0.0;
+  constexpr double weight[108] = {0.0,
+                                  0.0,
+                                  0.0,
+                                  1.0035479352512353,
+                                  0.00011322061110474735,
+                                  0.00040442991823685936,
+                                  0.0018953834105783773,
+                                  0.0,
+                                  0.0,
+                                  8.982542997575905,
+                                  0.9899785796045556,
+                                  0.0,
+                                  0.9748315131207942,
+                                  0.9581575169937973,
+                                  0.0,
+                                  0.5133611777952946,
+                                  1.0423189317331243,
+                                  0.000308010928520841,
+                                  12.149584966240063,
+                                  0.9565577248115467,
+                                  0.0,
+                                  1.0406668123136824,
+                                  81.51139046057362,
+                                  0.30593391895330946,
+                                  1.0752214433626779,
+                                  1.1039042369464611,
+                                  0.0,
+                                  1.021911638819618,
+                                  1.1141823296855722,
+                                  0.9730845751441705,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.9833918426095505,
+                                  0.7920385137059867,
+                                  0.9710740411514053,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.5387077903152638,
+                                  0.0,
+                                  3.4036945601155804,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  2.337569295661117,
+                                  0.0,
+                                  5.707946510901609,
+                                  37.83086423878157,
+                                  0.0,
+                                  0.0,
+                                  3.8258200594305185,
+                                  0.0,
+                                  0.0,
+                                  24.073659674271497,
+                                  0.0,
+                                  0.0,
+                                  13.181871265286068,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  10.00750121262895,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  52.51428385603891,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.0,
+                                  0.9946464267894417,
+                                  0.0,
+                                  0.0,
+                                  0.0006040447715934816,
+                                  0.0,
+                                  0.0,
+                                  0.9945171491374072,
+                                  0.0,
+                                  2.8260043809454376,
+                                  1.0052642766534516,
+                                  8.201441997546244e-05,
+                                  12.154041855876695,
+                                  32.292928706201266,
+                                  0.992837130387521,
+                                  0.0,
+                                  30.71925517844603,
+                                  0.00012309907022278743,
+                                  0.0,
+                                  0.9826260237051734,
+                                  0.0,
+                                  0.0,
+                                  0.9980928367837651,
+                                  0.012142430067163312};
+
+  size_t i = 0;
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t scale = 0; scale < scales.size(); ++scale) {
+      for (size_t n = 0; n < 2; n++) {
+        ssim += weight[i++] * std::abs(scales[scale].avg_ssim[c * 2 + n]);
+        ssim += weight[i++] * std::abs(scales[scale].avg_edgediff[c * 4 + n]);
+        ssim +=
+            weight[i++] * std::abs(scales[scale].avg_edgediff[c * 4 + n + 2]);
+      }
+    }
+  }
+
+  ssim = ssim * 17.829717797575952 - 1.634169143917183;
+
+  if (ssim > 0) {
+    ssim = 100.0 - 10.0 * pow(ssim, 0.5453261009510213);
+  } else {
+    ssim = 100.0;
+  }
+  return ssim;
+}
+
+Status Ssimulacra2Comparator::SetReferenceImage(const ImageBundle& ref) {
+  PROFILER_FUNC;
+  img1_ = XybPyramid(ref, cms_, pool_);
+  mu1_.clear();
+  sigma1_sq_.clear();
+  for (const Image3F& img : img1_) {
+    mu1_.emplace_back(img.xsize(), img.ysize());
+    sigma1_sq_.emplace_back(img.xsize(), img.ysize());
+  }
+  const hwy::AlignedUniquePtr<RecursiveGaussian> rg =
+      CreateRecursiveGaussian(1.5);
+  JXL_RETURN_IF_ERROR(RunOnPool(
+      pool_, 0, img1_.size() * 3, ThreadPool::NoInit,
+      [&](const uint32_t task, size_t /*thread*/) {
+        const size_t scale = task / 3;
+        const size_t c = task % 3;
+        HWY_DYNAMIC_DISPATCH(ReferenceBlurs)
+        (img1_[scale].Plane(c), rg, &mu1_[scale].Plane(c),
+         &sigma1_sq_[scale].Plane(c));
+      },
+      "SSIMULACRA2Reference"));
+  xsize_ = ref.xsize();
+  ysize_ = ref.ysize();
+  return true;
+}
+
+Status Ssimulacra2Comparator::ComputeMsssim(const ImageBundle& actual,
+                                            Msssim* msssim) {
+  PROFILER_FUNC;
+  if (xsize_ == 0) {
+    return JXL_FAILURE("Must set reference image first");
+  }
+  if (xsize_ != actual.xsize() || ysize_ != actual.ysize()) {
+    return JXL_FAILURE("Images must have same size");
+  }
+  const std::vector<Image3F> img2 = XybPyramid(actual, cms_, pool_);
+  const hwy::AlignedUniquePtr<RecursiveGaussian> rg =
+      CreateRecursiveGaussian(1.5);
+  msssim->scales.resize(img2.size());
+  // Tasks of the largest scale come first.
+  JXL_RETURN_IF_ERROR(RunOnPool(
+      pool_, 0, img2.size() * 3, ThreadPool::NoInit,
+      [&](const uint32_t task, size_t /*thread*/) {
+        const size_t scale = task / 3;
+        const size_t c = task % 3;
+        MsssimScale& sscale = msssim->scales[scale];
+        HWY_DYNAMIC_DISPATCH(ChannelScores)
+        (img1_[scale].Plane(c), mu1_[scale].Plane(c),
+         sigma1_sq_[scale].Plane(c), img2[scale].Plane(c), rg,
+         &sscale.avg_ssim[c * 2], &sscale.avg_edgediff[c * 4]);
+      },
+      "SSIMULACRA2"));
+  return true;
+}
+
+Status Ssimulacra2Comparator::CompareWith(const ImageBundle& actual,
+                                          ImageF* diffmap, float* score) {
+  if (diffmap != nullptr) {
+    return JXL_FAILURE("SSIMULACRA 2 does not compute a diffmap");
+  }
+  Msssim msssim;
+  JXL_RETURN_IF_ERROR(ComputeMsssim(actual, &msssim));
+  if (score != nullptr) {
+    *score = msssim.Score();
+  }
+  return true;
+}
+
+float Ssimulacra2Comparator::GoodQualityScore() const { return 90.0f; }
+
+float Ssimulacra2Comparator::BadQualityScore() const { return 50.0f; }
+
+Msssim ComputeSSIMULACRA2(const ImageBundle& orig, const ImageBundle& dist,
+                          float bg, ThreadPool* pool) {
+  PROFILER_FUNC;
+  ImageBundle orig2 = orig.Copy();
+  ImageBundle dist2 = dist.Copy();
+
+  if (orig.HasAlpha()) AlphaBlend(orig2, bg);
+  if (dist.HasAlpha()) AlphaBlend(dist2, bg);
+  orig2.ClearExtraChannels();
+  dist2.ClearExtraChannels();
+
+  Ssimulacra2Comparator comparator(GetJxlCms(), pool);
+  JXL_CHECK(comparator.SetReferenceImage(orig2));
+  Msssim msssim;
+  JXL_CHECK(comparator.ComputeMsssim(dist2, &msssim));
+  return msssim;
+}
+
+Msssim ComputeSSIMULACRA2(const ImageBundle& orig,
+                          const ImageBundle& distorted) {
+  return ComputeSSIMULACRA2(orig, distorted, 0.5f);
+}
+
+double ComputeSSIMULACRA2Score(const ImageBundle& orig,
+                               const ImageBundle& distorted,
+                               ThreadPool* pool) {
+  if (!orig.HasAlpha()) {
+    return ComputeSSIMULACRA2(orig, distorted, 0.5f, pool).Score();
+  }
+  // in case of alpha transparency: blend against dark and bright backgrounds
+  // and return the worst of both scores
+  const double score0 = ComputeSSIMULACRA2(orig, distorted, 0.1f, pool).Score();
+  const double score1 = ComputeSSIMULACRA2(orig, distorted, 0.9f, pool).Score();
+  return std::min(score0, score1);
+}
+
+}  // namespace jxl
+#endif  // HWY_ONCE
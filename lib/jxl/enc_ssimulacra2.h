@@ -0,0 +1,83 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#ifndef LIB_JXL_ENC_SSIMULACRA2_H_
+#define LIB_JXL_ENC_SSIMULACRA2_H_
+
+#include <jxl/cms_interface.h>
+
+#include <vector>
+
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/enc_comparator.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/image_bundle.h"
+
+namespace jxl {
+
+struct MsssimScale {
+  double avg_ssim[3 * 2];
+  double avg_edgediff[3 * 4];
+};
+
+struct Msssim {
+  std::vector<MsssimScale> scales;
+
+  double Score() const;
+};
+
+// Computes SSIMULACRA 2 scores against a reference image whose XYB images and
+// blurs are computed only once. Alpha is ignored, see ComputeSSIMULACRA2 for
+// blending images with alpha. Images are converted to linear sRGB with 'cms'.
+// The scales and channels are processed in parallel on 'pool', which may be
+// null.
+class Ssimulacra2Comparator : public Comparator {
+ public:
+  explicit Ssimulacra2Comparator(const JxlCmsInterface &cms,
+                                 ThreadPool *pool = nullptr)
+      : cms_(cms), pool_(pool) {}
+
+  Status SetReferenceImage(const ImageBundle &ref) override;
+  // Fails if 'diffmap' is not null, SSIMULACRA 2 has no per-pixel scores.
+  Status CompareWith(const ImageBundle &actual, ImageF *diffmap,
+                     float *score) override;
+  // Same as CompareWith, but returns the norms the score is computed from.
+  Status ComputeMsssim(const ImageBundle &actual, Msssim *msssim);
+
+  float GoodQualityScore() const override;
+  float BadQualityScore() const override;
+
+ private:
+  JxlCmsInterface cms_;
+  ThreadPool *pool_;
+  size_t xsize_ = 0;
+  size_t ysize_ = 0;
+  // Per scale: the reference image, its blur and the blur of its square.
+  std::vector<Image3F> img1_;
+  std::vector<Image3F> mu1_;
+  std::vector<Image3F> sigma1_sq_;
+};
+
+// Computes the SSIMULACRA 2 score between reference image 'orig' and
+// distorted image 'distorted'. In case of alpha transparency, assume
+// a gray background if intensity 'bg' (in range 0..1).
+// The scales and channels are processed in parallel on 'pool', which may be
+// null; the result does not depend on it.
+Msssim ComputeSSIMULACRA2(const ImageBundle &orig, const ImageBundle &distorted,
+                          float bg, ThreadPool *pool = nullptr);
+Msssim ComputeSSIMULACRA2(const ImageBundle &orig,
+                          const ImageBundle &distorted);
+
+// Returns the SSIMULACRA 2 score in range -inf..100. If 'orig' has alpha, the
+// images are blended against dark and bright backgrounds and the worst of both
+// scores is returned.
+double ComputeSSIMULACRA2Score(const ImageBundle &orig,
+                               const ImageBundle &distorted,
+                               ThreadPool *pool = nullptr);
+
+}  // namespace jxl
+
+#endif  // LIB_JXL_ENC_SSIMULACRA2_H_
@@ -1061,6 +1061,7 @@ JxlEncoderStatus JxlEncoderFrameSettingsSetOption(
     case JXL_ENC_FRAME_SETTING_LOSSY_PALETTE:
     case JXL_ENC_FRAME_SETTING_JPEG_RECON_CFL:
     case JXL_ENC_FRAME_SETTING_JPEG_COMPRESS_BOXES:
+    case JXL_ENC_FRAME_SETTING_BOUNDED_TOKEN_MEMORY:
       if (value < -1 || value > 1) {
         return JXL_API_ERROR(
             frame_settings->enc, JXL_ENC_ERR_API_USAGE,
@@ -1279,12 +1280,17 @@ JxlEncoderStatus JxlEncoderFrameSettingsSetOption(
       frame_settings->values.frame_index_box = true;
       return JXL_ENC_SUCCESS;
     case JXL_ENC_FRAME_SETTING_PHOTON_NOISE:
+    case JXL_ENC_FRAME_SETTING_TARGET_SSIMULACRA2:
+    case JXL_ENC_FRAME_SETTING_TARGET_BUTTERAUGLI:
       return JXL_API_ERROR(frame_settings->enc, JXL_ENC_ERR_NOT_SUPPORTED,
                            "Float option, try setting it with "
                            "JxlEncoderFrameSettingsSetFloatOption");
     case JXL_ENC_FRAME_SETTING_JPEG_COMPRESS_BOXES:
       frame_settings->values.cparams.jpeg_compress_boxes = value;
       return JXL_ENC_SUCCESS;
+    case JXL_ENC_FRAME_SETTING_BOUNDED_TOKEN_MEMORY:
+      frame_settings->values.cparams.bounded_token_memory = (value == 1);
+      return JXL_ENC_SUCCESS;
     default:
       return JXL_API_ERROR(frame_settings->enc, JXL_ENC_ERR_NOT_SUPPORTED,
                            "Unknown option");
@@ -1343,6 +1349,20 @@ JxlEncoderStatus JxlEncoderFrameSettingsSetFloatOption(
         frame_settings->values.cparams.channel_colors_percent = value;
       }
       return JXL_ENC_SUCCESS;
+    case JXL_ENC_FRAME_SETTING_TARGET_SSIMULACRA2:
+      if (value < 0.f || value > 100.f) {
+        return JXL_API_ERROR(frame_settings->enc, JXL_ENC_ERR_API_USAGE,
+                             "Option value has to be in [0..100]");
+      }
+      frame_settings->values.cparams.target_ssimulacra2 = value;
+      return JXL_ENC_SUCCESS;
+    case JXL_ENC_FRAME_SETTING_TARGET_BUTTERAUGLI:
+      if (value < 0.f || value > 25.f) {
+        return JXL_API_ERROR(frame_settings->enc, JXL_ENC_ERR_API_USAGE,
+                             "Option value has to be in [0..25]");
+      }
+      frame_settings->values.cparams.target_butteraugli = value;
+      return JXL_ENC_SUCCESS;
     case JXL_ENC_FRAME_SETTING_EFFORT:
     case JXL_ENC_FRAME_SETTING_DECODING_SPEED:
     case JXL_ENC_FRAME_SETTING_RESAMPLING:
@@ -1374,6 +1394,7 @@ JxlEncoderStatus JxlEncoderFrameSettingsSetFloatOption(
     case JXL_ENC_FRAME_SETTING_BROTLI_EFFORT:
     case JXL_ENC_FRAME_SETTING_FILL_ENUM:
     case JXL_ENC_FRAME_SETTING_JPEG_COMPRESS_BOXES:
+    case JXL_ENC_FRAME_SETTING_BOUNDED_TOKEN_MEMORY:
       return JXL_API_ERROR(frame_settings->enc, JXL_ENC_ERR_NOT_SUPPORTED,
                            "Int option, try setting it with "
                            "JxlEncoderFrameSettingsSetOption");
@@ -8,11 +8,14 @@
 #include <stdlib.h>
 #include <string.h> /* for memset, memcpy */
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <string>
 #include <vector>
 
 #include "lib/jxl/base/bits.h"
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/common.h"
 #include "lib/jxl/image_bundle.h"
 #include "lib/jxl/jpeg/dec_jpeg_serialization_state.h"
@@ -691,8 +694,118 @@ size_t HistogramIndex(const JPEGData& jpg, size_t scan_index,
   return idx + component_index;
 }
 
+// Encodes the restart intervals [begin, end) of a sequential scan into
+// `output`. Each interval is preceded by its restart marker (except the first
+// interval of the scan) and is padded to a byte boundary with 1 bits, so the
+// outputs of consecutive ranges of intervals can be simply concatenated.
+bool EncodeRestartIntervals(const JPEGData& jpg, const JPEGScanInfo& scan_info,
+                            SerializationState* state, size_t begin,
+                            size_t end, std::deque<OutputChunk>* output) {
+  const bool is_interleaved = (scan_info.num_components > 1);
+  int MCUs_per_row = 0;
+  int MCU_rows = 0;
+  jpg.CalculateMcuSize(scan_info, &MCUs_per_row, &MCU_rows);
+  const size_t num_mcus = static_cast<size_t>(MCUs_per_row) * MCU_rows;
+  size_t blocks_per_mcu = 0;
+  for (size_t i = 0; i < scan_info.num_components; ++i) {
+    const JPEGComponent& c = jpg.components[scan_info.components[i].comp_idx];
+    blocks_per_mcu += is_interleaved ? c.h_samp_factor * c.v_samp_factor : 1;
+  }
+  const auto& extra_zero_runs = scan_info.extra_zero_runs;
+  JpegBitWriter bw;
+  JpegBitWriterInit(&bw, output);
+  coeff_t last_dc_coeff[kMaxComponents];
+  for (size_t k = begin; k < end; ++k) {
+    if (k > 0) EmitMarker(&bw, 0xD0 + ((k - 1) & 0x7));
+    memset(last_dc_coeff, 0, sizeof(last_dc_coeff));
+    const size_t mcu_begin = k * jpg.restart_interval;
+    const size_t mcu_end = std::min(num_mcus, mcu_begin + jpg.restart_interval);
+    uint32_t block_scan_index = mcu_begin * blocks_per_mcu;
+    size_t extra_zero_runs_pos =
+        std::lower_bound(extra_zero_runs.begin(), extra_zero_runs.end(),
+                         block_scan_index,
+                         [](const JPEGScanInfo::ExtraZeroRunInfo& info,
+                            uint32_t block_idx) {
+                           return info.block_idx < block_idx;
+                         }) -
+        extra_zero_runs.begin();
+    for (size_t mcu = mcu_begin; mcu < mcu_end; ++mcu) {
+      const int mcu_y = mcu / MCUs_per_row;
+      const int mcu_x = mcu % MCUs_per_row;
+      for (size_t i = 0; i < scan_info.num_components; ++i) {
+        const JPEGComponentScanInfo& si = scan_info.components[i];
+        const JPEGComponent& c = jpg.components[si.comp_idx];
+        HuffmanCodeTable* dc_huff = &state->dc_huff_table[si.dc_tbl_idx];
+        HuffmanCodeTable* ac_huff = &state->ac_huff_table[si.ac_tbl_idx];
+        int n_blocks_y = is_interleaved ? c.v_samp_factor : 1;
+        int n_blocks_x = is_interleaved ? c.h_samp_factor : 1;
+        for (int iy = 0; iy < n_blocks_y; ++iy) {
+          for (int ix = 0; ix < n_blocks_x; ++ix) {
+            int block_y = mcu_y * n_blocks_y + iy;
+            int block_x = mcu_x * n_blocks_x + ix;
+            int block_idx = block_y * c.width_in_blocks + block_x;
+            int num_zero_runs = 0;
+            if (extra_zero_runs_pos < extra_zero_runs.size() &&
+                extra_zero_runs[extra_zero_runs_pos].block_idx ==
+                    block_scan_index) {
+              num_zero_runs =
+                  extra_zero_runs[extra_zero_runs_pos].num_extra_zero_runs;
+              ++extra_zero_runs_pos;
+            }
+            if (!EncodeDCTBlockSequential<OutputModes::kModeWrite>(
+                    &c.coeffs[block_idx << 6], dc_huff, ac_huff, num_zero_runs,
+                    last_dc_coeff + si.comp_idx, &bw)) {
+              return false;
+            }
+            ++block_scan_index;
+          }
+        }
+      }
+    }
+    const uint8_t* pad_bits = nullptr;
+    JumpToByteBoundary(&bw, &pad_bits, nullptr);
+  }
+  JpegBitWriterFinish(&bw);
+  return bw.healthy;
+}
+
+// Encodes a complete sequential scan with restart intervals by splitting its
+// restart intervals between the threads of `pool`. Returns false if the scan
+// is too small to be worth splitting.
+bool EncodeScanParallel(const JPEGData& jpg, const JPEGScanInfo& scan_info,
+                        size_t num_mcus, ThreadPool* pool,
+                        SerializationState* state, bool* ok) {
+  // Minimum number of MCUs encoded by one thread pool task.
+  constexpr size_t kMinMCUsPerTask = 1024;
+  const size_t num_intervals = DivCeil(num_mcus, jpg.restart_interval);
+  const size_t intervals_per_task =
+      DivCeil(kMinMCUsPerTask, jpg.restart_interval);
+  const size_t num_tasks = DivCeil(num_intervals, intervals_per_task);
+  if (num_tasks <= 1) return false;
+  std::vector<std::deque<OutputChunk>> outputs(num_tasks);
+  std::atomic<bool> healthy{true};
+  const auto encode_task = [&](const uint32_t task, size_t /* thread */) {
+    const size_t begin = task * intervals_per_task;
+    const size_t end = std::min(num_intervals, begin + intervals_per_task);
+    if (!EncodeRestartIntervals(jpg, scan_info, state, begin, end,
+                                &outputs[task])) {
+      healthy.store(false);
+    }
+  };
+  *ok = RunOnPool(pool, 0, num_tasks, ThreadPool::NoInit, encode_task,
+                  "EncodeRestartIntervals") &&
+        healthy.load();
+  for (auto& output : outputs) {
+    for (auto& chunk : output) {
+      state->output_queue.emplace_back(std::move(chunk));
+    }
+  }
+  return true;
+}
+
 template <int kMode, int kOutputMode>
 SerializationStatus JXL_NOINLINE DoEncodeScan(const JPEGData& jpg,
+                                              ThreadPool* pool,
                                               SerializationState* state) {
   const JPEGScanInfo& scan_info = jpg.scan_info[state->scan_index];
   EncodeScanState& ss = state->scan_state;
@@ -747,27 +860,37 @@ SerializationStatus JXL_NOINLINE DoEncodeScan(const JPEGData& jpg,
   const int Ss = is_progressive ? scan_info.Ss : 0;
   const int Se = is_progressive ? scan_info.Se : 63;
 
-  // DC-only is defined by [0..0] spectral range.
-  const bool want_ac = ((Ss != 0) || (Se != 0));
-  // TODO: support streaming decoding again.
-  const bool complete_ac = true;
-  const bool has_ac = true;
-  if (want_ac && !has_ac) return SerializationStatus::NEEDS_MORE_INPUT;
-
-  // |has_ac| implies |complete_dc| but not vice versa; for the sake of
-  // simplicity we pretend they are equal, because they are separated by just a
-  // few bytes of input.
-  const bool complete_dc = has_ac;
-  const bool complete = want_ac ? complete_ac : complete_dc;
-  // When "incomplete" |ac_dc| tracks information about current ("incomplete")
-  // band parsing progress.
-
-  // FIXME: Is this always complete?
-  // const int last_mcu_y =
-  //     complete ? MCU_rows : parsing_state.internal->ac_dc.next_mcu_y *
-  //     v_group;
-  (void)complete;
-  const int last_mcu_y = complete ? MCU_rows : 0;
+  // Only the MCU rows whose coefficients are already decoded can be written,
+  // the rest of the scan is written by a later call, when more of the
+  // coefficients are available.
+  const int v_group =
+      is_interleaved
+          ? 1
+          : jpg.components[scan_info.components[0].comp_idx].v_samp_factor;
+  int last_mcu_y = MCU_rows;
+  if (state->num_available_imcu_rows < static_cast<size_t>(MCU_rows)) {
+    last_mcu_y =
+        std::min<int>(MCU_rows, state->num_available_imcu_rows * v_group);
+  }
+
+  // Restart intervals can be encoded independently of each other, except if
+  // the padding bits have to be reproduced, since then the number of padding
+  // bits used by the previous intervals is not known in advance.
+  if (kMode == 0 && kOutputMode == OutputModes::kModeWrite &&
+      pool != nullptr && restart_interval > 0 && state->pad_bits == nullptr &&
+      ss.mcu_y == 0 && last_mcu_y == MCU_rows) {
+    bool ok = true;
+    if (EncodeScanParallel(jpg, scan_info,
+                           static_cast<size_t>(MCUs_per_row) * MCU_rows, pool,
+                           state, &ok)) {
+      if (!ok) return SerializationStatus::ERROR;
+      JpegBitWriterFinish(bw);
+      ss.mcu_y = MCU_rows;
+      ss.stage = EncodeScanState::HEAD;
+      state->scan_index++;
+      return SerializationStatus::DONE;
+    }
+  }
 
   for (; ss.mcu_y < last_mcu_y; ++ss.mcu_y) {
     for (int mcu_x = 0; mcu_x < MCUs_per_row; ++mcu_x) {
@@ -837,6 +960,9 @@ SerializationStatus JXL_NOINLINE DoEncodeScan(const JPEGData& jpg,
   }
   if (ss.mcu_y < MCU_rows) {
     if (!bw->healthy) return SerializationStatus::ERROR;
+    // Make the already encoded complete bytes of this scan available for
+    // output.
+    if (bw->pos > 0) SwapBuffer(bw);
     return SerializationStatus::NEEDS_MORE_INPUT;
   }
   Flush<kOutputMode>(coding_state, bw);
@@ -853,6 +979,7 @@ SerializationStatus JXL_NOINLINE DoEncodeScan(const JPEGData& jpg,
 
 template <int kOutputMode>
 static SerializationStatus JXL_INLINE EncodeScan(const JPEGData& jpg,
+                                                 ThreadPool* pool,
                                                  SerializationState* state) {
   const JPEGScanInfo& scan_info = jpg.scan_info[state->scan_index];
   const bool is_progressive = state->is_progressive;
@@ -863,17 +990,17 @@ static SerializationStatus JXL_INLINE EncodeScan(const JPEGData& jpg,
   const bool need_sequential =
       !is_progressive || (Ah == 0 && Al == 0 && Ss == 0 && Se == 63);
   if (need_sequential) {
-    return DoEncodeScan<0, kOutputMode>(jpg, state);
+    return DoEncodeScan<0, kOutputMode>(jpg, pool, state);
   } else if (Ah == 0) {
-    return DoEncodeScan<1, kOutputMode>(jpg, state);
+    return DoEncodeScan<1, kOutputMode>(jpg, pool, state);
   } else {
-    return DoEncodeScan<2, kOutputMode>(jpg, state);
+    return DoEncodeScan<2, kOutputMode>(jpg, pool, state);
   }
 }
 
 template <int kOutputMode>
 SerializationStatus SerializeSection(uint8_t marker, SerializationState* state,
-                                     const JPEGData& jpg) {
+                                     const JPEGData& jpg, ThreadPool* pool) {
   const auto to_status = [](bool result) {
     return result ? SerializationStatus::DONE : SerializationStatus::ERROR;
   };
@@ -904,7 +1031,7 @@ SerializationStatus SerializeSection(uint8_t marker, SerializationState* state,
       return to_status(EncodeEOI(jpg, state));
 
     case 0xDA:
-      return EncodeScan<kOutputMode>(jpg, state);
+      return EncodeScan<kOutputMode>(jpg, pool, state);
 
     case 0xDB:
       return to_status(EncodeDQT(jpg, state));
@@ -941,10 +1068,9 @@ SerializationStatus SerializeSection(uint8_t marker, SerializationState* state,
   }
 }
 
-// TODO(veluca): add streaming support again.
 template <int kOutputMode>
 Status WriteJpegInternal(const JPEGData& jpg, const JPEGOutput& out,
-                         SerializationState* ss) {
+                         ThreadPool* pool, SerializationState* ss) {
   const auto maybe_push_output = [&]() -> Status {
     if (ss->stage != SerializationState::STAGE_ERROR) {
       while (!ss->output_queue.empty()) {
@@ -954,6 +1080,7 @@ Status WriteJpegInternal(const JPEGData& jpg, const JPEGOutput& out,
           return StatusMessage(Status(StatusCode::kNotEnoughBytes),
                                "Failed to write output");
         }
+        chunk.next += num_written;
         chunk.len -= num_written;
         if (chunk.len == 0) {
           ss->output_queue.pop_front();
@@ -991,8 +1118,8 @@ Status WriteJpegInternal(const JPEGData& jpg, const JPEGOutput& out,
         }
 
         EncodeSOI(ss);
-        JXL_QUIET_RETURN_IF_ERROR(maybe_push_output());
         ss->stage = SerializationState::STAGE_SERIALIZE_SECTION;
+        JXL_QUIET_RETURN_IF_ERROR(maybe_push_output());
         break;
       }
 
@@ -1003,25 +1130,31 @@ Status WriteJpegInternal(const JPEGData& jpg, const JPEGOutput& out,
         }
         uint8_t marker = jpg.marker_order[ss->section_index];
         SerializationStatus status =
-            SerializeSection<kOutputMode>(marker, ss, jpg);
+            SerializeSection<kOutputMode>(marker, ss, jpg, pool);
         if (status == SerializationStatus::ERROR) {
           JXL_WARNING("Failed to encode marker 0x%.2x", marker);
           ss->stage = SerializationState::STAGE_ERROR;
           break;
         }
-        JXL_QUIET_RETURN_IF_ERROR(maybe_push_output());
         if (status == SerializationStatus::NEEDS_MORE_INPUT) {
-          return JXL_FAILURE("Incomplete serialization data");
+          // The serialization continues from this section when more of the
+          // coefficients are available.
+          JXL_QUIET_RETURN_IF_ERROR(maybe_push_output());
+          return true;
         } else if (status != SerializationStatus::DONE) {
           JXL_DASSERT(false);
           ss->stage = SerializationState::STAGE_ERROR;
           break;
         }
+        // The section index is advanced before pushing the output, so that if
+        // the output is full, the next call does not serialize it again.
         ++ss->section_index;
+        JXL_QUIET_RETURN_IF_ERROR(maybe_push_output());
         break;
       }
 
       case SerializationState::STAGE_DONE:
+        JXL_QUIET_RETURN_IF_ERROR(maybe_push_output());
         JXL_ASSERT(ss->output_queue.empty());
         if (ss->pad_bits != nullptr && ss->pad_bits != ss->pad_bits_end) {
           return JXL_FAILURE("Invalid number of padding bits.");
@@ -1036,14 +1169,34 @@ Status WriteJpegInternal(const JPEGData& jpg, const JPEGOutput& out,
 
 }  // namespace
 
-Status WriteJpeg(const JPEGData& jpg, const JPEGOutput& out) {
+Status WriteJpeg(const JPEGData& jpg, const JPEGOutput& out,
+                 ThreadPool* pool) {
   SerializationState ss;
-  return WriteJpegInternal<OutputModes::kModeWrite>(jpg, out, &ss);
+  JXL_QUIET_RETURN_IF_ERROR(
+      WriteJpegInternal<OutputModes::kModeWrite>(jpg, out, pool, &ss));
+  if (ss.stage != SerializationState::STAGE_DONE) {
+    return JXL_FAILURE("Incomplete serialization data");
+  }
+  return true;
+}
+
+Status WriteJpegIncremental(const JPEGData& jpg,
+                            size_t num_available_imcu_rows,
+                            const JPEGOutput& out, ThreadPool* pool,
+                            SerializationState* ss) {
+  ss->num_available_imcu_rows = num_available_imcu_rows;
+  return WriteJpegInternal<OutputModes::kModeWrite>(jpg, out, pool, ss);
 }
 
 Status ProcessJpeg(const JPEGData& jpg, SerializationState* ss) {
   auto nullout = [](const uint8_t* buf, size_t len) { return len; };
-  return WriteJpegInternal<OutputModes::kModeHistogram>(jpg, nullout, ss);
+  JXL_QUIET_RETURN_IF_ERROR(
+      WriteJpegInternal<OutputModes::kModeHistogram>(jpg, nullout,
+                                                     /*pool=*/nullptr, ss));
+  if (ss->stage != SerializationState::STAGE_DONE) {
+    return JXL_FAILURE("Incomplete serialization data");
+  }
+  return true;
 }
 
 }  // namespace jpeg
@@ -13,6 +13,7 @@
 
 #include <functional>
 
+#include "lib/jxl/base/data_parallel.h"
 #include "lib/jxl/jpeg/dec_jpeg_serialization_state.h"
 #include "lib/jxl/jpeg/jpeg_data.h"
 
@@ -23,7 +24,22 @@ namespace jpeg {
 // written.
 using JPEGOutput = std::function<size_t(const uint8_t* buf, size_t len)>;
 
-Status WriteJpeg(const JPEGData& jpg, const JPEGOutput& out);
+// If `pool` is not null, sequential scans with restart intervals are encoded
+// by multiple threads.
+Status WriteJpeg(const JPEGData& jpg, const JPEGOutput& out,
+                 ThreadPool* pool = nullptr);
+
+// Incremental version of WriteJpeg, for when the coefficients of `jpg` become
+// available from top to bottom. Writes the part of the bytestream that depends
+// only on the first `num_available_imcu_rows` iMCU rows of the coefficients,
+// and keeps the progress in `ss`, so that the next call with the same `ss` and
+// more available rows continues where this one stopped. If `out` does not
+// accept all the bytes, the rest is written by the next call. The bytestream is
+// complete when ss->stage is STAGE_DONE.
+Status WriteJpegIncremental(const JPEGData& jpg,
+                            size_t num_available_imcu_rows,
+                            const JPEGOutput& out, ThreadPool* pool,
+                            SerializationState* ss);
 
 // Same as WriteJpeg, but instead of writing to the output, collects statistics
 // about the bit-stream into `ss`.
@@ -7,6 +7,7 @@
 #define LIB_JXL_JPEG_DEC_JPEG_SERIALIZATION_STATE_H_
 
 #include <deque>
+#include <limits>
 #include <vector>
 
 #include "lib/jxl/jpeg/dec_jpeg_output_chunk.h"
@@ -86,6 +87,9 @@ struct SerializationState {
   const uint8_t* pad_bits_end = nullptr;
   bool seen_dri_marker = false;
   bool is_progressive = false;
+  // Number of iMCU rows, counted from the top of the image, whose coefficients
+  // are available; the scans are serialized only up to this row.
+  size_t num_available_imcu_rows = std::numeric_limits<size_t>::max();
 
   EncodeScanState scan_state;
 };
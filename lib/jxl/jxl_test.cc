@@ -56,6 +56,7 @@ using extras::JXLDecompressParams;
 using extras::PackedPixelFile;
 using test::ButteraugliDistance;
 using test::ComputeDistance2;
+using test::ComputeSSIMULACRA2;
 using test::Roundtrip;
 using test::TestImage;
 
@@ -356,6 +357,66 @@ TEST(JxlTest, RoundtripLargeFast) {
   EXPECT_THAT(ComputeDistance2(t.ppf(), ppf_out), IsSlightlyBelow(100));
 }
 
+TEST(JxlTest, RoundtripTargetSsimulacra2) {
+  ThreadPoolInternal pool(8);
+  const PaddedBytes orig =
+      ReadTestData("external/wesaturate/500px/u76c0g_bliznaca_srgb8.png");
+  TestImage t;
+  t.DecodeFromBytes(orig).ClearMetadata();
+
+  size_t prev_size = 0;
+  for (float target : {70.0f, 80.0f, 90.0f}) {
+    JXLCompressParams cparams;
+    cparams.AddFloatOption(JXL_ENC_FRAME_SETTING_TARGET_SSIMULACRA2, target);
+    PackedPixelFile ppf_out;
+    const size_t size = Roundtrip(t.ppf(), cparams, {}, &pool, &ppf_out);
+    // The search runs on the encoder side reconstruction, which may differ
+    // slightly from the decoded image, and stops close to the target.
+    const double score = ComputeSSIMULACRA2(t.ppf(), ppf_out, &pool);
+    EXPECT_GT(score, target - 1.0);
+    EXPECT_LT(score, target + 5.0);
+    EXPECT_GT(size, prev_size);
+    prev_size = size;
+  }
+}
+
+TEST(JxlTest, RoundtripTargetSsimulacra2Alpha) {
+  ThreadPoolInternal pool(8);
+  const PaddedBytes orig =
+      ReadTestData("external/wesaturate/500px/tmshre_riaphotographs_alpha.png");
+  TestImage t;
+  t.DecodeFromBytes(orig).ClearMetadata();
+  ASSERT_EQ(t.ppf().info.alpha_bits, 8);
+
+  JXLCompressParams cparams;
+  cparams.AddOption(JXL_ENC_FRAME_SETTING_EFFORT, 7);  // kSquirrel
+  cparams.AddFloatOption(JXL_ENC_FRAME_SETTING_TARGET_SSIMULACRA2, 80.0f);
+  PackedPixelFile ppf_out;
+  Roundtrip(t.ppf(), cparams, {}, &pool, &ppf_out);
+  // The search compares the colors of the image with invisible pixels
+  // simplified as in the encoded image. The score blends against backgrounds,
+  // where partially transparent pixels may hide some of the differences.
+  EXPECT_GT(ComputeSSIMULACRA2(t.ppf(), ppf_out, &pool), 79.0);
+}
+
+TEST(JxlTest, RoundtripTargetButteraugli) {
+  ThreadPoolInternal pool(8);
+  const PaddedBytes orig =
+      ReadTestData("external/wesaturate/500px/u76c0g_bliznaca_srgb8.png");
+  TestImage t;
+  t.DecodeFromBytes(orig).ClearMetadata();
+
+  JXLCompressParams cparams;
+  cparams.AddFloatOption(JXL_ENC_FRAME_SETTING_TARGET_BUTTERAUGLI, 2.0f);
+  PackedPixelFile ppf_out;
+  Roundtrip(t.ppf(), cparams, {}, &pool, &ppf_out);
+  // Some slack for differences between the encoder side reconstruction and
+  // the decoded image. The search stops close to the target.
+  const float distance = ButteraugliDistance(t.ppf(), ppf_out, &pool);
+  EXPECT_THAT(distance, IsSlightlyBelow(2.05));
+  EXPECT_GT(distance, 0.8f * 2.0f);
+}
+
 TEST(JxlTest, RoundtripDotsForceEpf) {
   ThreadPoolInternal pool(8);
   const PaddedBytes orig =
@@ -1356,6 +1417,15 @@ TEST(JxlTest, JXL_TRANSCODE_JPEG_TEST(RoundtripJpegRecompression_asymmetric)) {
   EXPECT_EQ(RoundtripJpeg(orig, &pool), 500602u);
 }
 
+TEST(JxlTest,
+     JXL_TRANSCODE_JPEG_TEST(RoundtripJpegRecompression420RestartIntervals)) {
+  // The restart intervals of this JPEG are reconstructed in parallel.
+  ThreadPoolInternal pool(8);
+  const PaddedBytes orig =
+      ReadTestData("jxl/flower/flower.png.im_q85_420_R13B.jpg");
+  RoundtripJpeg(orig, &pool);
+}
+
 TEST(JxlTest, JXL_TRANSCODE_JPEG_TEST(RoundtripJpegRecompression420Progr)) {
   ThreadPoolInternal pool(8);
   const PaddedBytes orig =
@@ -137,7 +137,8 @@ void GatherTreeData(const Image &image, pixel_type chan, size_t group_id,
 Tree LearnTree(TreeSamples &&tree_samples, size_t total_pixels,
                const ModularOptions &options,
                const std::vector<ModularMultiplierInfo> &multiplier_info = {},
-               StaticPropRange static_prop_range = {}) {
+               StaticPropRange static_prop_range = {},
+               ThreadPool *pool = nullptr) {
   for (size_t i = 0; i < kNumStaticProperties; i++) {
     if (static_prop_range[i][1] == 0) {
       static_prop_range[i][1] = std::numeric_limits<uint32_t>::max();
@@ -159,7 +160,7 @@ Tree LearnTree(TreeSamples &&tree_samples, size_t total_pixels,
   ComputeBestTree(tree_samples,
                   options.splitting_heuristics_node_threshold * required_cost,
                   multiplier_info, static_prop_range,
-                  options.fast_decode_multiplier, &tree);
+                  options.fast_decode_multiplier, pool, &tree);
   return tree;
 }
 
@@ -40,19 +40,24 @@ size_t Padded(size_t x) { return RoundUpTo(x, Lanes(df)); }
 float EstimateBits(const int32_t *counts, int32_t *rounded_counts,
                    size_t num_symbols) {
   // Try to approximate the effect of rounding up nonzero probabilities.
-  int32_t total = std::accumulate(counts, counts + num_symbols, 0);
+  auto total_lanes = Zero(di);
+  for (size_t i = 0; i < num_symbols; i += Lanes(di)) {
+    total_lanes = Add(total_lanes, LoadU(di, &counts[i]));
+  }
+  const int32_t total = GetLane(SumOfLanes(di, total_lanes));
   const auto min = Set(di, (total + ANS_TAB_SIZE - 1) >> ANS_LOG_TAB_SIZE);
   const auto zero_i = Zero(di);
+  auto rounded_total_lanes = Zero(di);
   for (size_t i = 0; i < num_symbols; i += Lanes(df)) {
     auto counts_v = LoadU(di, &counts[i]);
     counts_v = IfThenElse(Eq(counts_v, zero_i), zero_i,
                           IfThenElse(Lt(counts_v, min), min, counts_v));
     StoreU(counts_v, di, &rounded_counts[i]);
+    rounded_total_lanes = Add(rounded_total_lanes, counts_v);
   }
   // Compute entropy of the "rounded" probabilities.
   const auto zero = Zero(df);
-  const size_t total_scalar =
-      std::accumulate(rounded_counts, rounded_counts + num_symbols, 0);
+  const size_t total_scalar = GetLane(SumOfLanes(di, rounded_total_lanes));
   const auto inv_total = Set(df, 1.0f / total_scalar);
   auto bits_lanes = Zero(df);
   auto total_v = Set(di, total_scalar);
@@ -68,6 +73,20 @@ float EstimateBits(const int32_t *counts, int32_t *rounded_counts,
   return GetLane(SumOfLanes(df, bits_lanes));
 }
 
+// Moves the histogram of the samples with one property value from one side of
+// a split to the other one, and clears it. The number of symbols must be a
+// multiple of the vector size.
+void MoveHistogram(int32_t *JXL_RESTRICT increase, int32_t *JXL_RESTRICT above,
+                   int32_t *JXL_RESTRICT below, size_t num_symbols) {
+  const auto zero = Zero(di);
+  for (size_t sym = 0; sym < num_symbols; sym += Lanes(di)) {
+    const auto increase_v = LoadU(di, increase + sym);
+    StoreU(Sub(LoadU(di, above + sym), increase_v), di, above + sym);
+    StoreU(Add(LoadU(di, below + sym), increase_v), di, below + sym);
+    StoreU(zero, di, increase + sym);
+  }
+}
+
 void MakeSplitNode(size_t pos, int property, int splitval, Predictor lpred,
                    int64_t loff, Predictor rpred, int64_t roff, Tree *tree) {
   // Note that the tree splits on *strictly greater*.
@@ -168,294 +187,413 @@ void SplitTreeSamples(TreeSamples &tree_samples, size_t begin, size_t pos,
   }
 }
 
-void FindBestSplit(TreeSamples &tree_samples, float threshold,
-                   const std::vector<ModularMultiplierInfo> &mul_info,
-                   StaticPropRange initial_static_prop_range,
-                   float fast_decode_multiplier, Tree *tree) {
-  struct NodeInfo {
-    size_t pos;
-    size_t begin;
-    size_t end;
-    uint64_t used_properties;
-    StaticPropRange static_prop_range;
+struct SplitInfo {
+  size_t prop = 0;
+  uint32_t val = 0;
+  size_t pos = 0;
+  float lcost = std::numeric_limits<float>::max();
+  float rcost = std::numeric_limits<float>::max();
+  Predictor lpred = Predictor::Zero;
+  Predictor rpred = Predictor::Zero;
+  float Cost() const { return lcost + rcost; }
+};
+
+struct NodeInfo {
+  size_t pos;
+  size_t begin;
+  size_t end;
+  uint64_t used_properties;
+  StaticPropRange static_prop_range;
+};
+
+// Histograms of the samples of a node, shared by the evaluation of the splits
+// along all the properties.
+struct NodeStats {
+  size_t max_symbols = 0;
+  std::vector<int32_t> counts;
+  std::vector<uint32_t> tot_extra_bits;
+  float base_bits = 0;
+  bool has_forced_split = false;
+  SplitInfo forced_split;
+};
+
+// Best splits along one property of a node, one for each kind of split.
+struct PropertySplits {
+  SplitInfo static_constant;
+  SplitInfo static_;
+  SplitInfo nonstatic;
+  SplitInfo nowp;
+};
+
+// Per-thread temporary storage of the split search. The increase arrays are
+// left all zero after each use, so they can be reused for any node.
+struct SplitScratch {
+  struct CostInfo {
+    float cost = std::numeric_limits<float>::max();
+    float extra_cost = 0;
+    float Cost() const { return cost + extra_cost; }
+    Predictor pred;  // will be uninitialized in some cases, but never used.
   };
-  std::vector<NodeInfo> nodes;
-  nodes.push_back(NodeInfo{0, 0, tree_samples.NumDistinctSamples(), 0,
-                           initial_static_prop_range});
+  std::vector<int32_t> rounded_counts;
+  std::vector<int> prop_value_used_count;
+  std::vector<int32_t> count_increase;
+  std::vector<size_t> extra_bits_increase;
+  std::vector<CostInfo> costs_l;
+  std::vector<CostInfo> costs_r;
+  std::vector<int32_t> counts_above;
+  std::vector<int32_t> counts_below;
+};
 
+void ComputeNodeStats(TreeSamples &tree_samples, const NodeInfo &node,
+                      float threshold,
+                      const std::vector<ModularMultiplierInfo> &mul_info,
+                      SplitScratch *scratch, Tree *tree, NodeStats *stats) {
+  const size_t pos = node.pos;
+  const size_t begin = node.begin;
+  const size_t end = node.end;
   size_t num_predictors = tree_samples.NumPredictors();
-  size_t num_properties = tree_samples.NumProperties();
 
-  // TODO(veluca): consider parallelizing the search (processing multiple nodes
-  // at a time).
-  while (!nodes.empty()) {
-    size_t pos = nodes.back().pos;
-    size_t begin = nodes.back().begin;
-    size_t end = nodes.back().end;
-    uint64_t used_properties = nodes.back().used_properties;
-    StaticPropRange static_prop_range = nodes.back().static_prop_range;
-    nodes.pop_back();
-    if (begin == end) continue;
-
-    struct SplitInfo {
-      size_t prop = 0;
-      uint32_t val = 0;
-      size_t pos = 0;
-      float lcost = std::numeric_limits<float>::max();
-      float rcost = std::numeric_limits<float>::max();
-      Predictor lpred = Predictor::Zero;
-      Predictor rpred = Predictor::Zero;
-      float Cost() { return lcost + rcost; }
-    };
-
-    SplitInfo best_split_static_constant;
-    SplitInfo best_split_static;
-    SplitInfo best_split_nonstatic;
-    SplitInfo best_split_nowp;
-
-    JXL_DASSERT(begin <= end);
-    JXL_DASSERT(end <= tree_samples.NumDistinctSamples());
-
-    // Compute the maximum token in the range.
-    size_t max_symbols = 0;
-    for (size_t pred = 0; pred < num_predictors; pred++) {
-      for (size_t i = begin; i < end; i++) {
-        uint32_t tok = tree_samples.Token(pred, i);
-        max_symbols = max_symbols > tok + 1 ? max_symbols : tok + 1;
-      }
+  JXL_DASSERT(begin <= end);
+  JXL_DASSERT(end <= tree_samples.NumDistinctSamples());
+
+  // Compute the maximum token in the range.
+  size_t max_symbols = 0;
+  for (size_t pred = 0; pred < num_predictors; pred++) {
+    for (size_t i = begin; i < end; i++) {
+      uint32_t tok = tree_samples.Token(pred, i);
+      max_symbols = max_symbols > tok + 1 ? max_symbols : tok + 1;
     }
-    max_symbols = Padded(max_symbols);
-    std::vector<int32_t> rounded_counts(max_symbols);
-    std::vector<int32_t> counts(max_symbols * num_predictors);
-    std::vector<uint32_t> tot_extra_bits(num_predictors);
-    for (size_t pred = 0; pred < num_predictors; pred++) {
-      for (size_t i = begin; i < end; i++) {
-        counts[pred * max_symbols + tree_samples.Token(pred, i)] +=
-            tree_samples.Count(i);
-        tot_extra_bits[pred] +=
-            tree_samples.NBits(pred, i) * tree_samples.Count(i);
-      }
+  }
+  max_symbols = Padded(max_symbols);
+  stats->max_symbols = max_symbols;
+  std::vector<int32_t> &counts = stats->counts;
+  std::vector<uint32_t> &tot_extra_bits = stats->tot_extra_bits;
+  counts.assign(max_symbols * num_predictors, 0);
+  tot_extra_bits.assign(num_predictors, 0);
+  for (size_t pred = 0; pred < num_predictors; pred++) {
+    for (size_t i = begin; i < end; i++) {
+      counts[pred * max_symbols + tree_samples.Token(pred, i)] +=
+          tree_samples.Count(i);
+      tot_extra_bits[pred] +=
+          tree_samples.NBits(pred, i) * tree_samples.Count(i);
     }
+  }
 
-    float base_bits;
-    {
-      size_t pred = tree_samples.PredictorIndex((*tree)[pos].predictor);
-      base_bits = EstimateBits(counts.data() + pred * max_symbols,
-                               rounded_counts.data(), max_symbols) +
-                  tot_extra_bits[pred];
-    }
-
-    SplitInfo *best = &best_split_nonstatic;
-
-    SplitInfo forced_split;
-    // The multiplier ranges cut halfway through the current ranges of static
-    // properties. We do this even if the current node is not a leaf, to
-    // minimize the number of nodes in the resulting tree.
-    for (size_t i = 0; i < mul_info.size(); i++) {
-      uint32_t axis, val;
-      IntersectionType t =
-          BoxIntersects(static_prop_range, mul_info[i].range, axis, val);
-      if (t == IntersectionType::kNone) continue;
-      if (t == IntersectionType::kInside) {
-        (*tree)[pos].multiplier = mul_info[i].multiplier;
-        break;
-      }
-      if (t == IntersectionType::kPartial) {
-        forced_split.val = tree_samples.QuantizeProperty(axis, val);
-        forced_split.prop = axis;
-        forced_split.lcost = forced_split.rcost = base_bits / 2 - threshold;
-        forced_split.lpred = forced_split.rpred = (*tree)[pos].predictor;
-        best = &forced_split;
-        best->pos = begin;
-        JXL_ASSERT(best->prop == tree_samples.PropertyFromIndex(best->prop));
-        for (size_t x = begin; x < end; x++) {
-          if (tree_samples.Property(best->prop, x) <= best->val) {
-            best->pos++;
-          }
+  if (scratch->rounded_counts.size() < max_symbols) {
+    scratch->rounded_counts.resize(max_symbols);
+  }
+  {
+    size_t pred = tree_samples.PredictorIndex((*tree)[pos].predictor);
+    stats->base_bits = EstimateBits(counts.data() + pred * max_symbols,
+                                    scratch->rounded_counts.data(),
+                                    max_symbols) +
+                       tot_extra_bits[pred];
+  }
+
+  // The multiplier ranges cut halfway through the current ranges of static
+  // properties. We do this even if the current node is not a leaf, to
+  // minimize the number of nodes in the resulting tree.
+  for (size_t i = 0; i < mul_info.size(); i++) {
+    uint32_t axis, val;
+    IntersectionType t =
+        BoxIntersects(node.static_prop_range, mul_info[i].range, axis, val);
+    if (t == IntersectionType::kNone) continue;
+    if (t == IntersectionType::kInside) {
+      (*tree)[pos].multiplier = mul_info[i].multiplier;
+      break;
+    }
+    if (t == IntersectionType::kPartial) {
+      SplitInfo *best = &stats->forced_split;
+      best->val = tree_samples.QuantizeProperty(axis, val);
+      best->prop = axis;
+      best->lcost = best->rcost = stats->base_bits / 2 - threshold;
+      best->lpred = best->rpred = (*tree)[pos].predictor;
+      best->pos = begin;
+      JXL_ASSERT(best->prop == tree_samples.PropertyFromIndex(best->prop));
+      for (size_t x = begin; x < end; x++) {
+        if (tree_samples.Property(best->prop, x) <= best->val) {
+          best->pos++;
         }
-        break;
       }
+      stats->has_forced_split = true;
+      break;
     }
+  }
+}
 
-    if (best != &forced_split) {
-      std::vector<int> prop_value_used_count;
-      std::vector<int> count_increase;
-      std::vector<size_t> extra_bits_increase;
-      // For each property, compute which of its values are used, and what
-      // tokens correspond to those usages. Then, iterate through the values,
-      // and compute the entropy of each side of the split (of the form `prop >
-      // threshold`). Finally, find the split that minimizes the cost.
-      struct CostInfo {
-        float cost = std::numeric_limits<float>::max();
-        float extra_cost = 0;
-        float Cost() const { return cost + extra_cost; }
-        Predictor pred;  // will be uninitialized in some cases, but never used.
-      };
-      std::vector<CostInfo> costs_l;
-      std::vector<CostInfo> costs_r;
-
-      std::vector<int32_t> counts_above(max_symbols);
-      std::vector<int32_t> counts_below(max_symbols);
-
-      // The lower the threshold, the higher the expected noisiness of the
-      // estimate. Thus, discourage changing predictors.
-      float change_pred_penalty = 800.0f / (100.0f + threshold);
-      for (size_t prop = 0; prop < num_properties && base_bits > threshold;
-           prop++) {
-        costs_l.clear();
-        costs_r.clear();
-        size_t prop_size = tree_samples.NumPropertyValues(prop);
-        if (extra_bits_increase.size() < prop_size) {
-          count_increase.resize(prop_size * max_symbols);
-          extra_bits_increase.resize(prop_size);
-        }
-        // Clear prop_value_used_count (which cannot be cleared "on the go")
-        prop_value_used_count.clear();
-        prop_value_used_count.resize(prop_size);
-
-        size_t first_used = prop_size;
-        size_t last_used = 0;
-
-        // TODO(veluca): consider finding multiple splits along a single
-        // property at the same time, possibly with a bottom-up approach.
-        for (size_t i = begin; i < end; i++) {
-          size_t p = tree_samples.Property(prop, i);
-          prop_value_used_count[p]++;
-          last_used = std::max(last_used, p);
-          first_used = std::min(first_used, p);
-        }
-        costs_l.resize(last_used - first_used);
-        costs_r.resize(last_used - first_used);
-        // For all predictors, compute the right and left costs of each split.
-        for (size_t pred = 0; pred < num_predictors; pred++) {
-          // Compute cost and histogram increments for each property value.
-          for (size_t i = begin; i < end; i++) {
-            size_t p = tree_samples.Property(prop, i);
-            size_t cnt = tree_samples.Count(i);
-            size_t sym = tree_samples.Token(pred, i);
-            count_increase[p * max_symbols + sym] += cnt;
-            extra_bits_increase[p] += tree_samples.NBits(pred, i) * cnt;
-          }
-          memcpy(counts_above.data(), counts.data() + pred * max_symbols,
-                 max_symbols * sizeof counts_above[0]);
-          memset(counts_below.data(), 0, max_symbols * sizeof counts_below[0]);
-          size_t extra_bits_below = 0;
-          // Exclude last used: this ensures neither counts_above nor
-          // counts_below is empty.
-          for (size_t i = first_used; i < last_used; i++) {
-            if (!prop_value_used_count[i]) continue;
-            extra_bits_below += extra_bits_increase[i];
-            // The increase for this property value has been used, and will not
-            // be used again: clear it. Also below.
-            extra_bits_increase[i] = 0;
-            for (size_t sym = 0; sym < max_symbols; sym++) {
-              counts_above[sym] -= count_increase[i * max_symbols + sym];
-              counts_below[sym] += count_increase[i * max_symbols + sym];
-              count_increase[i * max_symbols + sym] = 0;
-            }
-            float rcost = EstimateBits(counts_above.data(),
-                                       rounded_counts.data(), max_symbols) +
-                          tot_extra_bits[pred] - extra_bits_below;
-            float lcost = EstimateBits(counts_below.data(),
-                                       rounded_counts.data(), max_symbols) +
-                          extra_bits_below;
-            JXL_DASSERT(extra_bits_below <= tot_extra_bits[pred]);
-            float penalty = 0;
-            // Never discourage moving away from the Weighted predictor.
-            if (tree_samples.PredictorFromIndex(pred) !=
-                    (*tree)[pos].predictor &&
-                (*tree)[pos].predictor != Predictor::Weighted) {
-              penalty = change_pred_penalty;
-            }
-            // If everything else is equal, disfavour Weighted (slower) and
-            // favour Zero (faster if it's the only predictor used in a
-            // group+channel combination)
-            if (tree_samples.PredictorFromIndex(pred) == Predictor::Weighted) {
-              penalty += 1e-8;
-            }
-            if (tree_samples.PredictorFromIndex(pred) == Predictor::Zero) {
-              penalty -= 1e-8;
-            }
-            if (rcost + penalty < costs_r[i - first_used].Cost()) {
-              costs_r[i - first_used].cost = rcost;
-              costs_r[i - first_used].extra_cost = penalty;
-              costs_r[i - first_used].pred =
-                  tree_samples.PredictorFromIndex(pred);
-            }
-            if (lcost + penalty < costs_l[i - first_used].Cost()) {
-              costs_l[i - first_used].cost = lcost;
-              costs_l[i - first_used].extra_cost = penalty;
-              costs_l[i - first_used].pred =
-                  tree_samples.PredictorFromIndex(pred);
-            }
-          }
-        }
-        // Iterate through the possible splits and find the one with minimum sum
-        // of costs of the two sides.
-        size_t split = begin;
-        for (size_t i = first_used; i < last_used; i++) {
-          if (!prop_value_used_count[i]) continue;
-          split += prop_value_used_count[i];
-          float rcost = costs_r[i - first_used].cost;
-          float lcost = costs_l[i - first_used].cost;
-          // WP was not used + we would use the WP property or predictor
-          bool adds_wp =
-              (tree_samples.PropertyFromIndex(prop) == kWPProp &&
-               (used_properties & (1LU << prop)) == 0) ||
-              ((costs_l[i - first_used].pred == Predictor::Weighted ||
-                costs_r[i - first_used].pred == Predictor::Weighted) &&
-               (*tree)[pos].predictor != Predictor::Weighted);
-          bool zero_entropy_side = rcost == 0 || lcost == 0;
-
-          SplitInfo &best =
-              prop < kNumStaticProperties
-                  ? (zero_entropy_side ? best_split_static_constant
-                                       : best_split_static)
-                  : (adds_wp ? best_split_nonstatic : best_split_nowp);
-          if (lcost + rcost < best.Cost()) {
-            best.prop = prop;
-            best.val = i;
-            best.pos = split;
-            best.lcost = lcost;
-            best.lpred = costs_l[i - first_used].pred;
-            best.rcost = rcost;
-            best.rpred = costs_r[i - first_used].pred;
-          }
-        }
-        // Clear extra_bits_increase and cost_increase for last_used.
-        extra_bits_increase[last_used] = 0;
-        for (size_t sym = 0; sym < max_symbols; sym++) {
-          count_increase[last_used * max_symbols + sym] = 0;
-        }
-      }
+// For the given property, compute which of its values are used, and what
+// tokens correspond to those usages. Then, iterate through the values, and
+// compute the entropy of each side of the split (of the form `prop >
+// threshold`). Finally, find the splits that minimize the cost.
+void FindBestSplitsForProperty(const TreeSamples &tree_samples,
+                               const NodeInfo &node, const NodeStats &stats,
+                               size_t prop, float threshold, const Tree &tree,
+                               SplitScratch *scratch, PropertySplits *splits) {
+  const size_t pos = node.pos;
+  const size_t begin = node.begin;
+  const size_t end = node.end;
+  const size_t max_symbols = stats.max_symbols;
+  size_t num_predictors = tree_samples.NumPredictors();
 
-      // Try to avoid introducing WP.
-      if (best_split_nowp.Cost() + threshold < base_bits &&
-          best_split_nowp.Cost() <= fast_decode_multiplier * best->Cost()) {
-        best = &best_split_nowp;
+  std::vector<int32_t> &rounded_counts = scratch->rounded_counts;
+  std::vector<int> &prop_value_used_count = scratch->prop_value_used_count;
+  std::vector<int32_t> &count_increase = scratch->count_increase;
+  std::vector<size_t> &extra_bits_increase = scratch->extra_bits_increase;
+  std::vector<SplitScratch::CostInfo> &costs_l = scratch->costs_l;
+  std::vector<SplitScratch::CostInfo> &costs_r = scratch->costs_r;
+  std::vector<int32_t> &counts_above = scratch->counts_above;
+  std::vector<int32_t> &counts_below = scratch->counts_below;
+  if (rounded_counts.size() < max_symbols) {
+    rounded_counts.resize(max_symbols);
+  }
+  if (counts_above.size() < max_symbols) {
+    counts_above.resize(max_symbols);
+    counts_below.resize(max_symbols);
+  }
+
+  // The lower the threshold, the higher the expected noisiness of the
+  // estimate. Thus, discourage changing predictors.
+  float change_pred_penalty = 800.0f / (100.0f + threshold);
+  costs_l.clear();
+  costs_r.clear();
+  size_t prop_size = tree_samples.NumPropertyValues(prop);
+  if (extra_bits_increase.size() < prop_size) {
+    extra_bits_increase.resize(prop_size);
+  }
+  if (count_increase.size() < prop_size * max_symbols) {
+    count_increase.resize(prop_size * max_symbols);
+  }
+  // Clear prop_value_used_count (which cannot be cleared "on the go")
+  prop_value_used_count.clear();
+  prop_value_used_count.resize(prop_size);
+
+  size_t first_used = prop_size;
+  size_t last_used = 0;
+
+  // TODO(veluca): consider finding multiple splits along a single
+  // property at the same time, possibly with a bottom-up approach.
+  for (size_t i = begin; i < end; i++) {
+    size_t p = tree_samples.Property(prop, i);
+    prop_value_used_count[p]++;
+    last_used = std::max(last_used, p);
+    first_used = std::min(first_used, p);
+  }
+  costs_l.resize(last_used - first_used);
+  costs_r.resize(last_used - first_used);
+  // For all predictors, compute the right and left costs of each split.
+  for (size_t pred = 0; pred < num_predictors; pred++) {
+    // Compute cost and histogram increments for each property value.
+    for (size_t i = begin; i < end; i++) {
+      size_t p = tree_samples.Property(prop, i);
+      size_t cnt = tree_samples.Count(i);
+      size_t sym = tree_samples.Token(pred, i);
+      count_increase[p * max_symbols + sym] += cnt;
+      extra_bits_increase[p] += tree_samples.NBits(pred, i) * cnt;
+    }
+    memcpy(counts_above.data(), stats.counts.data() + pred * max_symbols,
+           max_symbols * sizeof counts_above[0]);
+    memset(counts_below.data(), 0, max_symbols * sizeof counts_below[0]);
+    size_t extra_bits_below = 0;
+    // Exclude last used: this ensures neither counts_above nor
+    // counts_below is empty.
+    for (size_t i = first_used; i < last_used; i++) {
+      if (!prop_value_used_count[i]) continue;
+      extra_bits_below += extra_bits_increase[i];
+      // The increase for this property value has been used, and will not
+      // be used again: clear it. Also below.
+      extra_bits_increase[i] = 0;
+      MoveHistogram(&count_increase[i * max_symbols], counts_above.data(),
+                    counts_below.data(), max_symbols);
+      float rcost = EstimateBits(counts_above.data(), rounded_counts.data(),
+                                 max_symbols) +
+                    stats.tot_extra_bits[pred] - extra_bits_below;
+      float lcost = EstimateBits(counts_below.data(), rounded_counts.data(),
+                                 max_symbols) +
+                    extra_bits_below;
+      JXL_DASSERT(extra_bits_below <= stats.tot_extra_bits[pred]);
+      float penalty = 0;
+      // Never discourage moving away from the Weighted predictor.
+      if (tree_samples.PredictorFromIndex(pred) != tree[pos].predictor &&
+          tree[pos].predictor != Predictor::Weighted) {
+        penalty = change_pred_penalty;
+      }
+      // If everything else is equal, disfavour Weighted (slower) and
+      // favour Zero (faster if it's the only predictor used in a
+      // group+channel combination)
+      if (tree_samples.PredictorFromIndex(pred) == Predictor::Weighted) {
+        penalty += 1e-8;
+      }
+      if (tree_samples.PredictorFromIndex(pred) == Predictor::Zero) {
+        penalty -= 1e-8;
       }
-      // Split along static props if possible and not significantly more
-      // expensive.
-      if (best_split_static.Cost() + threshold < base_bits &&
-          best_split_static.Cost() <= fast_decode_multiplier * best->Cost()) {
-        best = &best_split_static;
+      if (rcost + penalty < costs_r[i - first_used].Cost()) {
+        costs_r[i - first_used].cost = rcost;
+        costs_r[i - first_used].extra_cost = penalty;
+        costs_r[i - first_used].pred = tree_samples.PredictorFromIndex(pred);
       }
-      // Split along static props to create constant nodes if possible.
-      if (best_split_static_constant.Cost() + threshold < base_bits) {
-        best = &best_split_static_constant;
+      if (lcost + penalty < costs_l[i - first_used].Cost()) {
+        costs_l[i - first_used].cost = lcost;
+        costs_l[i - first_used].extra_cost = penalty;
+        costs_l[i - first_used].pred = tree_samples.PredictorFromIndex(pred);
       }
     }
+  }
+  // Iterate through the possible splits and find the one with minimum sum
+  // of costs of the two sides.
+  size_t split = begin;
+  for (size_t i = first_used; i < last_used; i++) {
+    if (!prop_value_used_count[i]) continue;
+    split += prop_value_used_count[i];
+    float rcost = costs_r[i - first_used].cost;
+    float lcost = costs_l[i - first_used].cost;
+    // WP was not used + we would use the WP property or predictor
+    bool adds_wp =
+        (tree_samples.PropertyFromIndex(prop) == kWPProp &&
+         (node.used_properties & (1LU << prop)) == 0) ||
+        ((costs_l[i - first_used].pred == Predictor::Weighted ||
+          costs_r[i - first_used].pred == Predictor::Weighted) &&
+         tree[pos].predictor != Predictor::Weighted);
+    bool zero_entropy_side = rcost == 0 || lcost == 0;
+
+    SplitInfo &best =
+        prop < kNumStaticProperties
+            ? (zero_entropy_side ? splits->static_constant : splits->static_)
+            : (adds_wp ? splits->nonstatic : splits->nowp);
+    if (lcost + rcost < best.Cost()) {
+      best.prop = prop;
+      best.val = i;
+      best.pos = split;
+      best.lcost = lcost;
+      best.lpred = costs_l[i - first_used].pred;
+      best.rcost = rcost;
+      best.rpred = costs_r[i - first_used].pred;
+    }
+  }
+  // Clear extra_bits_increase and cost_increase for last_used.
+  extra_bits_increase[last_used] = 0;
+  for (size_t sym = 0; sym < max_symbols; sym++) {
+    count_increase[last_used * max_symbols + sym] = 0;
+  }
+}
+
+// Combines the best splits along each property of a node into the split to
+// be done. Ties are resolved in favour of the lowest property index.
+SplitInfo ChooseSplit(const NodeStats &stats, const PropertySplits *splits,
+                      size_t num_properties, float threshold,
+                      float fast_decode_multiplier) {
+  if (stats.has_forced_split) return stats.forced_split;
+  PropertySplits best_splits;
+  const auto update = [](const SplitInfo &split, SplitInfo *best) {
+    if (split.Cost() < best->Cost()) *best = split;
+  };
+  for (size_t prop = 0; prop < num_properties; prop++) {
+    update(splits[prop].static_constant, &best_splits.static_constant);
+    update(splits[prop].static_, &best_splits.static_);
+    update(splits[prop].nonstatic, &best_splits.nonstatic);
+    update(splits[prop].nowp, &best_splits.nowp);
+  }
+  const float base_bits = stats.base_bits;
+  SplitInfo *best = &best_splits.nonstatic;
+  // Try to avoid introducing WP.
+  if (best_splits.nowp.Cost() + threshold < base_bits &&
+      best_splits.nowp.Cost() <= fast_decode_multiplier * best->Cost()) {
+    best = &best_splits.nowp;
+  }
+  // Split along static props if possible and not significantly more
+  // expensive.
+  if (best_splits.static_.Cost() + threshold < base_bits &&
+      best_splits.static_.Cost() <= fast_decode_multiplier * best->Cost()) {
+    best = &best_splits.static_;
+  }
+  // Split along static props to create constant nodes if possible.
+  if (best_splits.static_constant.Cost() + threshold < base_bits) {
+    best = &best_splits.static_constant;
+  }
+  return *best;
+}
+
+// The tree is grown one level at a time: the splits of all the nodes of a
+// level are evaluated concurrently, one task per node and property. Since the
+// split of a node only depends on its own samples, and the trees are encoded
+// in breadth-first order, the result does not depend on the number of threads.
+void FindBestSplit(TreeSamples &tree_samples, float threshold,
+                   const std::vector<ModularMultiplierInfo> &mul_info,
+                   StaticPropRange initial_static_prop_range,
+                   float fast_decode_multiplier, ThreadPool *pool,
+                   Tree *tree) {
+  std::vector<NodeInfo> nodes;
+  nodes.push_back(NodeInfo{0, 0, tree_samples.NumDistinctSamples(), 0,
+                           initial_static_prop_range});
+
+  size_t num_properties = tree_samples.NumProperties();
 
-    if (best->Cost() + threshold < base_bits) {
-      uint32_t p = tree_samples.PropertyFromIndex(best->prop);
-      pixel_type dequant =
-          tree_samples.UnquantizeProperty(best->prop, best->val);
+  std::vector<SplitScratch> scratch;
+  const auto init_scratch = [&](size_t num_threads) {
+    if (scratch.size() < num_threads) scratch.resize(num_threads);
+    return true;
+  };
+  std::vector<NodeStats> stats;
+  std::vector<PropertySplits> splits;
+  std::vector<NodeInfo> next_nodes;
+  // Sample ranges [begin, end) to be reordered so that the samples of the left
+  // child come first, and the property that decides the side of each sample.
+  struct SamplesSplit {
+    size_t begin;
+    size_t pos;
+    size_t end;
+    size_t prop;
+  };
+  std::vector<SamplesSplit> samples_splits;
+  while (!nodes.empty()) {
+    stats.clear();
+    stats.resize(nodes.size());
+    JXL_CHECK(RunOnPool(
+        pool, 0, nodes.size(), init_scratch,
+        [&](const uint32_t i, size_t thread) {
+          if (nodes[i].begin == nodes[i].end) return;
+          ComputeNodeStats(tree_samples, nodes[i], threshold, mul_info,
+                           &scratch[thread], tree, &stats[i]);
+        },
+        "ComputeNodeStats"));
+
+    splits.clear();
+    splits.resize(nodes.size() * num_properties);
+    JXL_CHECK(RunOnPool(
+        pool, 0, nodes.size() * num_properties, init_scratch,
+        [&](const uint32_t task, size_t thread) {
+          const size_t i = task / num_properties;
+          const size_t prop = task % num_properties;
+          if (nodes[i].begin == nodes[i].end || stats[i].has_forced_split ||
+              stats[i].base_bits <= threshold) {
+            return;
+          }
+          FindBestSplitsForProperty(tree_samples, nodes[i], stats[i], prop,
+                                    threshold, *tree, &scratch[thread],
+                                    &splits[task]);
+        },
+        "FindBestSplits"));
+
+    next_nodes.clear();
+    samples_splits.clear();
+    for (size_t i = 0; i < nodes.size(); i++) {
+      const NodeInfo &node = nodes[i];
+      if (node.begin == node.end) continue;
+      const SplitInfo best =
+          ChooseSplit(stats[i], &splits[i * num_properties], num_properties,
+                      threshold, fast_decode_multiplier);
+      if (best.Cost() + threshold >= stats[i].base_bits) continue;
+      const size_t pos = node.pos;
+      uint64_t used_properties = node.used_properties;
+      const StaticPropRange &static_prop_range = node.static_prop_range;
+      uint32_t p = tree_samples.PropertyFromIndex(best.prop);
+      pixel_type dequant = tree_samples.UnquantizeProperty(best.prop, best.val);
       // Split node and try to split children.
-      MakeSplitNode(pos, p, dequant, best->lpred, 0, best->rpred, 0, tree);
-      // "Sort" according to winning property
-      SplitTreeSamples(tree_samples, begin, best->pos, end, best->prop);
+      MakeSplitNode(pos, p, dequant, best.lpred, 0, best.rpred, 0, tree);
+      // "Sort" according to winning property, see below.
+      samples_splits.push_back(
+          SamplesSplit{node.begin, best.pos, node.end, best.prop});
       if (p >= kNumStaticProperties) {
-        used_properties |= 1 << best->prop;
+        used_properties |= 1 << best.prop;
       }
       auto new_sp_range = static_prop_range;
       if (p < kNumStaticProperties) {
@@ -463,17 +601,29 @@ void FindBestSplit(TreeSamples &tree_samples, float threshold,
         new_sp_range[p][1] = dequant + 1;
         JXL_ASSERT(new_sp_range[p][0] < new_sp_range[p][1]);
       }
-      nodes.push_back(NodeInfo{(*tree)[pos].rchild, begin, best->pos,
-                               used_properties, new_sp_range});
+      next_nodes.push_back(NodeInfo{(*tree)[pos].rchild, node.begin, best.pos,
+                                    used_properties, new_sp_range});
       new_sp_range = static_prop_range;
       if (p < kNumStaticProperties) {
         JXL_ASSERT(new_sp_range[p][0] <= static_cast<uint32_t>(dequant + 1));
         new_sp_range[p][0] = dequant + 1;
         JXL_ASSERT(new_sp_range[p][0] < new_sp_range[p][1]);
       }
-      nodes.push_back(NodeInfo{(*tree)[pos].lchild, best->pos, end,
-                               used_properties, new_sp_range});
+      next_nodes.push_back(NodeInfo{(*tree)[pos].lchild, best.pos, node.end,
+                                    used_properties, new_sp_range});
     }
+
+    // The sample ranges of the nodes are disjoint, so they can be reordered
+    // concurrently.
+    JXL_CHECK(RunOnPool(
+        pool, 0, samples_splits.size(), ThreadPool::NoInit,
+        [&](const uint32_t i, size_t /* thread */) {
+          const SamplesSplit &split = samples_splits[i];
+          SplitTreeSamples(tree_samples, split.begin, split.pos, split.end,
+                           split.prop);
+        },
+        "SplitTreeSamples"));
+    nodes.swap(next_nodes);
   }
 }
 
@@ -490,7 +640,8 @@ HWY_EXPORT(FindBestSplit);  // Local function.
 void ComputeBestTree(TreeSamples &tree_samples, float threshold,
                      const std::vector<ModularMultiplierInfo> &mul_info,
                      StaticPropRange static_prop_range,
-                     float fast_decode_multiplier, Tree *tree) {
+                     float fast_decode_multiplier, ThreadPool *pool,
+                     Tree *tree) {
   // TODO(veluca): take into account that different contexts can have different
   // uint configs.
   //
@@ -506,7 +657,7 @@ void ComputeBestTree(TreeSamples &tree_samples, float threshold,
              std::numeric_limits<uint32_t>::max());
   HWY_DYNAMIC_DISPATCH(FindBestSplit)
   (tree_samples, threshold, mul_info, static_prop_range, fast_decode_multiplier,
-   tree);
+   pool, tree);
 }
 
 constexpr int32_t TreeSamples::kPropertyRange;
@@ -0,0 +1,117 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <cmath>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "lib/extras/codec.h"
+#include "lib/jxl/base/random.h"
+#include "lib/jxl/modular/encoding/enc_encoding.h"
+#include "lib/jxl/modular/encoding/enc_ma.h"
+#include "lib/jxl/modular/modular_image.h"
+#include "lib/jxl/modular/options.h"
+#include "lib/jxl/testdata.h"
+
+namespace jxl {
+namespace {
+
+constexpr size_t kSize = 512;
+
+// Returns a 3-channel 8-bit image with smooth gradients, noise and a few flat
+// areas.
+Image SyntheticImage() {
+  Image image(kSize, kSize, 8, 3);
+  Rng rng(0);
+  for (size_t c = 0; c < 3; ++c) {
+    Channel& ch = image.channel[c];
+    for (size_t y = 0; y < kSize; ++y) {
+      pixel_type* JXL_RESTRICT row = ch.Row(y);
+      for (size_t x = 0; x < kSize; ++x) {
+        if ((x / 64 + y / 64 + c) % 5 == 0) {
+          row[x] = 40 * c;
+        } else {
+          row[x] = ((x + 2 * y) / 4 + 30 * c + rng.UniformU(0, 8)) & 0xff;
+        }
+      }
+    }
+  }
+  return image;
+}
+
+// Returns a crop of a photo, as a 3-channel 8-bit image.
+Image PhotoImage() {
+  CodecInOut io;
+  const PaddedBytes orig = ReadTestData("jxl/flower/flower.png");
+  JXL_CHECK(SetFromBytes(Span<const uint8_t>(orig), &io));
+  io.ShrinkTo(kSize, kSize);
+  Image image(kSize, kSize, 8, 3);
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 0; y < kSize; ++y) {
+      const float* JXL_RESTRICT row_in = io.Main().color()->ConstPlaneRow(c, y);
+      pixel_type* JXL_RESTRICT row = image.channel[c].Row(y);
+      for (size_t x = 0; x < kSize; ++x) {
+        row[x] = std::lround(row_in[x] * 255.0f);
+      }
+    }
+  }
+  return image;
+}
+
+// Collects the tree learning samples of the image in the same way as the
+// modular frame encoder does for a global tree.
+TreeSamples CollectTreeSamples(Image& image, const ModularOptions& options,
+                               size_t* total_pixels) {
+  TreeSamples tree_samples;
+  JXL_CHECK(tree_samples.SetPredictor(options.predictor, options.wp_tree_mode));
+  JXL_CHECK(tree_samples.SetProperties(options.splitting_heuristics_properties,
+                                       options.wp_tree_mode));
+  std::vector<pixel_type> pixel_samples;
+  std::vector<pixel_type> diff_samples;
+  std::vector<uint32_t> group_pixel_count;
+  std::vector<uint32_t> channel_pixel_count;
+  CollectPixelSamples(image, options, 0, group_pixel_count,
+                      channel_pixel_count, pixel_samples, diff_samples);
+  StaticPropRange range;
+  range[0] = {{0, static_cast<uint32_t>(image.channel.size())}};
+  range[1] = {{0, 1}};
+  tree_samples.PreQuantizeProperties(
+      range, /*multiplier_info=*/{}, group_pixel_count, channel_pixel_count,
+      pixel_samples, diff_samples, options.max_property_values);
+  JXL_CHECK(ModularGenericCompress(image, options, /*writer=*/nullptr,
+                                   /*aux_out=*/nullptr, 0, 0, &tree_samples,
+                                   total_pixels));
+  return tree_samples;
+}
+
+// Measures the MA tree learning with all the predictors and properties, as in
+// the slowest lossless encoder settings.
+void BM_LearnTree(benchmark::State& state) {
+  const bool photo = state.range(0);
+  Image image = photo ? PhotoImage() : SyntheticImage();
+  ModularOptions options;
+  options.predictor = Predictor::Variable;
+  options.splitting_heuristics_properties = {0, 1, 15, 9,  10, 11, 12, 13,
+                                             14, 2, 3,  4, 5,  6,  7,  8};
+  options.max_property_values = 256;
+  size_t total_pixels = 0;
+  const TreeSamples tree_samples =
+      CollectTreeSamples(image, options, &total_pixels);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    TreeSamples samples = tree_samples;
+    state.ResumeTiming();
+    Tree tree = LearnTree(std::move(samples), total_pixels, options);
+    benchmark::DoNotOptimize(tree.size());
+  }
+  state.SetItemsProcessed(state.iterations() * tree_samples.NumSamples());
+  state.counters["distinct_samples"] = tree_samples.NumDistinctSamples();
+}
+
+BENCHMARK(BM_LearnTree)->ArgName("photo")->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace jxl
@@ -5,6 +5,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <array>
 #include <string>
@@ -74,6 +75,62 @@ TEST(ModularTest, JXL_TSAN_SLOW_TEST(RoundtripLosslessGroups1024)) {
   TestLosslessGroups(3);
 }
 
+TEST(ModularTest, LearnedTreeDoesNotDependOnThreadCount) {
+  const PaddedBytes orig = ReadTestData("jxl/flower/flower.png");
+  CodecInOut io;
+  ASSERT_TRUE(SetFromBytes(Span<const uint8_t>(orig), &io));
+  io.ShrinkTo(256, 256);
+  CompressParams cparams;
+  cparams.SetLossless();
+  cparams.speed_tier = SpeedTier::kTortoise;
+
+  PaddedBytes compressed_serial;
+  PassesEncoderState enc_state_serial;
+  ASSERT_TRUE(EncodeFile(cparams, &io, &enc_state_serial, &compressed_serial,
+                         GetJxlCms(), /*aux_out=*/nullptr, /*pool=*/nullptr));
+  ThreadPoolInternal pool(8);
+  PaddedBytes compressed_parallel;
+  PassesEncoderState enc_state_parallel;
+  ASSERT_TRUE(EncodeFile(cparams, &io, &enc_state_parallel,
+                         &compressed_parallel, GetJxlCms(),
+                         /*aux_out=*/nullptr, &pool));
+  ASSERT_EQ(compressed_serial.size(), compressed_parallel.size());
+  EXPECT_EQ(0, memcmp(compressed_serial.data(), compressed_parallel.data(),
+                      compressed_serial.size()));
+}
+
+TEST(ModularTest, BoundedTokenMemory) {
+  const PaddedBytes orig = ReadTestData("jxl/flower/flower.png");
+  CodecInOut io;
+  ASSERT_TRUE(SetFromBytes(Span<const uint8_t>(orig), &io));
+  io.ShrinkTo(300, 300);
+  ThreadPoolInternal pool(8);
+  // At this speed, the histogram parameters do not depend on all the tokens,
+  // so bounding the token memory does not change the codestream.
+  CompressParams cparams;
+  cparams.SetLossless();
+  cparams.speed_tier = SpeedTier::kCheetah;
+  PaddedBytes compressed;
+  PassesEncoderState enc_state;
+  ASSERT_TRUE(EncodeFile(cparams, &io, &enc_state, &compressed, GetJxlCms(),
+                         /*aux_out=*/nullptr, &pool));
+  cparams.bounded_token_memory = true;
+  PaddedBytes compressed_bounded;
+  PassesEncoderState enc_state_bounded;
+  ASSERT_TRUE(EncodeFile(cparams, &io, &enc_state_bounded,
+                         &compressed_bounded, GetJxlCms(),
+                         /*aux_out=*/nullptr, &pool));
+  ASSERT_EQ(compressed.size(), compressed_bounded.size());
+  EXPECT_EQ(0, memcmp(compressed.data(), compressed_bounded.data(),
+                      compressed.size()));
+
+  // Otherwise, LZ77 and the hybrid uint search are disabled.
+  cparams.speed_tier = SpeedTier::kSquirrel;
+  CodecInOut io_out;
+  Roundtrip(&io, cparams, {}, &pool, &io_out);
+  EXPECT_TRUE(SamePixels(*io.Main().color(), *io_out.Main().color()));
+}
+
 TEST(ModularTest, RoundtripLosslessCustomWP_PermuteRCT) {
   ThreadPool* pool = nullptr;
   const PaddedBytes orig =
@@ -239,7 +239,8 @@ class ConvolveNoiseStage : public RenderPipelineStage {
                   size_t thread_id) const final {
     PROFILER_ZONE("Noise convolve");
 
-    const HWY_FULL(float) d;
+    using DF = HWY_FULL(float);
+    const DF d;
     for (size_t c = first_c_; c < first_c_ + 3; c++) {
       float* JXL_RESTRICT rows[5];
       for (size_t i = 0; i < 5; i++) {
@@ -249,20 +250,20 @@ class ConvolveNoiseStage : public RenderPipelineStage {
       for (ssize_t x = -RoundUpTo(xextra, Lanes(d));
            x < (ssize_t)(xsize + xextra); x += Lanes(d)) {
         const auto p00 = LoadU(d, rows[2] + x);
-        auto others = Zero(d);
-        // TODO(eustas): sum loaded values to reduce the calculation chain
+        // Sum each of the 5 columns of the window with a balanced tree, then
+        // the column sums, which keeps the dependency chains short.
+        Vec<DF> cols[5];
         for (ssize_t i = -2; i <= 2; i++) {
-          others = Add(others, LoadU(d, rows[0] + x + i));
-          others = Add(others, LoadU(d, rows[1] + x + i));
-          others = Add(others, LoadU(d, rows[3] + x + i));
-          others = Add(others, LoadU(d, rows[4] + x + i));
+          const auto r01 = Add(LoadU(d, rows[0] + x + i),
+                               LoadU(d, rows[1] + x + i));
+          const auto r34 = Add(LoadU(d, rows[3] + x + i),
+                               LoadU(d, rows[4] + x + i));
+          cols[i + 2] = Add(Add(r01, r34), LoadU(d, rows[2] + x + i));
         }
-        others = Add(others, LoadU(d, rows[2] + x - 2));
-        others = Add(others, LoadU(d, rows[2] + x - 1));
-        others = Add(others, LoadU(d, rows[2] + x + 1));
-        others = Add(others, LoadU(d, rows[2] + x + 2));
-        // 4 * (1 - box kernel)
-        auto pixels = MulAdd(others, Set(d, 0.16), Mul(p00, Set(d, -3.84)));
+        const auto box = Add(Add(Add(cols[0], cols[1]), Add(cols[3], cols[4])),
+                             cols[2]);
+        // 4 * (1 - box kernel); the box sum includes p00, hence the -4.
+        auto pixels = MulAdd(box, Set(d, 0.16f), Mul(p00, Set(d, -4.0f)));
         StoreU(pixels, d, row_out + x);
       }
     }
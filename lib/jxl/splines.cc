@@ -168,14 +168,25 @@ void DrawSegments(float* JXL_RESTRICT row_x, float* JXL_RESTRICT row_y,
                   float* JXL_RESTRICT row_b, const Rect& image_rect,
                   const bool add, const SplineSegment* segments,
                   const size_t* segment_indices,
-                  const size_t* segment_y_start) {
+                  const size_t* segment_y_start,
+                  const float* segment_y_max_distance) {
   JXL_ASSERT(image_rect.ysize() == 1);
   float* JXL_RESTRICT rows[3] = {row_x - image_rect.x0(),
                                  row_y - image_rect.x0(),
                                  row_b - image_rect.x0()};
   size_t y = image_rect.y0();
-  for (size_t i = segment_y_start[y]; i < segment_y_start[y + 1]; i++) {
-    DrawSegment(segments[segment_indices[i]], add, y, image_rect.x0(),
+  // Segments of each row are sorted by center_x, so only the ones that can
+  // reach [x0, x1) need to be visited. The margin matches the rounding in
+  // DrawSegment.
+  const float margin = segment_y_max_distance[y] + 1.5f;
+  const float x_begin = image_rect.x0() - margin;
+  const float x_end = image_rect.x0() + image_rect.xsize() + margin;
+  const size_t* end = segment_indices + segment_y_start[y + 1];
+  const size_t* it = std::lower_bound(
+      segment_indices + segment_y_start[y], end, x_begin,
+      [segments](size_t i, float x) { return segments[i].center_x < x; });
+  for (; it != end && segments[*it].center_x < x_end; ++it) {
+    DrawSegment(segments[*it], add, y, image_rect.x0(),
                 image_rect.x0() + image_rect.xsize(), rows);
   }
 }
@@ -538,6 +549,7 @@ void Splines::Clear() {
   segments_.clear();
   segment_indices_.clear();
   segment_y_start_.clear();
+  segment_y_max_distance_.clear();
 }
 
 Status Splines::Decode(jxl::BitReader* br, const size_t num_pixels) {
@@ -599,6 +611,7 @@ Status Splines::InitializeDrawCache(const size_t image_xsize,
   segments_.clear();
   segment_indices_.clear();
   segment_y_start_.clear();
+  segment_y_max_distance_.clear();
   std::vector<std::pair<size_t, size_t>> segments_by_y;
   Spline spline;
   float pixel_limit = 16.0f * image_xsize * image_ysize + (1 << 16);
@@ -659,15 +672,29 @@ Status Splines::InitializeDrawCache(const size_t image_xsize,
     return JXL_FAILURE("Too large total_estimated_area_reached: %" PRIu64,
                        total_estimated_area_reached);
   }
+  // Order the segments of each row by center_x, so that rendering a part of a
+  // row only needs to visit the segments around it.
   // TODO(eustas): consider linear sorting here.
-  std::sort(segments_by_y.begin(), segments_by_y.end());
+  std::sort(segments_by_y.begin(), segments_by_y.end(),
+            [this](const std::pair<size_t, size_t>& a,
+                   const std::pair<size_t, size_t>& b) {
+              if (a.first != b.first) return a.first < b.first;
+              const float ax = segments_[a.second].center_x;
+              const float bx = segments_[b.second].center_x;
+              if (ax != bx) return ax < bx;
+              return a.second < b.second;
+            });
   segment_indices_.resize(segments_by_y.size());
   segment_y_start_.resize(image_ysize + 1);
+  segment_y_max_distance_.resize(image_ysize);
   for (size_t i = 0; i < segments_by_y.size(); i++) {
     segment_indices_[i] = segments_by_y[i].second;
     size_t y = segments_by_y[i].first;
     if (y < image_ysize) {
       segment_y_start_[y + 1]++;
+      segment_y_max_distance_[y] =
+          std::max(segment_y_max_distance_[y],
+                   segments_[segments_by_y[i].second].maximum_distance);
     }
   }
   for (size_t y = 0; y < image_ysize; y++) {
@@ -685,7 +712,8 @@ void Splines::ApplyToRow(float* JXL_RESTRICT row_x, float* JXL_RESTRICT row_y,
   for (size_t iy = 0; iy < image_row.ysize(); iy++) {
     HWY_DYNAMIC_DISPATCH(DrawSegments)
     (row_x, row_y, row_b, image_row.Line(iy), add, segments_.data(),
-     segment_indices_.data(), segment_y_start_.data());
+     segment_indices_.data(), segment_y_start_.data(),
+     segment_y_max_distance_.data());
   }
 }
 
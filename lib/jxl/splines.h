@@ -141,6 +141,8 @@ class Splines {
   std::vector<SplineSegment> segments_;
   std::vector<size_t> segment_indices_;
   std::vector<size_t> segment_y_start_;
+  // Largest maximum_distance among the segments of each row.
+  std::vector<float> segment_y_max_distance_;
 };
 
 }  // namespace jxl
@@ -48,5 +48,50 @@ void BM_Splines(benchmark::State& state) {
 
 BENCHMARK(BM_Splines)->Range(1, 1 << 10);
 
+// Renders many small splines spread over a wide image in group-sized row
+// chunks, as the render pipeline does. The cost should depend on the local
+// spline density rather than on the total number of segments.
+void BM_SplinesRows(benchmark::State& state) {
+  const size_t n = state.range();
+  constexpr size_t kXSize = 4096;
+  constexpr size_t kYSize = 64;
+  constexpr size_t kChunk = 256;
+
+  std::vector<QuantizedSpline> quantized_splines;
+  std::vector<Spline::Point> starting_points;
+  for (size_t i = 0; i < n; ++i) {
+    const float x = (i * kXSize) / n;
+    const float y = 8 + (i * 7) % (kYSize - 16);
+    Spline spline{
+        /*control_points=*/{{x, y}, {x + 6, y + 4}, {x + 12, y - 3}},
+        /*color_dct=*/
+        {{0.03125f, 0.00625f, 0.003125f}, {1.f, 0.321875f}, {1.f, 0.24375f}},
+        /*sigma_dct=*/{0.3125f, 0.f, 0.f, 0.0625f}};
+    quantized_splines.emplace_back(spline, kQuantizationAdjustment, kYToX,
+                                   kYToB);
+    starting_points.push_back(spline.control_points.front());
+  }
+  Splines splines(kQuantizationAdjustment, std::move(quantized_splines),
+                  std::move(starting_points));
+  JXL_CHECK(splines.InitializeDrawCache(kXSize, kYSize, *cmap));
+
+  Image3F drawing_area(kXSize, kYSize);
+  ZeroFillImage(&drawing_area);
+  for (auto _ : state) {
+    for (size_t y = 0; y < kYSize; ++y) {
+      for (size_t x = 0; x < kXSize; x += kChunk) {
+        splines.AddToRow(drawing_area.PlaneRow(0, y) + x,
+                         drawing_area.PlaneRow(1, y) + x,
+                         drawing_area.PlaneRow(2, y) + x,
+                         Rect(x, y, kChunk, 1));
+      }
+    }
+  }
+
+  state.SetItemsProcessed(kXSize * kYSize * state.iterations());
+}
+
+BENCHMARK(BM_SplinesRows)->Range(16, 1 << 12);
+
 }  // namespace
 }  // namespace jxl
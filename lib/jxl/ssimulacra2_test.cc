@@ -0,0 +1,280 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include "jxl/ssimulacra2.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "jxl/ssimulacra2_cxx.h"
+#include "jxl/thread_parallel_runner_cxx.h"
+#include "lib/jxl/base/thread_pool_internal.h"
+#include "lib/jxl/color_encoding_internal.h"
+#include "lib/jxl/enc_color_management.h"
+#include "lib/jxl/enc_ssimulacra2.h"
+#include "lib/jxl/enc_xyb.h"
+#include "lib/jxl/gauss_blur.h"
+#include "lib/jxl/image.h"
+#include "lib/jxl/image_bundle.h"
+#include "lib/jxl/image_ops.h"
+#include "lib/jxl/image_test_utils.h"
+#include "lib/jxl/test_utils.h"
+
+namespace jxl {
+namespace {
+
+// Scalar implementation of the former tools/ssimulacra2.cc, which the
+// vectorized and parallel one must match up to rounding. Only for images
+// without alpha in linear sRGB.
+double TheFourth(double x) {
+  x *= x;
+  return x * x;
+}
+
+Image3F ScalarDownsample2x(const Image3F& in) {
+  Image3F out((in.xsize() + 1) / 2, (in.ysize() + 1) / 2);
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t oy = 0; oy < out.ysize(); ++oy) {
+      for (size_t ox = 0; ox < out.xsize(); ++ox) {
+        float sum = 0.0f;
+        for (size_t iy = 0; iy < 2; ++iy) {
+          for (size_t ix = 0; ix < 2; ++ix) {
+            const size_t x = std::min(ox * 2 + ix, in.xsize() - 1);
+            const size_t y = std::min(oy * 2 + iy, in.ysize() - 1);
+            sum += in.ConstPlaneRow(c, y)[x];
+          }
+        }
+        out.PlaneRow(c, oy)[ox] = sum * 0.25f;
+      }
+    }
+  }
+  return out;
+}
+
+Image3F ScalarPositiveXYB(const Image3F& linear_srgb) {
+  ImageMetadata metadata;
+  ImageBundle ib(&metadata);
+  ib.SetFromImage(CopyImage(linear_srgb), ColorEncoding::LinearSRGB());
+  Image3F xyb(linear_srgb.xsize(), linear_srgb.ysize());
+  ToXYB(ib, nullptr, &xyb, GetJxlCms(), nullptr);
+  for (size_t y = 0; y < xyb.ysize(); ++y) {
+    float* JXL_RESTRICT row_x = xyb.PlaneRow(0, y);
+    float* JXL_RESTRICT row_y = xyb.PlaneRow(1, y);
+    float* JXL_RESTRICT row_b = xyb.PlaneRow(2, y);
+    for (size_t x = 0; x < xyb.xsize(); ++x) {
+      row_b[x] += 1.1f - row_y[x];
+      row_x[x] += 0.5f;
+      row_y[x] += 0.05f;
+    }
+  }
+  return xyb;
+}
+
+ImageF ScalarBlur(const ImageF& in) {
+  ImageF temp(in.xsize(), in.ysize());
+  ImageF out(in.xsize(), in.ysize());
+  FastGaussian(CreateRecursiveGaussian(1.5), in, nullptr, &temp, &out);
+  return out;
+}
+
+ImageF ScalarMultiply(const ImageF& a, const ImageF& b) {
+  ImageF out(a.xsize(), a.ysize());
+  for (size_t y = 0; y < a.ysize(); ++y) {
+    for (size_t x = 0; x < a.xsize(); ++x) {
+      out.Row(y)[x] = a.ConstRow(y)[x] * b.ConstRow(y)[x];
+    }
+  }
+  return out;
+}
+
+void ScalarChannelScores(const ImageF& img1, const ImageF& img2,
+                         double* avg_ssim, double* avg_edgediff) {
+  const ImageF mu1 = ScalarBlur(img1);
+  const ImageF mu2 = ScalarBlur(img2);
+  const ImageF sigma1_sq = ScalarBlur(ScalarMultiply(img1, img1));
+  const ImageF sigma2_sq = ScalarBlur(ScalarMultiply(img2, img2));
+  const ImageF sigma12 = ScalarBlur(ScalarMultiply(img1, img2));
+  const double one_per_pixels = 1.0 / (img1.xsize() * img1.ysize());
+  double ssim_sums[2] = {0.0};
+  double edge_sums[4] = {0.0};
+  for (size_t y = 0; y < img1.ysize(); ++y) {
+    for (size_t x = 0; x < img1.xsize(); ++x) {
+      const float m1 = mu1.ConstRow(y)[x];
+      const float m2 = mu2.ConstRow(y)[x];
+      const float num_m = 1.0 - (m1 - m2) * (m1 - m2);
+      const float num_s = 2 * (sigma12.ConstRow(y)[x] - m1 * m2) + 0.0009f;
+      const float denom_s = (sigma1_sq.ConstRow(y)[x] - m1 * m1) +
+                            (sigma2_sq.ConstRow(y)[x] - m2 * m2) + 0.0009f;
+      const double ssim = std::max(1.0 - (num_m * num_s) / denom_s, 0.0);
+      ssim_sums[0] += ssim;
+      ssim_sums[1] += TheFourth(ssim);
+      const double d1 = (1.0 + std::abs(img2.ConstRow(y)[x] - m2)) /
+                            (1.0 + std::abs(img1.ConstRow(y)[x] - m1)) -
+                        1.0;
+      const double artifact = std::max(d1, 0.0);
+      const double detail_lost = std::max(-d1, 0.0);
+      edge_sums[0] += artifact;
+      edge_sums[1] += TheFourth(artifact);
+      edge_sums[2] += detail_lost;
+      edge_sums[3] += TheFourth(detail_lost);
+    }
+  }
+  avg_ssim[0] = one_per_pixels * ssim_sums[0];
+  avg_ssim[1] = std::sqrt(std::sqrt(one_per_pixels * ssim_sums[1]));
+  for (size_t i = 0; i < 4; i += 2) {
+    avg_edgediff[i] = one_per_pixels * edge_sums[i];
+    avg_edgediff[i + 1] =
+        std::sqrt(std::sqrt(one_per_pixels * edge_sums[i + 1]));
+  }
+}
+
+Msssim ScalarSSIMULACRA2(const Image3F& orig, const Image3F& dist) {
+  Msssim msssim;
+  Image3F linear1 = CopyImage(orig);
+  Image3F linear2 = CopyImage(dist);
+  for (int scale = 0; scale < 6; ++scale) {
+    if (linear1.xsize() < 8 || linear1.ysize() < 8) break;
+    if (scale) {
+      linear1 = ScalarDownsample2x(linear1);
+      linear2 = ScalarDownsample2x(linear2);
+    }
+    const Image3F img1 = ScalarPositiveXYB(linear1);
+    const Image3F img2 = ScalarPositiveXYB(linear2);
+    MsssimScale sscale;
+    for (size_t c = 0; c < 3; ++c) {
+      ScalarChannelScores(img1.Plane(c), img2.Plane(c),
+                          &sscale.avg_ssim[c * 2], &sscale.avg_edgediff[c * 4]);
+    }
+    msssim.scales.push_back(sscale);
+  }
+  return msssim;
+}
+
+TEST(Ssimulacra2Test, ThreadPoolDoesNotChangeScores) {
+  const size_t xsize = 263;
+  const size_t ysize = 197;
+  Image3F orig(xsize, ysize);
+  RandomFillImage(&orig, 0.0f, 1.0f, 123);
+  Image3F dist = CopyImage(orig);
+  Image3F noise(xsize, ysize);
+  RandomFillImage(&noise, -0.02f, 0.02f, 456);
+  AddTo(noise, &dist);
+
+  ImageMetadata metadata;
+  ImageBundle orig_ib(&metadata);
+  orig_ib.SetFromImage(std::move(orig), ColorEncoding::SRGB());
+  ImageBundle dist_ib(&metadata);
+  dist_ib.SetFromImage(std::move(dist), ColorEncoding::SRGB());
+
+  const Msssim expected = ComputeSSIMULACRA2(orig_ib, dist_ib, 0.5f);
+  // The smallest scale is 9x7, downsampled from 17x13.
+  ASSERT_EQ(6u, expected.scales.size());
+  ThreadPoolInternal pool(4);
+  const Msssim actual = ComputeSSIMULACRA2(orig_ib, dist_ib, 0.5f, &pool);
+  ASSERT_EQ(expected.scales.size(), actual.scales.size());
+  for (size_t i = 0; i < expected.scales.size(); ++i) {
+    for (size_t j = 0; j < 3 * 2; ++j) {
+      EXPECT_EQ(expected.scales[i].avg_ssim[j], actual.scales[i].avg_ssim[j]);
+    }
+    for (size_t j = 0; j < 3 * 4; ++j) {
+      EXPECT_EQ(expected.scales[i].avg_edgediff[j],
+                actual.scales[i].avg_edgediff[j]);
+    }
+  }
+  EXPECT_LT(expected.Score(), 100.0);
+  EXPECT_EQ(100.0, ComputeSSIMULACRA2Score(orig_ib, orig_ib, &pool));
+}
+
+// Compares with the scalar implementation above instead of golden scores. The
+// vectorized one sums the pixels of a row in floats before adding them to
+// doubles, so the norms may differ in the last few float bits.
+TEST(Ssimulacra2Test, MatchesScalarImplementation) {
+  const size_t xsize = 263;
+  const size_t ysize = 197;
+  Image3F orig(xsize, ysize);
+  RandomFillImage(&orig, 0.0f, 1.0f, 789);
+  Image3F dist = CopyImage(orig);
+  Image3F noise(xsize, ysize);
+  RandomFillImage(&noise, -0.05f, 0.05f, 1011);
+  AddTo(noise, &dist);
+  // Flat block, which loses all detail.
+  for (size_t c = 0; c < 3; ++c) {
+    for (size_t y = 40; y < 120; ++y) {
+      float* JXL_RESTRICT row = dist.PlaneRow(c, y);
+      std::fill(row + 60, row + 200, 0.3f);
+    }
+  }
+
+  ImageMetadata metadata;
+  ImageBundle orig_ib(&metadata);
+  orig_ib.SetFromImage(CopyImage(orig), ColorEncoding::LinearSRGB());
+  ImageBundle dist_ib(&metadata);
+  dist_ib.SetFromImage(CopyImage(dist), ColorEncoding::LinearSRGB());
+
+  const Msssim expected = ScalarSSIMULACRA2(orig, dist);
+  ASSERT_EQ(6u, expected.scales.size());
+  ThreadPoolInternal pool(4);
+  const Msssim actual = ComputeSSIMULACRA2(orig_ib, dist_ib, 0.5f, &pool);
+  ASSERT_EQ(expected.scales.size(), actual.scales.size());
+  for (size_t i = 0; i < expected.scales.size(); ++i) {
+    for (size_t j = 0; j < 3 * 2; ++j) {
+      const double norm = expected.scales[i].avg_ssim[j];
+      EXPECT_NEAR(norm, actual.scales[i].avg_ssim[j], 1e-5 + 1e-4 * norm);
+    }
+    for (size_t j = 0; j < 3 * 4; ++j) {
+      const double norm = expected.scales[i].avg_edgediff[j];
+      EXPECT_NEAR(norm, actual.scales[i].avg_edgediff[j], 1e-5 + 1e-4 * norm);
+    }
+  }
+  EXPECT_LT(expected.Score(), 100.0);
+  EXPECT_NEAR(expected.Score(), actual.Score(), 0.01);
+}
+
+TEST(Ssimulacra2Test, Api) {
+  uint32_t xsize = 171;
+  uint32_t ysize = 219;
+  std::vector<uint8_t> orig_pixels = test::GetSomeTestImage(xsize, ysize, 4, 0);
+  std::vector<uint8_t> dist_pixels = test::GetSomeTestImage(xsize, ysize, 4, 0);
+  for (size_t i = 0; i < dist_pixels.size(); i += 97) {
+    dist_pixels[i] += 64;
+  }
+  JxlPixelFormat pixel_format = {4, JXL_TYPE_UINT16, JXL_BIG_ENDIAN, 0};
+
+  JxlSsimulacra2ApiPtr api(JxlSsimulacra2ApiCreate(nullptr));
+  double score;
+  EXPECT_TRUE(JxlSsimulacra2Compute(
+      api.get(), xsize, ysize, &pixel_format, orig_pixels.data(),
+      orig_pixels.size(), &pixel_format, orig_pixels.data(),
+      orig_pixels.size(), &score));
+  EXPECT_EQ(100.0, score);
+
+  double distorted_score;
+  EXPECT_TRUE(JxlSsimulacra2Compute(
+      api.get(), xsize, ysize, &pixel_format, orig_pixels.data(),
+      orig_pixels.size(), &pixel_format, dist_pixels.data(),
+      dist_pixels.size(), &distorted_score));
+  EXPECT_LT(distorted_score, 100.0);
+
+  JxlThreadParallelRunnerPtr runner = JxlThreadParallelRunnerMake(nullptr, 4);
+  JxlSsimulacra2ApiSetParallelRunner(api.get(), JxlThreadParallelRunner,
+                                     runner.get());
+  EXPECT_TRUE(JxlSsimulacra2Compute(
+      api.get(), xsize, ysize, &pixel_format, orig_pixels.data(),
+      orig_pixels.size(), &pixel_format, dist_pixels.data(),
+      dist_pixels.size(), &score));
+  EXPECT_EQ(distorted_score, score);
+
+  EXPECT_FALSE(JxlSsimulacra2Compute(
+      api.get(), 7, 7, &pixel_format, orig_pixels.data(), orig_pixels.size(),
+      &pixel_format, dist_pixels.data(), dist_pixels.size(), &score));
+}
+
+}  // namespace
+}  // namespace jxl
@@ -0,0 +1,82 @@
+// Copyright (c) the JPEG XL Project Authors. All rights reserved.
+//
+// Use of this source code is governed by a BSD-style
+// license that can be found in the LICENSE file.
+
+#include <memory>
+
+#include "jxl/parallel_runner.h"
+#include "jxl/ssimulacra2.h"
+#include "lib/jxl/base/data_parallel.h"
+#include "lib/jxl/base/status.h"
+#include "lib/jxl/common.h"
+#include "lib/jxl/enc_external_image.h"
+#include "lib/jxl/enc_ssimulacra2.h"
+#include "lib/jxl/image_bundle.h"
+#include "lib/jxl/memory_manager_internal.h"
+
+struct JxlSsimulacra2ApiStruct {
+  JxlMemoryManager memory_manager;
+  std::unique_ptr<jxl::ThreadPool> thread_pool{nullptr};
+};
+
+JxlSsimulacra2Api* JxlSsimulacra2ApiCreate(
+    const JxlMemoryManager* memory_manager) {
+  JxlMemoryManager local_memory_manager;
+  if (!jxl::MemoryManagerInit(&local_memory_manager, memory_manager))
+    return nullptr;
+
+  void* alloc =
+      jxl::MemoryManagerAlloc(&local_memory_manager, sizeof(JxlSsimulacra2Api));
+  if (!alloc) return nullptr;
+  // Placement new constructor on allocated memory
+  JxlSsimulacra2Api* ret = new (alloc) JxlSsimulacra2Api();
+  ret->memory_manager = local_memory_manager;
+  return ret;
+}
+
+void JxlSsimulacra2ApiSetParallelRunner(JxlSsimulacra2Api* api,
+                                        JxlParallelRunner parallel_runner,
+                                        void* parallel_runner_opaque) {
+  api->thread_pool = jxl::make_unique<jxl::ThreadPool>(parallel_runner,
+                                                       parallel_runner_opaque);
+}
+
+void JxlSsimulacra2ApiDestroy(JxlSsimulacra2Api* api) {
+  if (api) {
+    JxlMemoryManager local_memory_manager = api->memory_manager;
+    // Call destructor directly since custom free function is used.
+    api->~JxlSsimulacra2Api();
+    jxl::MemoryManagerFree(&local_memory_manager, api);
+  }
+}
+
+JXL_BOOL JxlSsimulacra2Compute(const JxlSsimulacra2Api* api, uint32_t xsize,
+                               uint32_t ysize,
+                               const JxlPixelFormat* pixel_format_orig,
+                               const void* buffer_orig, size_t size_orig,
+                               const JxlPixelFormat* pixel_format_dist,
+                               const void* buffer_dist, size_t size_dist,
+                               double* score) {
+  if (xsize < 8 || ysize < 8) return JXL_FALSE;
+  jxl::ThreadPool* pool = api->thread_pool.get();
+
+  jxl::ImageMetadata orig_metadata;
+  jxl::ImageBundle orig_ib(&orig_metadata);
+  if (!jxl::BufferToSRGBImageBundle(*pixel_format_orig, xsize, ysize,
+                                    buffer_orig, size_orig, pool,
+                                    &orig_metadata, &orig_ib)) {
+    return JXL_FALSE;
+  }
+
+  jxl::ImageMetadata dist_metadata;
+  jxl::ImageBundle dist_ib(&dist_metadata);
+  if (!jxl::BufferToSRGBImageBundle(*pixel_format_dist, xsize, ysize,
+                                    buffer_dist, size_dist, pool,
+                                    &dist_metadata, &dist_ib)) {
+    return JXL_FALSE;
+  }
+
+  *score = jxl::ComputeSSIMULACRA2Score(orig_ib, dist_ib, pool);
+  return JXL_TRUE;
+}
@@ -35,6 +35,7 @@
 #include "lib/jxl/enc_external_image.h"
 #include "lib/jxl/enc_file.h"
 #include "lib/jxl/enc_params.h"
+#include "lib/jxl/enc_ssimulacra2.h"
 #include "lib/jxl/test_image.h"
 
 #ifdef JXL_DISABLE_SLOW_TESTS
@@ -615,6 +616,16 @@ float ComputeDistance2(const extras::PackedPixelFile& a,
   return ComputeDistance2(io0.Main(), io1.Main(), GetJxlCms());
 }
 
+double ComputeSSIMULACRA2(const extras::PackedPixelFile& a,
+                          const extras::PackedPixelFile& b,
+                          ThreadPool* pool = nullptr) {
+  CodecInOut io0;
+  EXPECT_TRUE(ConvertPackedPixelFileToCodecInOut(a, pool, &io0));
+  CodecInOut io1;
+  EXPECT_TRUE(ConvertPackedPixelFileToCodecInOut(b, pool, &io1));
+  return ComputeSSIMULACRA2Score(io0.Main(), io1.Main(), pool);
+}
+
 bool SameAlpha(const extras::PackedPixelFile& a,
                const extras::PackedPixelFile& b) {
   JXL_CHECK(a.info.xsize == b.info.xsize);
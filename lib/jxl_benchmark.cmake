@@ -31,6 +31,13 @@ if(benchmark_FOUND)
     jxl-static
     benchmark::benchmark
   )
+  if(TARGET jpegli-static)
+    target_sources(jxl_gbench PRIVATE
+      jpegli/bitstream_gbench.cc
+      jpegli/decode_gbench.cc
+    )
+    target_link_libraries(jxl_gbench jpegli-static ${JPEG_LIBRARIES})
+  endif()
 endif() # benchmark_FOUND
 
 endif() # MINGW
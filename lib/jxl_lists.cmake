@@ -382,6 +382,8 @@ set(JPEGXL_INTERNAL_ENC_SOURCES
   jxl/enc_quant_weights.h
   jxl/enc_splines.cc
   jxl/enc_splines.h
+  jxl/enc_ssimulacra2.cc
+  jxl/enc_ssimulacra2.h
   jxl/enc_toc.cc
   jxl/enc_toc.h
   jxl/enc_transforms-inl.h
@@ -411,6 +413,7 @@ set(JPEGXL_INTERNAL_ENC_SOURCES
   jxl/modular/transform/enc_squeeze.h
   jxl/modular/transform/enc_transform.cc
   jxl/modular/transform/enc_transform.h
+  jxl/ssimulacra2_wrapper.cc
 )
 
 set(JPEGXL_INTERNAL_EXTRAS_FOR_TOOLS_SOURCES
@@ -445,6 +448,7 @@ set(JPEGXL_INTERNAL_GBENCH_SOURCES
   jxl/dec_external_image_gbench.cc
   jxl/enc_external_image_gbench.cc
   jxl/gauss_blur_gbench.cc
+  jxl/modular/encoding/enc_ma_gbench.cc
   jxl/splines_gbench.cc
   jxl/tf_gbench.cc
 )
@@ -467,6 +471,8 @@ set(JPEGXL_INTERNAL_PUBLIC_HEADERS
   include/jxl/encode_cxx.h
   include/jxl/memory_manager.h
   include/jxl/parallel_runner.h
+  include/jxl/ssimulacra2.h
+  include/jxl/ssimulacra2_cxx.h
   include/jxl/types.h
 )
 
@@ -537,6 +543,7 @@ set(JPEGXL_INTERNAL_TESTS
   jxl/simd_util_test.cc
   jxl/speed_tier_test.cc
   jxl/splines_test.cc
+  jxl/ssimulacra2_test.cc
   jxl/toc_test.cc
   jxl/xorshift128plus_test.cc
   threads/thread_parallel_runner_test.cc
@@ -244,6 +244,8 @@ class JxlCodec : public ImageCodec {
       if (cparams_.epf > 3) {
         return JXL_FAILURE("Invalid epf value");
       }
+    } else if (param == "fastlz77") {
+      cparams_.modular_fast_lz77 = true;
     } else if (param.substr(0, 2) == "nr") {
       normalize_bitrate_ = true;
     } else if (param.substr(0, 16) == "faster_decoding=") {
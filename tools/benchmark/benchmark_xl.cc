@@ -38,6 +38,7 @@
 #include "lib/jxl/enc_butteraugli_comparator.h"
 #include "lib/jxl/enc_butteraugli_pnorm.h"
 #include "lib/jxl/enc_color_management.h"
+#include "lib/jxl/enc_ssimulacra2.h"
 #include "lib/jxl/image.h"
 #include "lib/jxl/image_bundle.h"
 #include "lib/jxl/image_ops.h"
@@ -49,7 +50,6 @@
 #include "tools/benchmark/benchmark_utils.h"
 #include "tools/codec_config.h"
 #include "tools/speed_stats.h"
-#include "tools/ssimulacra2.h"
 
 namespace jxl {
 namespace {
@@ -244,7 +244,8 @@ void DoCompress(const std::string& filename, const CodecInOut& io,
       s->distance_p_norm +=
           ComputeDistanceP(distmap, ButteraugliParams(), Args()->error_pnorm) *
           input_pixels;
-      s->ssimulacra2 += ComputeSSIMULACRA2(ib1, ib2).Score() * input_pixels;
+      s->ssimulacra2 +=
+          ComputeSSIMULACRA2(ib1, ib2, 0.5f, inner_pool).Score() * input_pixels;
       s->max_distance = std::max(s->max_distance, distance);
       s->distances.push_back(distance);
       max_distance = std::max(max_distance, distance);
@@ -113,6 +113,7 @@ def SplitLibFiles(repo_files):
   # TODO(eustas): rename butteraugli_wrapper.cc to butteraugli.cc?
   # TODO(eustas): is it possible to make butteraugli more standalone?
   enc_sources, lib_srcs = Filter(lib_srcs, ContainsFn('/enc_', '/butteraugli',
+    '/ssimulacra2',
     'jxl/encode.cc', 'jxl/encode_internal.h'
   ))
 
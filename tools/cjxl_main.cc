@@ -140,6 +140,19 @@ struct CompressArgs {
         "    Mutually exclusive with --distance.",
         &quality, &ParseFloat);
 
+    cmdline->AddOptionValue(
+        '\0', "target_ssimulacra2", "SCORE",
+        "Search for the quantization at which the decoded image reaches this\n"
+        "    SSIMULACRA 2 score, starting from a distance estimated from it.\n"
+        "    90 = visually lossless, 70 = medium quality. Only for VarDCT.",
+        &target_ssimulacra2, &ParseFloat, 1);
+
+    cmdline->AddOptionValue(
+        '\0', "target_butteraugli", "SCORE",
+        "Same as --target_ssimulacra2, but targets a maximum butteraugli\n"
+        "    score of the decoded image.",
+        &target_butteraugli, &ParseFloat, 1);
+
     cmdline->AddOptionValue(
         'e', "effort", "EFFORT",
         "Encoder effort setting. Range: 1 .. 9.\n"
@@ -387,6 +400,14 @@ struct CompressArgs {
         "an explicit percentage, -1 to use the encoder default.",
         &modular_channel_colors_group_percent, &ParseFloat, 2);
 
+    cmdline->AddOptionValue(
+        '\0', "bounded_token_memory", "0|1",
+        "[modular encoding] Tokenize each group again when writing it, "
+        "instead of keeping the tokens of the whole image in memory. Uses "
+        "less memory, but is slower and disables LZ77 "
+        "(not provided = default, 0 = disable, 1 = enable).",
+        &bounded_token_memory, &ParseOverride, 2);
+
     cmdline->AddOptionValue('\0', "codestream_level", "K",
                             "The codestream level. Either `-1`, `5` or `10`.",
                             &codestream_level, &ParseInt64, 2);
@@ -469,6 +490,7 @@ struct CompressArgs {
   jxl::Override gaborish = jxl::Override::kDefault;
   jxl::Override group_order = jxl::Override::kDefault;
   jxl::Override compress_boxes = jxl::Override::kDefault;
+  jxl::Override bounded_token_memory = jxl::Override::kDefault;
 
   size_t faster_decoding = 0;
   int64_t resampling = -1;
@@ -485,6 +507,8 @@ struct CompressArgs {
   int64_t modular_nb_prev_channels = -1;
   float modular_ma_tree_learning_percent = -1.f;
   float photon_noise_iso = 0;
+  float target_ssimulacra2 = 0;
+  float target_butteraugli = 0;
   int64_t codestream_level = -1;
   int64_t responsive = -1;
   float distance = 1.0;
@@ -756,6 +780,16 @@ void ProcessFlags(const jxl::extras::Codec codec,
               });
   ProcessFlag("photon_noise_iso", args->photon_noise_iso,
               JXL_ENC_FRAME_SETTING_PHOTON_NOISE, params);
+  ProcessFlag("target_ssimulacra2", args->target_ssimulacra2,
+              JXL_ENC_FRAME_SETTING_TARGET_SSIMULACRA2, params,
+              [](float x) -> std::string {
+                return (x >= 0 && x <= 100) ? "" : "Valid range is [0, 100].\n";
+              });
+  ProcessFlag("target_butteraugli", args->target_butteraugli,
+              JXL_ENC_FRAME_SETTING_TARGET_BUTTERAUGLI, params,
+              [](float x) -> std::string {
+                return (x >= 0 && x <= 25) ? "" : "Valid range is [0, 25].\n";
+              });
   ProcessFlag("already_downsampled",
               static_cast<int64_t>(args->already_downsampled),
               JXL_ENC_FRAME_SETTING_ALREADY_DOWNSAMPLED, params);
@@ -867,6 +901,8 @@ void ProcessFlags(const jxl::extras::Codec codec,
   ProcessFlag("modular_lossy_palette",
               static_cast<int64_t>(args->modular_lossy_palette),
               JXL_ENC_FRAME_SETTING_LOSSY_PALETTE, params);
+  ProcessBoolFlag(args->bounded_token_memory,
+                  JXL_ENC_FRAME_SETTING_BOUNDED_TOKEN_MEMORY, params);
   ProcessFlag("modular_palette_colors", args->modular_palette_colors,
               JXL_ENC_FRAME_SETTING_PALETTE_COLORS, params,
               [](int64_t x) -> std::string {
@@ -6,9 +6,10 @@
 #include <stdio.h>
 
 #include "lib/extras/codec.h"
+#include "lib/jxl/base/thread_pool_internal.h"
 #include "lib/jxl/color_management.h"
 #include "lib/jxl/enc_color_management.h"
-#include "tools/ssimulacra2.h"
+#include "lib/jxl/enc_ssimulacra2.h"
 
 int PrintUsage(char** argv) {
   fprintf(stderr, "Usage: %s orig.png distorted.png\n", argv[0]);
@@ -56,15 +57,8 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  if (!io1.Main().HasAlpha()) {
-    Msssim msssim = ComputeSSIMULACRA2(io1.Main(), io2.Main());
-    printf("%.8f\n", msssim.Score());
-  } else {
-    // in case of alpha transparency: blend against dark and bright backgrounds
-    // and return the worst of both scores
-    Msssim msssim0 = ComputeSSIMULACRA2(io1.Main(), io2.Main(), 0.1f);
-    Msssim msssim1 = ComputeSSIMULACRA2(io1.Main(), io2.Main(), 0.9f);
-    printf("%.8f\n", std::min(msssim0.Score(), msssim1.Score()));
-  }
+  jxl::ThreadPoolInternal pool;
+  printf("%.8f\n",
+         jxl::ComputeSSIMULACRA2Score(io1.Main(), io2.Main(), &pool));
   return 0;
 }